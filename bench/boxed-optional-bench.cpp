@@ -0,0 +1,101 @@
+#include "allocators.h"
+#include "boxed-optional.h"
+#include "perf-counters.h"
+
+#include <benchmark/benchmark.h>
+
+#include <array>
+#include <cstddef>
+#include <random>
+#include <vector>
+
+namespace {
+
+struct payload {
+  std::array<std::byte, 2048> data;
+};
+
+template <typename Allocator>
+struct std_allocator_context {
+  Allocator allocator() {
+    return {};
+  }
+};
+
+template <typename Resource>
+struct resource_context {
+  resource_allocator<payload, Resource> allocator() {
+    return resource_allocator<payload, Resource>(resource);
+  }
+
+  Resource resource;
+};
+
+using std_context = std_allocator_context<std::allocator<payload>>;
+using arena_context = resource_context<monotonic_arena>;
+using pool_context = resource_context<size_class_pool>;
+
+template <typename Context>
+using box_for = boxed_optional<payload, decltype(std::declval<Context&>().allocator())>;
+
+// Fill a parent array where only a few entries are engaged, then drop it
+template <typename Context>
+void sparse_fill(benchmark::State& state) {
+  const auto count = static_cast<std::size_t>(state.range(0));
+  for (auto _ : counted(state, state.range(0) / 8)) {
+    Context context;
+    std::vector<box_for<Context>> boxes(count, box_for<Context>(context.allocator()));
+    for (std::size_t i = 0; i < count; i += 8) {
+      boxes[i].emplace();
+    }
+    benchmark::DoNotOptimize(boxes.data());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0) / 8);
+}
+
+// Random engage/disengage churn on a long-lived array
+template <typename Context>
+void churn(benchmark::State& state) {
+  const auto count = static_cast<std::size_t>(state.range(0));
+  Context context;
+  std::vector<box_for<Context>> boxes(count, box_for<Context>(context.allocator()));
+  std::mt19937 rng(42);
+  std::uniform_int_distribution<std::size_t> dist(0, count - 1);
+  for (auto _ : counted(state)) {
+    auto& box = boxes[dist(rng)];
+    if (box) {
+      box.reset();
+    } else {
+      box.emplace();
+    }
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+// Deep copies of a sparsely engaged array
+template <typename Context>
+void copy_sparse(benchmark::State& state) {
+  const auto count = static_cast<std::size_t>(state.range(0));
+  Context context;
+  std::vector<box_for<Context>> boxes(count, box_for<Context>(context.allocator()));
+  for (std::size_t i = 0; i < count; i += 8) {
+    boxes[i].emplace();
+  }
+  for (auto _ : counted(state, state.range(0) / 8)) {
+    auto copy = boxes;
+    benchmark::DoNotOptimize(copy.data());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0) / 8);
+}
+
+} // namespace
+
+BENCHMARK(sparse_fill<std_context>)->Range(1 << 8, 1 << 14);
+BENCHMARK(sparse_fill<arena_context>)->Range(1 << 8, 1 << 14);
+BENCHMARK(sparse_fill<pool_context>)->Range(1 << 8, 1 << 14);
+
+BENCHMARK(churn<std_context>)->Arg(1 << 12);
+BENCHMARK(churn<pool_context>)->Arg(1 << 12);
+
+BENCHMARK(copy_sparse<std_context>)->Arg(1 << 12);
+BENCHMARK(copy_sparse<pool_context>)->Arg(1 << 12);
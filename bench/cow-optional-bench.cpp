@@ -0,0 +1,77 @@
+#include "cow-optional.h"
+#include "optional.h"
+#include "perf-counters.h"
+
+#include <benchmark/benchmark.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+
+struct config {
+  std::map<std::string, std::string> settings;
+  std::vector<std::string> upstreams;
+  std::int64_t timeout_ms = 0;
+};
+
+config make_config() {
+  config result;
+  for (int i = 0; i < 32; ++i) {
+    auto key = "setting." + std::to_string(i);
+    result.settings.emplace(std::move(key), "a value long enough to need a heap buffer " + std::to_string(i));
+    result.upstreams.push_back("upstream-" + std::to_string(i) + ".internal.example.com:8080");
+  }
+  result.timeout_ms = 250;
+  return result;
+}
+
+template <typename Optional>
+struct request {
+  std::uint64_t id;
+  Optional settings;
+};
+
+constexpr std::size_t fan_out = 64;
+
+// Every request gets a copy of the shared configuration; argument: percentage of the requests that override a field
+template <typename Optional>
+void fan_out_requests(benchmark::State& state) {
+  const Optional shared(make_config());
+  const auto percent = static_cast<std::size_t>(state.range(0));
+  std::vector<request<Optional>> requests;
+  requests.reserve(fan_out);
+  for (auto _ : counted(state, static_cast<std::int64_t>(fan_out))) {
+    requests.clear();
+    for (std::size_t i = 0; i < fan_out; ++i) {
+      auto& added = requests.emplace_back(request<Optional>{i, shared});
+      if (i * 100 / fan_out < percent) {
+        added.settings->timeout_ms = static_cast<std::int64_t>(i);
+      }
+    }
+    std::int64_t total = 0;
+    for (const auto& r : requests) {
+      const Optional& settings = r.settings;
+      total += settings->timeout_ms + static_cast<std::int64_t>(settings->upstreams.size());
+    }
+    benchmark::DoNotOptimize(total);
+  }
+  state.SetItemsProcessed(state.iterations() * static_cast<std::int64_t>(fan_out));
+}
+
+void plain_fan_out(benchmark::State& state) {
+  fan_out_requests<optional<config>>(state);
+}
+
+void cow_fan_out(benchmark::State& state) {
+  fan_out_requests<cow_optional<config>>(state);
+}
+
+} // namespace
+
+BENCHMARK(plain_fan_out)->Arg(0)->Arg(10)->Arg(100);
+BENCHMARK(cow_fan_out)->Arg(0)->Arg(10)->Arg(100);
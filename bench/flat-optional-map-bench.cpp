@@ -0,0 +1,128 @@
+#include "flat-optional-map.h"
+#include "perf-counters.h"
+
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+// A key type of its own, so that the niche does not claim UINT32_MAX for every std::uint32_t in the binary
+enum class niche_key : std::uint32_t {};
+
+} // namespace
+
+template <>
+struct niche_traits<niche_key> {
+  static constexpr bool has_niche = true;
+
+  static constexpr niche_key empty() noexcept {
+    return niche_key{UINT32_MAX};
+  }
+};
+
+namespace {
+
+using optional_bucket_map = flat_optional_map<std::uint64_t, std::uint64_t>;
+using niche_map = flat_optional_map<niche_key, std::uint64_t>;
+using std_map = std::unordered_map<std::uint32_t, std::uint64_t>;
+
+std::vector<std::uint32_t> random_keys(std::size_t count, std::uint32_t seed) {
+  std::mt19937 rng(seed);
+  std::uniform_int_distribution<std::uint32_t> dist(0, UINT32_MAX - 1);
+  std::vector<std::uint32_t> keys(count);
+  for (auto& key : keys) {
+    key = dist(rng);
+  }
+  return keys;
+}
+
+template <typename Map>
+typename Map::key_type as_key(std::uint32_t key) {
+  return static_cast<typename Map::key_type>(key);
+}
+
+template <typename Map>
+void insert(benchmark::State& state) {
+  auto keys = random_keys(static_cast<std::size_t>(state.range(0)), 1);
+  for (auto _ : counted(state, state.range(0))) {
+    Map map;
+    for (auto key : keys) {
+      map[as_key<Map>(key)] = key;
+    }
+    benchmark::DoNotOptimize(map.size());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+template <typename Map>
+void lookup_hit(benchmark::State& state) {
+  auto keys = random_keys(static_cast<std::size_t>(state.range(0)), 1);
+  Map map;
+  for (auto key : keys) {
+    map[as_key<Map>(key)] = key;
+  }
+  for (auto _ : counted(state, state.range(0))) {
+    std::uint64_t sum = 0;
+    for (auto key : keys) {
+      sum += map.find(as_key<Map>(key))->second;
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+template <typename Map>
+void lookup_miss(benchmark::State& state) {
+  auto keys = random_keys(static_cast<std::size_t>(state.range(0)), 1);
+  auto misses = random_keys(static_cast<std::size_t>(state.range(0)), 2);
+  Map map;
+  for (auto key : keys) {
+    map[as_key<Map>(key)] = key;
+  }
+  for (auto _ : counted(state, state.range(0))) {
+    std::size_t found = 0;
+    for (auto key : misses) {
+      found += map.contains(as_key<Map>(key));
+    }
+    benchmark::DoNotOptimize(found);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+template <typename Map>
+void erase_insert(benchmark::State& state) {
+  auto keys = random_keys(static_cast<std::size_t>(state.range(0)), 1);
+  Map map;
+  for (auto key : keys) {
+    map[as_key<Map>(key)] = key;
+  }
+  for (auto _ : counted(state, state.range(0))) {
+    for (auto key : keys) {
+      map.erase(as_key<Map>(key));
+      map[as_key<Map>(key)] = key;
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+} // namespace
+
+BENCHMARK(insert<std_map>)->Range(1 << 10, 1 << 20);
+BENCHMARK(insert<optional_bucket_map>)->Range(1 << 10, 1 << 20);
+BENCHMARK(insert<niche_map>)->Range(1 << 10, 1 << 20);
+
+BENCHMARK(lookup_hit<std_map>)->Range(1 << 10, 1 << 20);
+BENCHMARK(lookup_hit<optional_bucket_map>)->Range(1 << 10, 1 << 20);
+BENCHMARK(lookup_hit<niche_map>)->Range(1 << 10, 1 << 20);
+
+BENCHMARK(lookup_miss<std_map>)->Range(1 << 10, 1 << 20);
+BENCHMARK(lookup_miss<optional_bucket_map>)->Range(1 << 10, 1 << 20);
+BENCHMARK(lookup_miss<niche_map>)->Range(1 << 10, 1 << 20);
+
+BENCHMARK(erase_insert<std_map>)->Arg(1 << 16);
+BENCHMARK(erase_insert<optional_bucket_map>)->Arg(1 << 16);
+BENCHMARK(erase_insert<niche_map>)->Arg(1 << 16);
@@ -0,0 +1,88 @@
+#include "optional.h"
+#include "perf-counters.h"
+
+#include <benchmark/benchmark.h>
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+namespace {
+
+std::size_t allocations = 0;
+
+// Counts every allocation made through it, so that a benchmark can report its allocator traffic
+template <typename T>
+struct counting_allocator {
+  using value_type = T;
+
+  counting_allocator() = default;
+
+  template <typename U>
+  counting_allocator(const counting_allocator<U>&) noexcept {}
+
+  T* allocate(std::size_t n) {
+    ++allocations;
+    return std::allocator<T>().allocate(n);
+  }
+
+  void deallocate(T* p, std::size_t n) noexcept {
+    std::allocator<T>().deallocate(p, n);
+  }
+
+  friend bool operator==(const counting_allocator&, const counting_allocator&) = default;
+};
+
+using counted_string = std::basic_string<char, std::char_traits<char>, counting_allocator<char>>;
+
+// Values alternate between two lengths beyond the small buffer, so a fresh string always allocates
+const counted_string& next_value(std::size_t i) {
+  static const counted_string values[] = {counted_string(40, 'a'), counted_string(60, 'b')};
+  return values[i & 1];
+}
+
+template <typename Assign>
+void run(benchmark::State& state, Assign assign) {
+  optional<counted_string> slot(next_value(1));
+  std::size_t i = 0;
+  allocations = 0;
+  for (auto _ : counted(state)) {
+    assign(slot, next_value(i++));
+    benchmark::DoNotOptimize(slot->data());
+  }
+  state.counters["allocations"] =
+      benchmark::Counter(static_cast<double>(allocations), benchmark::Counter::kAvgIterations);
+}
+
+void reset_and_emplace(benchmark::State& state) {
+  run(state, [](optional<counted_string>& slot, const counted_string& value) {
+    slot.reset();
+    slot.emplace(value);
+  });
+}
+
+void emplace(benchmark::State& state) {
+  run(state, [](optional<counted_string>& slot, const counted_string& value) { slot.emplace(value); });
+}
+
+void value_assignment(benchmark::State& state) {
+  run(state, [](optional<counted_string>& slot, const counted_string& value) { slot = value; });
+}
+
+void copy_assignment(benchmark::State& state) {
+  optional<counted_string> sources[] = {next_value(0), next_value(1)};
+  std::size_t i = 0;
+  run(state, [&](optional<counted_string>& slot, const counted_string&) { slot = sources[i++ & 1]; });
+}
+
+void assign_or_emplace(benchmark::State& state) {
+  run(state, [](optional<counted_string>& slot, const counted_string& value) { slot.assign_or_emplace(value); });
+}
+
+} // namespace
+
+BENCHMARK(reset_and_emplace);
+BENCHMARK(emplace);
+BENCHMARK(value_assignment);
+BENCHMARK(copy_assignment);
+BENCHMARK(assign_or_emplace);
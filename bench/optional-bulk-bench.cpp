@@ -0,0 +1,132 @@
+#include "optional-bulk.h"
+#include "perf-counters.h"
+
+#include <benchmark/benchmark.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace {
+
+// Same layout as optional<std::uint32_t>, but not trivially copyable, so the bulk operations take the per-element path
+struct boxed_u32 {
+  boxed_u32(std::uint32_t value)
+      : value(value) {}
+
+  boxed_u32(const boxed_u32& other)
+      : value(other.value) {}
+
+  boxed_u32& operator=(const boxed_u32& other) {
+    value = other.value;
+    return *this;
+  }
+
+  std::uint32_t value;
+};
+
+template <typename T>
+std::vector<optional<T>> engaged(std::size_t count) {
+  return std::vector<optional<T>>(count, T(1));
+}
+
+template <typename T>
+void finish(benchmark::State& state, const std::vector<optional<T>>& values) {
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+  state.SetBytesProcessed(state.iterations() * state.range(0) * static_cast<std::int64_t>(sizeof(optional<T>)));
+  benchmark::DoNotOptimize(values.data());
+}
+
+void reset_each(benchmark::State& state) {
+  auto values = engaged<std::uint32_t>(static_cast<std::size_t>(state.range(0)));
+  for (auto _ : counted(state, state.range(0))) {
+    for (auto& value : values) {
+      value.reset();
+    }
+    benchmark::ClobberMemory();
+  }
+  finish(state, values);
+}
+
+void reset_all_bytes(benchmark::State& state) {
+  auto values = engaged<std::uint32_t>(static_cast<std::size_t>(state.range(0)));
+  for (auto _ : counted(state, state.range(0))) {
+    reset_all<std::uint32_t>(values);
+    benchmark::ClobberMemory();
+  }
+  finish(state, values);
+}
+
+void reset_all_flags(benchmark::State& state) {
+  auto values = engaged<boxed_u32>(static_cast<std::size_t>(state.range(0)));
+  for (auto _ : counted(state, state.range(0))) {
+    reset_all<boxed_u32>(values);
+    benchmark::ClobberMemory();
+  }
+  finish(state, values);
+}
+
+void emplace_each(benchmark::State& state) {
+  auto values = engaged<std::uint32_t>(static_cast<std::size_t>(state.range(0)));
+  for (auto _ : counted(state, state.range(0))) {
+    for (auto& value : values) {
+      value.emplace(7u);
+    }
+    benchmark::ClobberMemory();
+  }
+  finish(state, values);
+}
+
+void emplace_all_bytes(benchmark::State& state) {
+  auto values = engaged<std::uint32_t>(static_cast<std::size_t>(state.range(0)));
+  for (auto _ : counted(state, state.range(0))) {
+    emplace_all<std::uint32_t>(values, 7u);
+    benchmark::ClobberMemory();
+  }
+  finish(state, values);
+}
+
+void emplace_all_elementwise(benchmark::State& state) {
+  auto values = engaged<boxed_u32>(static_cast<std::size_t>(state.range(0)));
+  for (auto _ : counted(state, state.range(0))) {
+    emplace_all<boxed_u32>(values, 7u);
+    benchmark::ClobberMemory();
+  }
+  finish(state, values);
+}
+
+void fill_bytes(benchmark::State& state) {
+  auto values = engaged<std::uint32_t>(static_cast<std::size_t>(state.range(0)));
+  const optional<std::uint32_t> value(7u);
+  for (auto _ : counted(state, state.range(0))) {
+    fill<std::uint32_t>(values, value);
+    benchmark::ClobberMemory();
+  }
+  finish(state, values);
+}
+
+void fill_elementwise(benchmark::State& state) {
+  auto values = engaged<boxed_u32>(static_cast<std::size_t>(state.range(0)));
+  const optional<boxed_u32> value(7u);
+  for (auto _ : counted(state, state.range(0))) {
+    fill<boxed_u32>(values, value);
+    benchmark::ClobberMemory();
+  }
+  finish(state, values);
+}
+
+// 1K to 100M elements, 8 bytes each
+void sizes(benchmark::internal::Benchmark* benchmark) {
+  benchmark->RangeMultiplier(10)->Range(1'000, 100'000'000);
+}
+
+} // namespace
+
+BENCHMARK(reset_each)->Apply(sizes);
+BENCHMARK(reset_all_bytes)->Apply(sizes);
+BENCHMARK(reset_all_flags)->Apply(sizes);
+BENCHMARK(emplace_each)->Apply(sizes);
+BENCHMARK(emplace_all_bytes)->Apply(sizes);
+BENCHMARK(emplace_all_elementwise)->Apply(sizes);
+BENCHMARK(fill_bytes)->Apply(sizes);
+BENCHMARK(fill_elementwise)->Apply(sizes);
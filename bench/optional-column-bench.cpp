@@ -0,0 +1,124 @@
+#include "optional-column.h"
+#include "optional.h"
+#include "perf-counters.h"
+
+#include <benchmark/benchmark.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <vector>
+
+namespace {
+
+constexpr std::size_t rows = 1 << 22;
+constexpr std::size_t queries = 1024;
+// A scan takes milliseconds per query, so the scans only run a few
+constexpr std::size_t scan_queries = 8;
+
+// Argument: percentage of engaged rows
+struct sparse_data {
+  std::vector<optional<std::uint64_t>> plain;
+  optional_column<std::uint64_t> column;
+  std::vector<std::size_t> row_queries;
+  std::vector<std::size_t> value_queries;
+
+  explicit sparse_data(int percent) {
+    std::mt19937_64 random(1);
+    std::uniform_int_distribution<int> engaged(0, 99);
+    for (std::size_t i = 0; i < rows; ++i) {
+      if (engaged(random) < percent) {
+        plain.emplace_back(i);
+        column.emplace_back(i);
+      } else {
+        plain.emplace_back();
+        column.push_back(nullopt);
+      }
+    }
+    for (std::size_t i = 0; i < queries; ++i) {
+      row_queries.push_back(random() % rows);
+      value_queries.push_back(random() % column.count());
+    }
+  }
+};
+
+const sparse_data& data(int percent) {
+  static std::vector<std::unique_ptr<sparse_data>> cache(101);
+  if (!cache[percent]) {
+    cache[percent] = std::make_unique<sparse_data>(percent);
+  }
+  return *cache[percent];
+}
+
+void rank_scan(benchmark::State& state) {
+  const auto& d = data(static_cast<int>(state.range(0)));
+  for (auto _ : counted(state, static_cast<std::int64_t>(scan_queries))) {
+    for (std::size_t q = 0; q < scan_queries; ++q) {
+      std::size_t i = d.row_queries[q];
+      std::size_t before = 0;
+      for (std::size_t j = 0; j < i; ++j) {
+        before += d.plain[j].has_value();
+      }
+      benchmark::DoNotOptimize(before);
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * static_cast<std::int64_t>(scan_queries));
+}
+
+void rank_index(benchmark::State& state) {
+  const auto& d = data(static_cast<int>(state.range(0)));
+  for (auto _ : counted(state, static_cast<std::int64_t>(queries))) {
+    for (std::size_t i : d.row_queries) {
+      benchmark::DoNotOptimize(d.column.rank(i));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * static_cast<std::int64_t>(queries));
+}
+
+void select_scan(benchmark::State& state) {
+  const auto& d = data(static_cast<int>(state.range(0)));
+  for (auto _ : counted(state, static_cast<std::int64_t>(scan_queries))) {
+    for (std::size_t q = 0; q < scan_queries; ++q) {
+      std::size_t k = d.value_queries[q];
+      std::size_t row = 0;
+      for (std::size_t seen = 0;; ++row) {
+        if (d.plain[row].has_value() && seen++ == k) {
+          break;
+        }
+      }
+      benchmark::DoNotOptimize(row);
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * static_cast<std::int64_t>(scan_queries));
+}
+
+void select_index(benchmark::State& state) {
+  const auto& d = data(static_cast<int>(state.range(0)));
+  for (auto _ : counted(state, static_cast<std::int64_t>(queries))) {
+    for (std::size_t k : d.value_queries) {
+      benchmark::DoNotOptimize(d.column.select(k));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * static_cast<std::int64_t>(queries));
+}
+
+void append(benchmark::State& state) {
+  const auto& d = data(static_cast<int>(state.range(0)));
+  for (auto _ : counted(state, static_cast<std::int64_t>(rows))) {
+    optional_column<std::uint64_t> column;
+    for (const auto& value : d.plain) {
+      column.push_back(value);
+    }
+    benchmark::DoNotOptimize(column.count());
+  }
+  state.SetItemsProcessed(state.iterations() * static_cast<std::int64_t>(rows));
+}
+
+} // namespace
+
+BENCHMARK(rank_scan)->Arg(1)->Arg(10)->Arg(50)->Unit(benchmark::kMicrosecond);
+BENCHMARK(rank_index)->Arg(1)->Arg(10)->Arg(50)->Unit(benchmark::kMicrosecond);
+BENCHMARK(select_scan)->Arg(1)->Arg(10)->Arg(50)->Unit(benchmark::kMicrosecond);
+BENCHMARK(select_index)->Arg(1)->Arg(10)->Arg(50)->Unit(benchmark::kMicrosecond);
+BENCHMARK(append)->Arg(1)->Arg(50)->Unit(benchmark::kMillisecond);
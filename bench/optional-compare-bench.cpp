@@ -0,0 +1,104 @@
+#include "optional.h"
+#include "perf-counters.h"
+
+#include <benchmark/benchmark.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Long enough to be heap-allocated, so that every copy of a key costs an allocation
+std::string make_key(std::size_t i) {
+  return "a key that does not fit into the small buffer #" + std::to_string(i);
+}
+
+std::vector<optional<std::string>> random_keys(std::size_t count) {
+  std::mt19937_64 rng(1);
+  std::vector<optional<std::string>> keys(count);
+  for (auto& key : keys) {
+    std::uint64_t x = rng();
+    // roughly one in eight disengaged
+    if ((x & 7) != 0) {
+      key = make_key(x % 16);
+    }
+  }
+  return keys;
+}
+
+// What comparing with a plain value looked like before optional<T> == U existed
+void wrap_needle(benchmark::State& state) {
+  auto keys = random_keys(static_cast<std::size_t>(state.range(0)));
+  std::string needle = make_key(3);
+  for (auto _ : counted(state, state.range(0))) {
+    std::size_t matches = 0;
+    for (const auto& key : keys) {
+      matches += key == optional<std::string>(needle);
+    }
+    benchmark::DoNotOptimize(matches);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+void compare_string(benchmark::State& state) {
+  auto keys = random_keys(static_cast<std::size_t>(state.range(0)));
+  std::string needle = make_key(3);
+  for (auto _ : counted(state, state.range(0))) {
+    std::size_t matches = 0;
+    for (const auto& key : keys) {
+      matches += key == needle;
+    }
+    benchmark::DoNotOptimize(matches);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+void compare_c_string(benchmark::State& state) {
+  auto keys = random_keys(static_cast<std::size_t>(state.range(0)));
+  std::string storage = make_key(3);
+  const char* needle = storage.c_str();
+  for (auto _ : counted(state, state.range(0))) {
+    std::size_t matches = 0;
+    for (const auto& key : keys) {
+      matches += key == needle;
+    }
+    benchmark::DoNotOptimize(matches);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+void less_string(benchmark::State& state) {
+  auto keys = random_keys(static_cast<std::size_t>(state.range(0)));
+  std::string bound = make_key(8);
+  for (auto _ : counted(state, state.range(0))) {
+    std::size_t below = 0;
+    for (const auto& key : keys) {
+      below += key < bound;
+    }
+    benchmark::DoNotOptimize(below);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+void compare_nullopt(benchmark::State& state) {
+  auto keys = random_keys(static_cast<std::size_t>(state.range(0)));
+  for (auto _ : counted(state, state.range(0))) {
+    std::size_t empty = 0;
+    for (const auto& key : keys) {
+      empty += key == nullopt;
+    }
+    benchmark::DoNotOptimize(empty);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+} // namespace
+
+BENCHMARK(wrap_needle)->Range(1 << 10, 1 << 16);
+BENCHMARK(compare_string)->Range(1 << 10, 1 << 16);
+BENCHMARK(compare_c_string)->Range(1 << 10, 1 << 16);
+BENCHMARK(less_string)->Range(1 << 10, 1 << 16);
+BENCHMARK(compare_nullopt)->Range(1 << 10, 1 << 16);
@@ -0,0 +1,123 @@
+#include "optional-convert.h"
+#include "perf-counters.h"
+
+#include <benchmark/benchmark.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+std::vector<optional<std::int32_t>> random_ints(std::size_t count) {
+  std::mt19937_64 rng(1);
+  std::vector<optional<std::int32_t>> values(count);
+  for (auto& value : values) {
+    std::uint64_t x = rng();
+    // roughly one in eight disengaged
+    if ((x & 7) != 0) {
+      value = static_cast<std::int32_t>(x >> 32);
+    }
+  }
+  return values;
+}
+
+// Converting through an intermediate value, as callers had to before optional<T> accepted optional<U>
+void ints_through_value(benchmark::State& state) {
+  auto from = random_ints(static_cast<std::size_t>(state.range(0)));
+  std::vector<optional<std::int64_t>> to(from.size());
+  for (auto _ : counted(state, state.range(0))) {
+    for (std::size_t i = 0; i < from.size(); ++i) {
+      if (from[i].has_value()) {
+        to[i] = optional<std::int64_t>(std::int64_t(*from[i]));
+      } else {
+        to[i] = nullopt;
+      }
+    }
+    benchmark::DoNotOptimize(to.data());
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+void ints_converting_assignment(benchmark::State& state) {
+  auto from = random_ints(static_cast<std::size_t>(state.range(0)));
+  std::vector<optional<std::int64_t>> to(from.size());
+  for (auto _ : counted(state, state.range(0))) {
+    for (std::size_t i = 0; i < from.size(); ++i) {
+      to[i] = from[i];
+    }
+    benchmark::DoNotOptimize(to.data());
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+void ints_batch(benchmark::State& state) {
+  auto from = random_ints(static_cast<std::size_t>(state.range(0)));
+  std::vector<optional<std::int64_t>> to(from.size());
+  for (auto _ : counted(state, state.range(0))) {
+    batch_convert<std::int64_t, std::int32_t>(from, to);
+    benchmark::DoNotOptimize(to.data());
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+struct string_views {
+  std::string text;
+  std::vector<optional<std::string_view>> views;
+};
+
+string_views random_views(std::size_t count) {
+  string_views result;
+  result.text = std::string(64, 'x');
+  result.views.resize(count);
+  std::mt19937_64 rng(1);
+  for (auto& view : result.views) {
+    std::uint64_t x = rng();
+    if ((x & 7) != 0) {
+      view = std::string_view(result.text).substr(0, (x >> 8) % 64);
+    }
+  }
+  return result;
+}
+
+void strings_through_value(benchmark::State& state) {
+  auto from = random_views(static_cast<std::size_t>(state.range(0)));
+  std::vector<optional<std::string>> to(from.views.size());
+  for (auto _ : counted(state, state.range(0))) {
+    for (std::size_t i = 0; i < from.views.size(); ++i) {
+      if (from.views[i].has_value()) {
+        to[i] = optional<std::string>(std::string(*from.views[i]));
+      } else {
+        to[i] = nullopt;
+      }
+    }
+    benchmark::DoNotOptimize(to.data());
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+void strings_batch(benchmark::State& state) {
+  auto from = random_views(static_cast<std::size_t>(state.range(0)));
+  std::vector<optional<std::string>> to(from.views.size());
+  for (auto _ : counted(state, state.range(0))) {
+    batch_convert<std::string, std::string_view>(from.views, to);
+    benchmark::DoNotOptimize(to.data());
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+} // namespace
+
+BENCHMARK(ints_through_value)->Range(1 << 10, 1 << 16);
+BENCHMARK(ints_converting_assignment)->Range(1 << 10, 1 << 16);
+BENCHMARK(ints_batch)->Range(1 << 10, 1 << 16);
+BENCHMARK(strings_through_value)->Range(1 << 10, 1 << 16);
+BENCHMARK(strings_batch)->Range(1 << 10, 1 << 16);
@@ -0,0 +1,161 @@
+#include "optional-fields.h"
+#include "optional.h"
+#include "perf-counters.h"
+
+#include <benchmark/benchmark.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace {
+
+// A record with a typical mix of members, declared in an order that leaves the flags of each optional padded
+struct record {
+  optional<std::int32_t> id;
+  optional<double> price;
+  optional<char> side;
+  optional<std::int64_t> timestamp;
+  optional<std::int16_t> venue;
+  optional<double> quantity;
+  optional<std::int32_t> account;
+  optional<char> flags;
+  optional<std::int64_t> order;
+  optional<std::int32_t> parent;
+  optional<double> fee;
+  optional<std::int16_t> currency;
+
+  std::size_t count() const noexcept {
+    return id.has_value() + price.has_value() + side.has_value() + timestamp.has_value() + venue.has_value() +
+           quantity.has_value() + account.has_value() + flags.has_value() + order.has_value() + parent.has_value() +
+           fee.has_value() + currency.has_value();
+  }
+};
+
+using record_fields = optional_fields<
+    std::int32_t,
+    double,
+    char,
+    std::int64_t,
+    std::int16_t,
+    double,
+    std::int32_t,
+    char,
+    std::int64_t,
+    std::int32_t,
+    double,
+    std::int16_t>;
+
+constexpr std::size_t records = 1 << 20;
+
+std::vector<record> make_records() {
+  std::vector<record> result(records);
+  for (std::size_t i = 0; i < records; ++i) {
+    if (i % 2 == 0) {
+      result[i].price = static_cast<double>(i);
+    }
+    if (i % 3 == 0) {
+      result[i].timestamp = static_cast<std::int64_t>(i);
+    }
+    result[i].id = static_cast<std::int32_t>(i);
+  }
+  return result;
+}
+
+std::vector<record_fields> make_fields() {
+  std::vector<record_fields> result(records);
+  for (std::size_t i = 0; i < records; ++i) {
+    if (i % 2 == 0) {
+      result[i].get<1>() = static_cast<double>(i);
+    }
+    if (i % 3 == 0) {
+      result[i].get<3>() = static_cast<std::int64_t>(i);
+    }
+    result[i].get<0>() = static_cast<std::int32_t>(i);
+  }
+  return result;
+}
+
+template <typename Row>
+void finish(benchmark::State& state) {
+  state.SetItemsProcessed(state.iterations() * static_cast<std::int64_t>(records));
+  state.SetBytesProcessed(state.iterations() * static_cast<std::int64_t>(records * sizeof(Row)));
+  state.counters["row_bytes"] = static_cast<double>(sizeof(Row));
+}
+
+void count_struct(benchmark::State& state) {
+  auto rows = make_records();
+  for (auto _ : counted(state, static_cast<std::int64_t>(records))) {
+    std::size_t total = 0;
+    for (const auto& row : rows) {
+      total += row.count();
+    }
+    benchmark::DoNotOptimize(total);
+  }
+  finish<record>(state);
+}
+
+void count_fields(benchmark::State& state) {
+  auto rows = make_fields();
+  for (auto _ : counted(state, static_cast<std::int64_t>(records))) {
+    std::size_t total = 0;
+    for (const auto& row : rows) {
+      total += row.count();
+    }
+    benchmark::DoNotOptimize(total);
+  }
+  finish<record_fields>(state);
+}
+
+void sum_struct(benchmark::State& state) {
+  auto rows = make_records();
+  for (auto _ : counted(state, static_cast<std::int64_t>(records))) {
+    double total = 0;
+    for (const auto& row : rows) {
+      total += row.price.has_value() ? *row.price : 0.0;
+    }
+    benchmark::DoNotOptimize(total);
+  }
+  finish<record>(state);
+}
+
+void sum_fields(benchmark::State& state) {
+  auto rows = make_fields();
+  for (auto _ : counted(state, static_cast<std::int64_t>(records))) {
+    double total = 0;
+    for (const auto& row : rows) {
+      total += row.get<1>().value_or(0.0);
+    }
+    benchmark::DoNotOptimize(total);
+  }
+  finish<record_fields>(state);
+}
+
+void copy_struct(benchmark::State& state) {
+  auto rows = make_records();
+  std::vector<record> copy(records);
+  for (auto _ : counted(state, static_cast<std::int64_t>(records))) {
+    copy = rows;
+    benchmark::ClobberMemory();
+  }
+  finish<record>(state);
+}
+
+void copy_fields(benchmark::State& state) {
+  auto rows = make_fields();
+  std::vector<record_fields> copy(records);
+  for (auto _ : counted(state, static_cast<std::int64_t>(records))) {
+    copy = rows;
+    benchmark::ClobberMemory();
+  }
+  finish<record_fields>(state);
+}
+
+} // namespace
+
+BENCHMARK(count_struct);
+BENCHMARK(count_fields);
+BENCHMARK(sum_struct);
+BENCHMARK(sum_fields);
+BENCHMARK(copy_struct);
+BENCHMARK(copy_fields);
@@ -0,0 +1,134 @@
+#include "optional-fill.h"
+#include "perf-counters.h"
+
+#include <benchmark/benchmark.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+namespace {
+
+// Argument: percentage of engaged elements, placed at random so that a branch on them is unpredictable
+std::vector<optional<double>> make_series(benchmark::State& state) {
+  std::mt19937_64 random(1);
+  std::bernoulli_distribution engaged(static_cast<double>(state.range(1)) / 100);
+  std::vector<optional<double>> result(static_cast<std::size_t>(state.range(0)));
+  for (std::size_t i = 0; i < result.size(); ++i) {
+    if (engaged(random)) {
+      result[i] = static_cast<double>(i);
+    }
+  }
+  return result;
+}
+
+void finish(benchmark::State& state) {
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+void value_or_loop(benchmark::State& state) {
+  auto series = make_series(state);
+  std::vector<double> out(series.size());
+  for (auto _ : counted(state, state.range(0))) {
+    for (std::size_t i = 0; i < series.size(); ++i) {
+      out[i] = series[i].has_value() ? *series[i] : 0.0;
+    }
+    benchmark::ClobberMemory();
+  }
+  finish(state);
+}
+
+void value_or_kernel(benchmark::State& state) {
+  auto series = make_series(state);
+  std::vector<double> out(series.size());
+  for (auto _ : counted(state, state.range(0))) {
+    fill_value_or<double>(series, out, 0.0);
+    benchmark::ClobberMemory();
+  }
+  finish(state);
+}
+
+// Last observation carried forward, written by hand with a branch per element
+void forward_fill_loop(benchmark::State& state) {
+  auto series = make_series(state);
+  auto values = series;
+  for (auto _ : counted(state, state.range(0))) {
+    state.PauseTiming();
+    values = series;
+    state.ResumeTiming();
+    const optional<double>* last = nullptr;
+    for (auto& value : values) {
+      if (value.has_value()) {
+        last = &value;
+      } else if (last != nullptr) {
+        value = **last;
+      }
+    }
+    benchmark::ClobberMemory();
+  }
+  finish(state);
+}
+
+void forward_fill_kernel(benchmark::State& state) {
+  auto series = make_series(state);
+  auto values = series;
+  for (auto _ : counted(state, state.range(0))) {
+    state.PauseTiming();
+    values = series;
+    state.ResumeTiming();
+    forward_fill<double>(values);
+    benchmark::ClobberMemory();
+  }
+  finish(state);
+}
+
+void forward_fill_parallel(benchmark::State& state) {
+  auto series = make_series(state);
+  auto values = series;
+  for (auto _ : counted(state, state.range(0))) {
+    state.PauseTiming();
+    values = series;
+    state.ResumeTiming();
+    parallel_forward_fill<double>(values);
+    benchmark::ClobberMemory();
+  }
+  finish(state);
+}
+
+void forward_fill_dense_kernel(benchmark::State& state) {
+  auto series = make_series(state);
+  std::vector<double> out(series.size());
+  for (auto _ : counted(state, state.range(0))) {
+    forward_fill<double>(series, out, 0.0);
+    benchmark::ClobberMemory();
+  }
+  finish(state);
+}
+
+void forward_fill_dense_parallel(benchmark::State& state) {
+  auto series = make_series(state);
+  std::vector<double> out(series.size());
+  for (auto _ : counted(state, state.range(0))) {
+    parallel_forward_fill<double>(series, out, 0.0);
+    benchmark::ClobberMemory();
+  }
+  finish(state);
+}
+
+void arguments(benchmark::internal::Benchmark* benchmark) {
+  for (int percent : {10, 50, 90}) {
+    benchmark->Args({1 << 16, percent});
+  }
+  benchmark->Args({1 << 24, 50});
+}
+
+} // namespace
+
+BENCHMARK(value_or_loop)->Apply(arguments);
+BENCHMARK(value_or_kernel)->Apply(arguments);
+BENCHMARK(forward_fill_loop)->Apply(arguments);
+BENCHMARK(forward_fill_kernel)->Apply(arguments);
+BENCHMARK(forward_fill_parallel)->Args({1 << 24, 50})->UseRealTime();
+BENCHMARK(forward_fill_dense_kernel)->Apply(arguments);
+BENCHMARK(forward_fill_dense_parallel)->Args({1 << 24, 50})->UseRealTime();
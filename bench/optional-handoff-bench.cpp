@@ -0,0 +1,131 @@
+#include "optional.h"
+#include "perf-counters.h"
+
+#include <benchmark/benchmark.h>
+
+#include <array>
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+
+// Expensive to move: a move copies all of its bytes
+struct block {
+  std::array<std::size_t, 64> words;
+};
+
+block make_block(std::size_t seed) {
+  block result;
+  for (std::size_t i = 0; i < result.words.size(); ++i) {
+    result.words[i] = seed + i;
+  }
+  return result;
+}
+
+void emplace_temporary(benchmark::State& state) {
+  optional<block> slot;
+  std::size_t seed = 0;
+  for (auto _ : counted(state)) {
+    slot.emplace(make_block(seed++));
+    benchmark::DoNotOptimize(slot);
+  }
+}
+
+void emplace_with_factory(benchmark::State& state) {
+  optional<block> slot;
+  std::size_t seed = 0;
+  for (auto _ : counted(state)) {
+    slot.emplace_with([&] { return make_block(seed++); });
+    benchmark::DoNotOptimize(slot);
+  }
+}
+
+std::vector<optional<std::string>> filled_slots(std::size_t count) {
+  std::vector<optional<std::string>> slots(count);
+  for (std::size_t i = 0; i < count; ++i) {
+    slots[i] = std::string(32 + i % 32, 'x');
+  }
+  return slots;
+}
+
+// Move out and clear by hand: a move, then a destructor call on the moved-from string. Each value is put back
+// afterwards, so that the next iteration finds the slots engaged again.
+void move_then_reset(benchmark::State& state) {
+  auto slots = filled_slots(static_cast<std::size_t>(state.range(0)));
+  for (auto _ : counted(state, state.range(0))) {
+    for (auto& slot : slots) {
+      std::string value = std::move(*slot);
+      slot.reset();
+      benchmark::DoNotOptimize(value);
+      slot.emplace(std::move(value));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+// The same handoff into an optional, which is what take() replaces
+void move_into_optional(benchmark::State& state) {
+  auto slots = filled_slots(static_cast<std::size_t>(state.range(0)));
+  for (auto _ : counted(state, state.range(0))) {
+    for (auto& slot : slots) {
+      optional<std::string> value;
+      if (slot.has_value()) {
+        value.emplace(std::move(*slot));
+        slot.reset();
+      }
+      benchmark::DoNotOptimize(value);
+      slot.emplace(std::move(*value));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+void take(benchmark::State& state) {
+  auto slots = filled_slots(static_cast<std::size_t>(state.range(0)));
+  for (auto _ : counted(state, state.range(0))) {
+    for (auto& slot : slots) {
+      optional<std::string> value = slot.take();
+      benchmark::DoNotOptimize(value);
+      slot.emplace(std::move(*value));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+// Swapping in a new value and keeping the old one
+void exchange_by_hand(benchmark::State& state) {
+  auto slots = filled_slots(static_cast<std::size_t>(state.range(0)));
+  std::string next(40, 'y');
+  for (auto _ : counted(state, state.range(0))) {
+    for (auto& slot : slots) {
+      optional<std::string> old = std::move(slot);
+      slot = next;
+      benchmark::DoNotOptimize(old);
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+void replace(benchmark::State& state) {
+  auto slots = filled_slots(static_cast<std::size_t>(state.range(0)));
+  std::string next(40, 'y');
+  for (auto _ : counted(state, state.range(0))) {
+    for (auto& slot : slots) {
+      optional<std::string> old = slot.replace(next);
+      benchmark::DoNotOptimize(old);
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+} // namespace
+
+BENCHMARK(emplace_temporary);
+BENCHMARK(emplace_with_factory);
+BENCHMARK(move_then_reset)->Arg(1 << 10);
+BENCHMARK(move_into_optional)->Arg(1 << 10);
+BENCHMARK(take)->Arg(1 << 10);
+BENCHMARK(exchange_by_hand)->Arg(1 << 10);
+BENCHMARK(replace)->Arg(1 << 10);
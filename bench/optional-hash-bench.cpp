@@ -0,0 +1,66 @@
+#include "optional-hash.h"
+#include "perf-counters.h"
+
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <random>
+#include <vector>
+
+namespace {
+
+std::vector<optional<std::uint64_t>> random_values(std::size_t count) {
+  std::mt19937_64 rng(1);
+  std::vector<optional<std::uint64_t>> values(count);
+  for (auto& value : values) {
+    std::uint64_t x = rng();
+    // roughly one in eight disengaged
+    if ((x & 7) != 0) {
+      value = x;
+    }
+  }
+  return values;
+}
+
+void std_hash(benchmark::State& state) {
+  auto values = random_values(static_cast<std::size_t>(state.range(0)));
+  std::vector<std::uint64_t> out(values.size());
+  for (auto _ : counted(state, state.range(0))) {
+    for (std::size_t i = 0; i < values.size(); ++i) {
+      out[i] = std::hash<optional<std::uint64_t>>{}(values[i]);
+    }
+    benchmark::DoNotOptimize(out.data());
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+void mixed_hash_loop(benchmark::State& state) {
+  auto values = random_values(static_cast<std::size_t>(state.range(0)));
+  std::vector<std::uint64_t> out(values.size());
+  for (auto _ : counted(state, state.range(0))) {
+    for (std::size_t i = 0; i < values.size(); ++i) {
+      out[i] = mixed_hash(values[i]);
+    }
+    benchmark::DoNotOptimize(out.data());
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+void batch(benchmark::State& state) {
+  auto values = random_values(static_cast<std::size_t>(state.range(0)));
+  std::vector<std::uint64_t> out(values.size());
+  for (auto _ : counted(state, state.range(0))) {
+    batch_hash<std::uint64_t>(values, out);
+    benchmark::DoNotOptimize(out.data());
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+} // namespace
+
+BENCHMARK(std_hash)->Range(1 << 10, 1 << 20);
+BENCHMARK(mixed_hash_loop)->Range(1 << 10, 1 << 20);
+BENCHMARK(batch)->Range(1 << 10, 1 << 20);
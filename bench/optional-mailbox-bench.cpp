@@ -0,0 +1,133 @@
+#include "optional-mailbox.h"
+#include "optional.h"
+#include "perf-counters.h"
+
+#include <benchmark/benchmark.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace {
+
+struct order {
+  std::uint64_t id;
+  double price;
+  std::int64_t quantity;
+};
+
+using book = std::vector<order>;
+
+constexpr std::size_t book_size = 256;
+
+void fill(optional<book>& target, std::uint64_t version) {
+  if (!target.has_value()) {
+    target.emplace();
+  }
+  target->resize(book_size);
+  for (std::size_t i = 0; i < book_size; ++i) {
+    (*target)[i] = {version + i, 100.0 + static_cast<double>(i), static_cast<std::int64_t>(i)};
+  }
+}
+
+// The usual alternative: a mutex, and a copy for every reader so that it can use the value after unlocking
+struct locked_book {
+  std::mutex mutex;
+  optional<book> value;
+
+  void publish(std::uint64_t version) {
+    std::lock_guard lock(mutex);
+    fill(value, version);
+  }
+
+  optional<book> read() {
+    std::lock_guard lock(mutex);
+    return value;
+  }
+};
+
+void locked_read_unchanged(benchmark::State& state) {
+  locked_book shared;
+  shared.publish(0);
+  for (auto _ : counted(state)) {
+    auto snapshot = shared.read();
+    benchmark::DoNotOptimize(snapshot->front().id);
+  }
+}
+
+void mailbox_read_unchanged(benchmark::State& state) {
+  optional_mailbox<book> mailbox;
+  auto reader = mailbox.make_reader();
+  fill(mailbox.back(), 0);
+  mailbox.publish();
+  for (auto _ : counted(state)) {
+    const auto& snapshot = reader->read();
+    benchmark::DoNotOptimize(snapshot->front().id);
+  }
+}
+
+// One publish and one read of the new value per iteration: the end-to-end cost of a handoff
+void locked_handoff(benchmark::State& state) {
+  locked_book shared;
+  std::uint64_t version = 0;
+  for (auto _ : counted(state)) {
+    shared.publish(version++);
+    auto snapshot = shared.read();
+    benchmark::DoNotOptimize(snapshot->front().id);
+  }
+}
+
+void mailbox_handoff(benchmark::State& state) {
+  optional_mailbox<book> mailbox;
+  auto reader = mailbox.make_reader();
+  std::uint64_t version = 0;
+  for (auto _ : counted(state)) {
+    fill(mailbox.back(), version++);
+    mailbox.publish();
+    const auto& snapshot = reader->read();
+    benchmark::DoNotOptimize(snapshot->front().id);
+  }
+}
+
+// Thread 0 publishes continuously, the others read; the time is per publish or per read
+constexpr std::size_t max_threads = 8;
+
+void locked_contended(benchmark::State& state) {
+  static locked_book shared;
+  std::uint64_t version = 0;
+  for (auto _ : counted(state)) {
+    if (state.thread_index() == 0) {
+      shared.publish(version++);
+    } else {
+      auto snapshot = shared.read();
+      benchmark::DoNotOptimize(snapshot);
+    }
+  }
+}
+
+void mailbox_contended(benchmark::State& state) {
+  static optional_mailbox<book> mailbox(max_threads - 1);
+  std::uint64_t version = 0;
+  if (state.thread_index() == 0) {
+    for (auto _ : counted(state)) {
+      fill(mailbox.back(), version++);
+      mailbox.publish();
+    }
+  } else {
+    auto reader = mailbox.make_reader();
+    for (auto _ : counted(state)) {
+      const auto& snapshot = reader->read();
+      benchmark::DoNotOptimize(snapshot);
+    }
+  }
+}
+
+} // namespace
+
+BENCHMARK(locked_read_unchanged);
+BENCHMARK(mailbox_read_unchanged);
+BENCHMARK(locked_handoff);
+BENCHMARK(mailbox_handoff);
+BENCHMARK(locked_contended)->Threads(2)->Threads(4)->Threads(max_threads)->UseRealTime();
+BENCHMARK(mailbox_contended)->Threads(2)->Threads(4)->Threads(max_threads)->UseRealTime();
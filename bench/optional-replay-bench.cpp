@@ -0,0 +1,51 @@
+#include "optional-trace.h"
+#include "optional.h"
+#include "perf-counters.h"
+
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <optional>
+#include <string>
+
+namespace {
+
+// The trace in $OPTIONAL_TRACE if set, otherwise a generated one with the given share of engaged stores
+const optional_trace& trace_for(int engaged_percent) {
+  static std::map<int, optional_trace> traces;
+  auto [it, inserted] = traces.try_emplace(engaged_percent);
+  if (inserted) {
+    if (const char* path = std::getenv("OPTIONAL_TRACE")) {
+      std::ifstream in(path);
+      it->second = read_trace(in);
+    } else {
+      trace_config config;
+      config.operations = 1'000'000;
+      config.slots = 256;
+      config.engaged_ratio = engaged_percent / 100.0;
+      it->second = generate_trace(config);
+    }
+  }
+  return it->second;
+}
+
+template <typename Optional>
+void replay(benchmark::State& state) {
+  const optional_trace& trace = trace_for(static_cast<int>(state.range(0)));
+  trace_replayer<Optional> replayer(trace);
+  for (auto _ : counted(state, static_cast<std::int64_t>(trace.records.size()))) {
+    benchmark::DoNotOptimize(replayer.run());
+  }
+  state.SetItemsProcessed(state.iterations() * static_cast<std::int64_t>(trace.records.size()));
+}
+
+} // namespace
+
+// Argument: percentage of stores that engage, ignored for a trace from $OPTIONAL_TRACE
+BENCHMARK_TEMPLATE(replay, optional<int>)->Arg(10)->Arg(50)->Arg(90);
+BENCHMARK_TEMPLATE(replay, std::optional<int>)->Arg(10)->Arg(50)->Arg(90);
+BENCHMARK_TEMPLATE(replay, optional<std::string>)->Arg(10)->Arg(50)->Arg(90);
+BENCHMARK_TEMPLATE(replay, std::optional<std::string>)->Arg(10)->Arg(50)->Arg(90);
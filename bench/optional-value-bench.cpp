@@ -0,0 +1,59 @@
+#include "optional.h"
+#include "perf-counters.h"
+
+#include <benchmark/benchmark.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace {
+
+// Every element is engaged: the check in value() never fails, and what is measured is the cost of having it
+std::vector<optional<int>> make_values(benchmark::State& state) {
+  std::vector<optional<int>> result(static_cast<std::size_t>(state.range(0)));
+  for (std::size_t i = 0; i < result.size(); ++i) {
+    result[i] = static_cast<int>(i);
+  }
+  return result;
+}
+
+// A checked access that builds and throws the exception in place, for comparison with the out-of-line throw of value()
+template <typename T>
+const T& inline_throw_value(const optional<T>& opt) {
+  if (!opt.has_value()) {
+    throw bad_optional_access();
+  }
+  return *opt;
+}
+
+template <typename Access>
+void sum(benchmark::State& state, Access access) {
+  auto values = make_values(state);
+  for (auto _ : counted(state, state.range(0))) {
+    std::int64_t total = 0;
+    for (const auto& value : values) {
+      total += access(value);
+    }
+    benchmark::DoNotOptimize(total);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+void dereference_sum(benchmark::State& state) {
+  sum(state, [](const optional<int>& opt) { return *opt; });
+}
+
+void value_sum(benchmark::State& state) {
+  sum(state, [](const optional<int>& opt) { return opt.value(); });
+}
+
+void inline_throw_value_sum(benchmark::State& state) {
+  sum(state, [](const optional<int>& opt) { return inline_throw_value(opt); });
+}
+
+} // namespace
+
+BENCHMARK(dereference_sum)->Arg(1 << 10)->Arg(1 << 16);
+BENCHMARK(value_sum)->Arg(1 << 10)->Arg(1 << 16);
+BENCHMARK(inline_throw_value_sum)->Arg(1 << 10)->Arg(1 << 16);
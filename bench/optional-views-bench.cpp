@@ -0,0 +1,141 @@
+#include "optional-column.h"
+#include "optional-views.h"
+#include "optional.h"
+#include "perf-counters.h"
+
+#include <benchmark/benchmark.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <ranges>
+#include <vector>
+
+namespace {
+
+// Argument: percentage of engaged elements
+std::vector<optional<std::int64_t>> make_values(int percent, std::size_t count) {
+  std::vector<optional<std::int64_t>> result(count);
+  for (std::size_t i = 0; i < count; ++i) {
+    if (static_cast<int>((i * 37) % 100) < percent) {
+      result[i] = static_cast<std::int64_t>(i);
+    }
+  }
+  return result;
+}
+
+optional<std::int64_t> halve_even(const optional<std::int64_t>& value) {
+  return *value % 2 == 0 ? optional<std::int64_t>(*value / 2) : optional<std::int64_t>();
+}
+
+constexpr std::size_t count = 1 << 20;
+
+void finish(benchmark::State& state) {
+  state.SetItemsProcessed(state.iterations() * static_cast<std::int64_t>(count));
+}
+
+// engaged | transform | values, with a vector after every step
+void pipeline_materialized(benchmark::State& state) {
+  auto values = make_values(static_cast<int>(state.range(0)), count);
+  for (auto _ : counted(state, static_cast<std::int64_t>(count))) {
+    std::vector<optional<std::int64_t>> engaged;
+    for (const auto& value : values) {
+      if (value.has_value()) {
+        engaged.push_back(value);
+      }
+    }
+    std::vector<optional<std::int64_t>> transformed;
+    transformed.reserve(engaged.size());
+    for (const auto& value : engaged) {
+      transformed.push_back(halve_even(value));
+    }
+    std::vector<std::int64_t> unwrapped;
+    for (const auto& value : transformed) {
+      if (value.has_value()) {
+        unwrapped.push_back(*value);
+      }
+    }
+    std::int64_t sum = 0;
+    for (std::int64_t value : unwrapped) {
+      sum += value;
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+  finish(state);
+}
+
+void pipeline_views(benchmark::State& state) {
+  auto values = make_values(static_cast<int>(state.range(0)), count);
+  for (auto _ : counted(state, static_cast<std::int64_t>(count))) {
+    std::int64_t sum = 0;
+    for (std::int64_t value : values | views::engaged | std::views::transform(halve_even) | views::values) {
+      sum += value;
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+  finish(state);
+}
+
+void value_or_materialized(benchmark::State& state) {
+  auto values = make_values(static_cast<int>(state.range(0)), count);
+  for (auto _ : counted(state, static_cast<std::int64_t>(count))) {
+    std::vector<std::int64_t> defaulted;
+    defaulted.reserve(values.size());
+    for (const auto& value : values) {
+      defaulted.push_back(value.has_value() ? *value : -1);
+    }
+    std::int64_t sum = 0;
+    for (std::int64_t value : defaulted) {
+      sum += value;
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+  finish(state);
+}
+
+void value_or_views(benchmark::State& state) {
+  auto values = make_values(static_cast<int>(state.range(0)), count);
+  for (auto _ : counted(state, static_cast<std::int64_t>(count))) {
+    std::int64_t sum = 0;
+    for (std::int64_t value : values | views::value_or(std::int64_t(-1))) {
+      sum += value;
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+  finish(state);
+}
+
+void values_vector(benchmark::State& state) {
+  auto values = make_values(static_cast<int>(state.range(0)), count);
+  for (auto _ : counted(state, static_cast<std::int64_t>(count))) {
+    std::int64_t sum = 0;
+    for (std::int64_t value : values | views::values) {
+      sum += value;
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+  finish(state);
+}
+
+void values_column(benchmark::State& state) {
+  optional_column<std::int64_t> column;
+  for (const auto& value : make_values(static_cast<int>(state.range(0)), count)) {
+    column.push_back(value);
+  }
+  for (auto _ : counted(state, static_cast<std::int64_t>(count))) {
+    std::int64_t sum = 0;
+    for (std::int64_t value : column | views::values) {
+      sum += value;
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+  finish(state);
+}
+
+} // namespace
+
+BENCHMARK(pipeline_materialized)->Arg(10)->Arg(50)->Arg(90);
+BENCHMARK(pipeline_views)->Arg(10)->Arg(50)->Arg(90);
+BENCHMARK(value_or_materialized)->Arg(10)->Arg(50)->Arg(90);
+BENCHMARK(value_or_views)->Arg(10)->Arg(50)->Arg(90);
+BENCHMARK(values_vector)->Arg(1)->Arg(10)->Arg(50);
+BENCHMARK(values_column)->Arg(1)->Arg(10)->Arg(50);
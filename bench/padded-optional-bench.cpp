@@ -0,0 +1,45 @@
+#include "optional.h"
+#include "padded-optional.h"
+#include "perf-counters.h"
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <thread>
+
+namespace {
+
+struct stats {
+  std::uint64_t count;
+  std::uint64_t sum;
+};
+
+constexpr std::size_t max_slots = 256;
+
+template <typename Slot>
+void per_thread_update(benchmark::State& state) {
+  static Slot slots[max_slots];
+
+  Slot& slot = slots[state.thread_index()];
+  slot.emplace(stats{0, 0});
+
+  for (auto _ : counted(state)) {
+    stats& s = *slot;
+    ++s.count;
+    s.sum += static_cast<std::uint64_t>(state.iterations());
+    benchmark::ClobberMemory();
+  }
+
+  benchmark::DoNotOptimize(slot->sum);
+  state.SetItemsProcessed(state.iterations());
+}
+
+int max_threads() {
+  return static_cast<int>(std::clamp<unsigned>(std::thread::hardware_concurrency(), 1, max_slots));
+}
+
+} // namespace
+
+BENCHMARK(per_thread_update<optional<stats>>)->ThreadRange(1, max_threads())->UseRealTime();
+BENCHMARK(per_thread_update<padded_optional<stats>>)->ThreadRange(1, max_threads())->UseRealTime();
@@ -0,0 +1,203 @@
+#pragma once
+
+#include <benchmark/benchmark.h>
+
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// Hardware event counts per operation next to the timings: write
+//
+//   for (auto _ : counted(state, operations_per_iteration)) { ... }
+//
+// instead of for (auto _ : state), and the benchmark reports cycles, instructions, branch misses and L1D read misses
+// of the calling thread, divided by the number of operations. Time spent in PauseTiming sections is counted too.
+//
+// The counters come from perf_event_open and only count user-space events. When it is not available (not Linux, a
+// container whose seccomp profile forbids it, perf_event_paranoid above 2, or a virtual machine without a PMU), the
+// benchmarks report their timings alone, after one note on stderr. Events that the CPU lacks are left out one by one.
+class perf_event_counters {
+public:
+  static constexpr std::size_t event_count = 4;
+
+  static constexpr std::array<const char*, event_count> names = {
+      "cycles",
+      "instructions",
+      "branch-misses",
+      "L1D-misses",
+  };
+
+  // Opened once per thread, on first use
+  static perf_event_counters& for_this_thread() {
+    thread_local perf_event_counters counters;
+    return counters;
+  }
+
+  perf_event_counters(const perf_event_counters&) = delete;
+  perf_event_counters& operator=(const perf_event_counters&) = delete;
+
+  ~perf_event_counters() {
+#ifdef __linux__
+    for (int fd : fds) {
+      if (fd >= 0) {
+        close(fd);
+      }
+    }
+#endif
+  }
+
+  bool available() const noexcept {
+    return leader >= 0;
+  }
+
+  void start() noexcept {
+#ifdef __linux__
+    if (available()) {
+      ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+      ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+#endif
+  }
+
+  // Stops counting and adds the counts, divided by operations, to the counters of the benchmark
+  void stop(benchmark::State& state, double operations) noexcept {
+#ifdef __linux__
+    if (!available()) {
+      return;
+    }
+    ioctl(leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+
+    // PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING
+    struct {
+      std::uint64_t size;
+      std::uint64_t time_enabled;
+      std::uint64_t time_running;
+      std::uint64_t values[event_count];
+    } data{};
+    if (read(leader, &data, sizeof(data)) < 0 || data.time_running == 0) {
+      return;
+    }
+    // The kernel multiplexes the events when there are more of them than hardware counters
+    double scale = static_cast<double>(data.time_enabled) / static_cast<double>(data.time_running);
+    std::size_t next = 0;
+    for (std::size_t i = 0; i < event_count; ++i) {
+      if (fds[i] >= 0) {
+        double count = static_cast<double>(data.values[next++]) * scale / operations;
+        state.counters[names[i]] = benchmark::Counter(count, benchmark::Counter::kAvgIterations);
+      }
+    }
+#else
+    static_cast<void>(state);
+    static_cast<void>(operations);
+#endif
+  }
+
+private:
+  perf_event_counters() {
+#ifdef __linux__
+    constexpr std::array<std::uint64_t, event_count> configs = {
+        PERF_COUNT_HW_CPU_CYCLES,
+        PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_BRANCH_MISSES,
+        PERF_COUNT_HW_CACHE_L1D | PERF_COUNT_HW_CACHE_OP_READ << 8 | PERF_COUNT_HW_CACHE_RESULT_MISS << 16,
+    };
+    int error = 0;
+    for (std::size_t i = 0; i < event_count; ++i) {
+      perf_event_attr attr{};
+      attr.size = sizeof(attr);
+      attr.type = i + 1 == event_count ? PERF_TYPE_HW_CACHE : PERF_TYPE_HARDWARE;
+      attr.config = configs[i];
+      attr.disabled = leader < 0;
+      attr.exclude_kernel = 1;
+      attr.exclude_hv = 1;
+      attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+      fds[i] = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, leader, 0));
+      if (fds[i] < 0) {
+        error = errno;
+      } else if (leader < 0) {
+        leader = fds[i];
+      }
+    }
+    if (leader < 0) {
+      report_unavailable(std::strerror(error));
+    }
+#else
+    report_unavailable("not supported on this platform");
+#endif
+  }
+
+  static void report_unavailable(const std::string& reason) {
+    static std::atomic<bool> reported = false;
+    if (!reported.exchange(true)) {
+      std::fprintf(
+          stderr, "Hardware performance counters are unavailable (%s), reporting timings only\n", reason.c_str()
+      );
+    }
+  }
+
+  std::array<int, event_count> fds = {-1, -1, -1, -1};
+  int leader = -1;
+};
+
+// A drop-in replacement for the State in a range-for that wraps the timed loop in perf_event_counters
+class counted {
+public:
+  explicit counted(benchmark::State& state, std::int64_t operations_per_iteration = 1)
+      : state(state)
+      , operations(static_cast<double>(operations_per_iteration))
+      , counters(perf_event_counters::for_this_thread()) {}
+
+  class iterator {
+  public:
+    iterator(benchmark::State::StateIterator current, counted* loop)
+        : current(current)
+        , loop(loop) {}
+
+    auto operator*() const {
+      return *current;
+    }
+
+    iterator& operator++() {
+      ++current;
+      return *this;
+    }
+
+    bool operator!=(const iterator& end) const {
+      if (current != end.current) {
+        return true;
+      }
+      loop->counters.stop(loop->state, loop->operations);
+      return false;
+    }
+
+  private:
+    benchmark::State::StateIterator current;
+    counted* loop;
+  };
+
+  iterator begin() {
+    iterator result(state.begin(), this);
+    counters.start();
+    return result;
+  }
+
+  iterator end() {
+    return iterator(state.end(), this);
+  }
+
+private:
+  benchmark::State& state;
+  double operations;
+  perf_event_counters& counters;
+};
@@ -0,0 +1,201 @@
+#!/usr/bin/env python3
+"""Compiles a probe source to assembly and checks the expectations written in its comments.
+
+Expectations are comment lines of the form `// <prefix>: <check> <args>`:
+
+  same F G          F and G have identical instructions (local labels are renumbered)
+  forbid F REGEX    no instruction of F matches REGEX; F may be a glob such as `*` for every function
+  require F REGEX   some instruction of F matches REGEX
+
+With --baseline, every function of the probe is also held to the instruction and branch counts recorded in the
+baseline file, one `function instructions branches` line each. --update-baseline rewrites that file instead.
+
+Functions are looked up by their assembly symbol, so probes should declare them extern "C".
+"""
+
+import argparse
+import difflib
+import fnmatch
+import os
+import re
+import subprocess
+import sys
+
+# Reported to ctest as "skipped" when there is no baseline for the compiler in use
+SKIP_EXIT_CODE = 77
+
+LOCAL_LABEL = re.compile(r"\.L\w+")
+BRANCH = re.compile(r"^j[a-z]+ ")
+# Function begin/end markers emitted by GCC (.LFB/.LFE) and Clang (.Lfunc_begin/.Lfunc_end)
+BOUNDARY_LABEL = re.compile(r"\.L(FB|FE|func_begin|func_end)\d+$")
+
+
+def compile_to_assembly(compiler, source, flags):
+    command = [compiler, "-std=c++20", "-O2", "-S", "-o", "-", "-fno-asynchronous-unwind-tables", *flags, source]
+    result = subprocess.run(command, capture_output=True, text=True)
+    if result.returncode != 0:
+        sys.exit(f"compilation failed: {' '.join(command)}\n{result.stderr}")
+    return result.stdout
+
+
+def parse_functions(assembly):
+    """Maps each global symbol to its instructions, with local labels kept as `L<n>:` lines."""
+    functions = {}
+    current = None
+    for raw_line in assembly.splitlines():
+        line = raw_line.split("#", 1)[0].rstrip()
+        stripped = line.strip()
+        if not stripped:
+            continue
+        if not line[0].isspace() and stripped.endswith(":"):
+            label = stripped[:-1]
+            if not label.startswith("."):
+                current = functions.setdefault(label, [])
+            elif current is not None and not BOUNDARY_LABEL.match(label):
+                current.append(label + ":")
+            continue
+        if current is None or stripped.startswith("."):
+            if stripped.startswith(".size"):
+                current = None
+            continue
+        current.append(" ".join(stripped.split()))
+    return {name: renumber_labels(body) for name, body in functions.items()}
+
+
+def renumber_labels(body):
+    names = {}
+    for line in body:
+        for label in LOCAL_LABEL.findall(line):
+            names.setdefault(label, f"L{len(names)}")
+    return [LOCAL_LABEL.sub(lambda m: names[m.group(0)], line) for line in body]
+
+
+def parse_expectations(source, prefix):
+    pattern = re.compile(r"^\s*//\s*" + re.escape(prefix) + r":\s*(\w+)\s+(\S+)\s+(.+?)\s*$")
+    with open(source) as file:
+        return [match.groups() for match in map(pattern.match, file) if match]
+
+
+def lookup(functions, name):
+    if name not in functions:
+        raise KeyError(f"function `{name}` not found in the assembly")
+    return functions[name]
+
+
+def check(functions, kind, target, argument):
+    if kind == "same":
+        lhs, rhs = lookup(functions, target), lookup(functions, argument)
+        if lhs == rhs:
+            return None
+        diff = difflib.unified_diff(rhs, lhs, fromfile=argument, tofile=target, lineterm="")
+        return f"{target} differs from {argument}:\n" + "\n".join(diff)
+
+    regex = re.compile(argument)
+    names = fnmatch.filter(sorted(functions), target) if any(c in target for c in "*?[") else [target]
+    if kind == "forbid":
+        hits = [f"  {name}: {line}" for name in names for line in lookup(functions, name) if regex.search(line)]
+        return f"forbidden /{argument}/ found:\n" + "\n".join(hits) if hits else None
+    if kind == "require":
+        if any(regex.search(line) for line in lookup(functions, target)):
+            return None
+        return f"{target} has no instruction matching /{argument}/:\n  " + "\n  ".join(functions[target])
+    raise ValueError(f"unknown check `{kind}`")
+
+
+def measure(body):
+    instructions = [line for line in body if not line.endswith(":")]
+    return len(instructions), sum(1 for line in instructions if BRANCH.match(line))
+
+
+def read_baseline(path):
+    budgets = {}
+    with open(path) as file:
+        for line in file:
+            line = line.split("#", 1)[0].strip()
+            if line:
+                name, instructions, branches = line.split()
+                budgets[name] = (int(instructions), int(branches))
+    return budgets
+
+
+def write_baseline(path, functions):
+    with open(path, "w") as file:
+        file.write("# function instructions branches\n")
+        for name in sorted(functions):
+            instructions, branches = measure(functions[name])
+            file.write(f"{name} {instructions} {branches}\n")
+
+
+def check_budgets(functions, budgets):
+    failures = []
+    improvements = []
+    for name in sorted(set(functions) | set(budgets)):
+        if name not in budgets:
+            failures.append(f"{name} has no budget in the baseline")
+            continue
+        if name not in functions:
+            failures.append(f"{name} is in the baseline but not in the assembly")
+            continue
+        actual = measure(functions[name])
+        budget = budgets[name]
+        if actual[0] > budget[0] or actual[1] > budget[1]:
+            failures.append(
+                f"{name}: {actual[0]} instructions, {actual[1]} branches "
+                f"(budget {budget[0]} instructions, {budget[1]} branches):\n  " + "\n  ".join(functions[name])
+            )
+        elif actual != budget:
+            improvements.append(f"{name}: {actual[0]}/{actual[1]}, baseline {budget[0]}/{budget[1]}")
+    if improvements:
+        print("under budget, consider updating the baseline:\n  " + "\n  ".join(improvements), end="\n\n")
+    return failures
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--compiler", required=True)
+    parser.add_argument("--source", required=True)
+    parser.add_argument("--prefix", default="codegen", help="comment prefix of the expectations to check")
+    parser.add_argument("--baseline", help="file with instruction and branch budgets")
+    parser.add_argument("--update-baseline", action="store_true", help="record the current counts as the baseline")
+    parser.add_argument("flags", nargs="*", help="extra compiler flags, after --")
+    args = parser.parse_args()
+
+    functions = parse_functions(compile_to_assembly(args.compiler, args.source, args.flags))
+
+    if args.update_baseline:
+        if not args.baseline:
+            sys.exit("--update-baseline needs --baseline")
+        write_baseline(args.baseline, functions)
+        print(f"wrote {len(functions)} budgets to {args.baseline}")
+        return 0
+
+    expectations = parse_expectations(args.source, args.prefix)
+    if not expectations and not args.baseline:
+        sys.exit(f"no `// {args.prefix}:` expectations in {args.source}")
+
+    failures = []
+    checked = len(expectations)
+    if args.baseline:
+        if not os.path.exists(args.baseline):
+            print(f"no baseline {args.baseline}; create it with --update-baseline")
+            return SKIP_EXIT_CODE
+        budgets = read_baseline(args.baseline)
+        failures += check_budgets(functions, budgets)
+        checked += len(set(functions) | set(budgets))
+
+    for kind, target, argument in expectations:
+        try:
+            failure = check(functions, kind, target, argument)
+        except (KeyError, ValueError) as error:
+            failure = str(error)
+        if failure:
+            failures.append(failure)
+
+    for failure in failures:
+        print(failure, end="\n\n")
+    print(f"{checked - len(failures)}/{checked} expectations hold")
+    return 1 if failures else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
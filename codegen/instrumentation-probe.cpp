@@ -0,0 +1,96 @@
+// Operations whose optional code paths carry instrumentation hooks. Built once as is, where the hooks must vanish,
+// and once with OPTIONAL_INSTRUMENTATION=1, to show that the probe really reaches them.
+
+#include "optional.h"
+
+#include <new>
+
+namespace {
+
+struct nontrivial {
+  int x;
+
+  nontrivial(int x) noexcept
+      : x(x) {}
+
+  nontrivial(const nontrivial& other) noexcept
+      : x(other.x) {}
+
+  nontrivial& operator=(const nontrivial& other) noexcept {
+    x = other.x;
+    return *this;
+  }
+};
+
+struct raw_nontrivial {
+  union {
+    char dummy;
+    nontrivial value;
+  };
+
+  bool engaged;
+};
+
+} // namespace
+
+// codegen: forbid * call|jmp\s+[^.L]|%fs:|__tls_get_addr
+// codegen: same optional_deref reference_deref
+// codegen: same optional_emplace reference_emplace
+// codegen: same optional_copy_assign reference_copy_assign
+
+// codegen-instrumented: require optional_deref call|jmp\s+[^.L]|%fs:|__tls_get_addr
+// codegen-instrumented: require optional_emplace call|jmp\s+[^.L]|%fs:|__tls_get_addr
+// codegen-instrumented: require optional_copy_assign call|jmp\s+[^.L]|%fs:|__tls_get_addr
+// codegen-instrumented: require optional_copy_construct call|jmp\s+[^.L]|%fs:|__tls_get_addr
+// codegen-instrumented: require optional_swap call|jmp\s+[^.L]|%fs:|__tls_get_addr
+// codegen-instrumented: require optional_reset call|jmp\s+[^.L]|%fs:|__tls_get_addr
+
+extern "C" {
+
+int optional_deref(const optional<nontrivial>* opt) {
+  return (*opt)->x;
+}
+
+int reference_deref(const raw_nontrivial* opt) {
+  return opt->value.x;
+}
+
+void optional_emplace(optional<nontrivial>* opt, int x) {
+  opt->emplace(x);
+}
+
+void reference_emplace(raw_nontrivial* opt, int x) {
+  if (opt->engaged) {
+    opt->engaged = false;
+  }
+  ::new (&opt->value) nontrivial(x);
+  opt->engaged = true;
+}
+
+void optional_copy_assign(optional<nontrivial>* dst, const optional<nontrivial>* src) {
+  *dst = *src;
+}
+
+void reference_copy_assign(raw_nontrivial* dst, const raw_nontrivial* src) {
+  if (dst->engaged && src->engaged) {
+    dst->value = src->value;
+  } else if (src->engaged) {
+    ::new (&dst->value) nontrivial(src->value);
+    dst->engaged = true;
+  } else {
+    dst->engaged = false;
+  }
+}
+
+void optional_copy_construct(optional<nontrivial>* dst, const optional<nontrivial>* src) {
+  ::new (dst) optional<nontrivial>(*src);
+}
+
+void optional_swap(optional<nontrivial>* lhs, optional<nontrivial>* rhs) {
+  lhs->swap(*rhs);
+}
+
+void optional_reset(optional<nontrivial>* opt) {
+  opt->reset();
+}
+}
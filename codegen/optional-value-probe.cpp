@@ -0,0 +1,66 @@
+// The checked accessor value() of optional<int>, each paired with the same test and branch written by hand on a plain
+// int + bool. Instruction and branch counts of every function are budgeted in codegen/baselines.
+
+#include "optional.h"
+
+namespace {
+
+struct raw {
+  int value;
+  bool engaged;
+};
+
+} // namespace
+
+// Building and throwing the exception stays in throw_bad_optional_access, shared by every optional<T>: neither the
+// callers, nor the cold parts GCC splits off them, nor the members of optional (`*8optional*` when mangled) contain it.
+// The budgets hold the hot path of optional_value to a test, a branch, the load and the return.
+// codegen: forbid optional_* __cxa_allocate_exception|__cxa_throw
+// codegen: forbid *8optional* __cxa_allocate_exception|__cxa_throw
+// codegen: same optional_value reference_value
+// codegen: same optional_assign_value reference_assign_value
+// codegen: same optional_value_sum reference_value_sum
+
+extern "C" {
+
+int optional_value(const optional<int>* opt) {
+  return opt->value();
+}
+
+int reference_value(const raw* opt) {
+  if (!opt->engaged) [[unlikely]] {
+    detail::throw_bad_optional_access();
+  }
+  return opt->value;
+}
+
+void optional_assign_value(optional<int>* opt, int x) {
+  opt->value() = x;
+}
+
+void reference_assign_value(raw* opt, int x) {
+  if (!opt->engaged) [[unlikely]] {
+    detail::throw_bad_optional_access();
+  }
+  opt->value = x;
+}
+
+int optional_value_sum(const optional<int>* values, int count) {
+  int sum = 0;
+  for (int i = 0; i < count; ++i) {
+    sum += values[i].value();
+  }
+  return sum;
+}
+
+int reference_value_sum(const raw* values, int count) {
+  int sum = 0;
+  for (int i = 0; i < count; ++i) {
+    if (!values[i].engaged) [[unlikely]] {
+      detail::throw_bad_optional_access();
+    }
+    sum += values[i].value;
+  }
+  return sum;
+}
+}
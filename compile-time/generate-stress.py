@@ -0,0 +1,141 @@
+#!/usr/bin/env python3
+"""Writes a translation unit that instantiates optional<T_i> for N synthetic types.
+
+The types cycle through every special-member combination of test/traits-test.cpp: a trivial or user-defined
+noexcept destructor, and each of the copy/move constructors and assignments trivial, deleted, user-defined or
+user-defined noexcept. For every type the TU checks the traits that traits_test.all_variants checks for its derived
+type: destructible, copy/move constructible and assignable, each in its plain, nothrow and trivial form. These checks
+keep the compiler from skipping the instantiations.
+
+The types differ from the test's in one respect. The test declares each special member as several overloads
+constrained by `requires`, so triviality depends on which overload the compiler finds eligible. When the move is
+deleted, GCC 12 reports the test's type as trivially movable (through its trivial copy) but optional of it as not, so
+the test expects a trivial move that optional does not have, and fails there. Here each type has a single plain
+declaration of every member, and with those GCC 12 agrees on both sides, so this TU passes. Its checks exercise
+optional and not the compiler's handling of constrained special members.
+"""
+
+import argparse
+import itertools
+
+VARIANTS = ("trivial", "deleted", "user", "user_noexcept")
+DTOR_VARIANTS = ("trivial", "user_noexcept")
+
+SIGNATURES = {
+    "copy_ctor": ("{name}(const {name}&)", None),
+    "move_ctor": ("{name}({name}&&)", None),
+    "copy_assign": ("{name}& operator=(const {name}&)", "return *this;"),
+    "move_assign": ("{name}& operator=({name}&&)", "return *this;"),
+}
+
+PRELUDE = """\
+// Generated by compile-time/generate-stress.py, do not edit.
+
+#include "optional.h"
+
+#include <type_traits>
+
+namespace {
+
+enum class kind { trivial, deleted, user, user_noexcept };
+
+constexpr bool is_noexcept(kind k) {
+  return k == kind::trivial || k == kind::user_noexcept;
+}
+
+// The expectations of traits_test.all_variants, for a type whose members are (Dtor, CopyCtor, MoveCtor, CopyAssign,
+// MoveAssign) and that falls back to copying when its moves are deleted
+template <typename T, kind Dtor, kind CopyCtor, kind MoveCtor, kind CopyAssign, kind MoveAssign>
+constexpr bool check() {
+  using opt = optional<T>;
+  bool ok = std::is_destructible_v<T> == std::is_destructible_v<opt>;
+  ok &= std::is_nothrow_destructible_v<T> == std::is_nothrow_destructible_v<opt>;
+  ok &= std::is_trivially_destructible_v<T> == std::is_trivially_destructible_v<opt>;
+  ok &= std::is_copy_constructible_v<T> == std::is_copy_constructible_v<opt>;
+  ok &= std::is_nothrow_copy_constructible_v<T> == std::is_nothrow_copy_constructible_v<opt>;
+  ok &= std::is_trivially_copy_constructible_v<T> == std::is_trivially_copy_constructible_v<opt>;
+  ok &= std::is_move_constructible_v<T> == std::is_move_constructible_v<opt>;
+  ok &= std::is_nothrow_move_constructible_v<T> == std::is_nothrow_move_constructible_v<opt>;
+  ok &= std::is_trivially_move_constructible_v<T> == std::is_trivially_move_constructible_v<opt>;
+  if constexpr (CopyCtor == kind::deleted) {
+    ok &= !std::is_copy_assignable_v<opt>;
+  } else {
+    ok &= std::is_copy_assignable_v<T> == std::is_copy_assignable_v<opt>;
+  }
+  if constexpr (is_noexcept(CopyCtor)) {
+    ok &= std::is_nothrow_copy_assignable_v<T> == std::is_nothrow_copy_assignable_v<opt>;
+  } else {
+    ok &= !std::is_nothrow_copy_assignable_v<opt>;
+  }
+  if constexpr (CopyCtor == kind::trivial && Dtor == kind::trivial) {
+    ok &= std::is_trivially_copy_assignable_v<T> == std::is_trivially_copy_assignable_v<opt>;
+  } else {
+    ok &= !std::is_trivially_copy_assignable_v<opt>;
+  }
+  if constexpr (MoveCtor == kind::deleted && CopyCtor == kind::deleted) {
+    ok &= !std::is_move_assignable_v<opt>;
+  } else {
+    ok &= std::is_move_assignable_v<T> == std::is_move_assignable_v<opt>;
+  }
+  if constexpr (is_noexcept(MoveCtor) || (MoveCtor == kind::deleted && is_noexcept(CopyCtor))) {
+    ok &= std::is_nothrow_move_assignable_v<T> == std::is_nothrow_move_assignable_v<opt>;
+  } else {
+    ok &= !std::is_nothrow_move_assignable_v<opt>;
+  }
+  if constexpr ((MoveCtor == kind::trivial || (MoveCtor == kind::deleted && CopyCtor == kind::trivial)) &&
+                Dtor == kind::trivial) {
+    ok &= std::is_trivially_move_assignable_v<T> == std::is_trivially_move_assignable_v<opt>;
+  } else {
+    ok &= !std::is_trivially_move_assignable_v<opt>;
+  }
+  return ok;
+}
+
+} // namespace
+"""
+
+
+def member(kind, signature, body):
+    if kind == "trivial":
+        return f"{signature} = default;"
+    if kind == "deleted":
+        return f"{signature} = delete;"
+    noexcept = " noexcept" if kind == "user_noexcept" else ""
+    return f"{signature}{noexcept} {{{' ' + body + ' ' if body else ''}}}"
+
+
+def generate(count):
+    combinations = list(itertools.product(DTOR_VARIANTS, VARIANTS, VARIANTS, VARIANTS, VARIANTS))
+    lines = [PRELUDE]
+    for i in range(count):
+        dtor, *members = combinations[i % len(combinations)]
+        base, name = f"base_{i}", f"type_{i}"
+        lines.append("namespace {\n")
+        lines.append(f"struct {base} {{")
+        lines.append(f"  {base}() = default;")
+        if dtor == "user_noexcept":
+            lines.append(f"  ~{base}() noexcept {{}}")
+        for kind, (signature, body) in zip(members, SIGNATURES.values()):
+            lines.append("  " + member(kind, signature.format(name=base), body))
+        lines.append("};\n")
+        lines.append(
+            "// deleted moves of the base are skipped by overload resolution here, so moving falls back to copying"
+        )
+        lines.append(f"struct {name} : {base} {{}};\n")
+        lines.append("} // namespace\n")
+        arguments = ", ".join(["kind::" + dtor] + ["kind::" + kind for kind in members])
+        lines.append(f"static_assert(check<{name}, {arguments}>());\n")
+    return "\n".join(lines)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument("count", type=int, help="number of distinct optional instantiations")
+    parser.add_argument("output")
+    args = parser.parse_args()
+    with open(args.output, "w") as file:
+        file.write(generate(args.count))
+
+
+if __name__ == "__main__":
+    main()
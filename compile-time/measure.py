@@ -0,0 +1,60 @@
+#!/usr/bin/env python3
+"""Compiles the generated stress TU for several N and prints time and peak memory per N as CSV.
+
+Extra arguments after -- go to the compiler, e.g. `-- -ftime-trace` with Clang or `-- -ftime-report` with GCC.
+"""
+
+import argparse
+import importlib.util
+import os
+import subprocess
+import sys
+import tempfile
+import time
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+
+spec = importlib.util.spec_from_file_location("generate_stress", os.path.join(HERE, "generate-stress.py"))
+generate_stress = importlib.util.module_from_spec(spec)
+spec.loader.exec_module(generate_stress)
+
+
+def compile_once(command):
+    start = time.perf_counter()
+    process = subprocess.Popen(command, stdout=subprocess.DEVNULL, stderr=subprocess.PIPE)
+    _, status, usage = os.wait4(process.pid, 0)
+    elapsed = time.perf_counter() - start
+    stderr = process.stderr.read().decode()
+    process.stderr.close()
+    if os.waitstatus_to_exitcode(status) != 0:
+        sys.exit(f"compilation failed: {' '.join(command)}\n{stderr}")
+    # ru_maxrss is in kilobytes on Linux
+    return elapsed, usage.ru_maxrss
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--compiler", required=True)
+    parser.add_argument("--include", required=True, help="directory containing optional.h")
+    parser.add_argument("--counts", default="0,128,256,512,1024,2048")
+    parser.add_argument("--repeat", type=int, default=3, help="compilations per N; the fastest is reported")
+    parser.add_argument("flags", nargs="*")
+    args = parser.parse_args()
+
+    print("n,seconds,max_rss_kb,ms_per_type")
+    baseline = None
+    with tempfile.TemporaryDirectory() as directory:
+        for count in map(int, args.counts.split(",")):
+            source = os.path.join(directory, f"stress-{count}.cpp")
+            with open(source, "w") as file:
+                file.write(generate_stress.generate(count))
+            command = [args.compiler, "-std=c++20", "-fsyntax-only", "-I", args.include, *args.flags, source]
+            seconds, rss = min(compile_once(command) for _ in range(args.repeat))
+            if baseline is None:
+                baseline = seconds
+            per_type = (seconds - baseline) * 1000 / count if count else 0
+            print(f"{count},{seconds:.3f},{rss},{per_type:.3f}", flush=True)
+
+
+if __name__ == "__main__":
+    main()
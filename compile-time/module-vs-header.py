@@ -0,0 +1,133 @@
+#!/usr/bin/env python3
+"""Builds a synthetic project of many small TUs that use optional, once including optional.h and once importing the
+optional module, and compares the compile cost of the two.
+
+Every TU defines its own payload type and runs a few optional operations on it, so each compilation does a small
+amount of real work on top of making optional available. The module variant also pays for building the module
+interface once; that cost is reported separately.
+
+Supports GCC (-fmodules-ts) and Clang (--precompile).
+
+Experimental, like src/optional.cppm: the module half has never run to completion here. GCC 12 cannot import the
+module's exports, so on that compiler only the header numbers mean anything, and the script is no evidence yet about
+which of the two builds faster.
+"""
+
+import argparse
+import concurrent.futures
+import os
+import subprocess
+import sys
+import tempfile
+import time
+
+TU_BODY = """\
+namespace {{
+
+struct payload {{
+  int id;
+  double weight;
+
+  friend bool operator==(const payload&, const payload&) = default;
+}};
+
+}} // namespace
+
+bool tu_{index}(int x) {{
+  optional<payload> value;
+  if (x != 0) {{
+    value.emplace(payload{{x, {index}.0}});
+  }}
+  optional<payload> copy = value;
+  optional<int> number = x;
+  return copy == value && (number <=> optional<int>({index})) != 0;
+}}
+"""
+
+PROLOGUE = {
+    "header": '#include "optional.h"\n\n',
+    "module": "import optional;\n\n",
+}
+
+
+def is_clang(compiler):
+    output = subprocess.run([compiler, "--version"], capture_output=True, text=True).stdout
+    return "clang" in output.lower()
+
+
+def run(command, cwd):
+    start = time.perf_counter()
+    process = subprocess.Popen(command, cwd=cwd, stdout=subprocess.DEVNULL, stderr=subprocess.PIPE)
+    _, status, usage = os.wait4(process.pid, 0)
+    elapsed = time.perf_counter() - start
+    stderr = process.stderr.read().decode()
+    process.stderr.close()
+    if os.waitstatus_to_exitcode(status) != 0:
+        raise RuntimeError(f"{' '.join(command)}\n{stderr}")
+    return elapsed, usage.ru_utime + usage.ru_stime
+
+
+def module_flags(compiler, directory, include):
+    """Builds the module interface in `directory` and returns the flags that let TUs import it."""
+    source = os.path.join(include, "optional.cppm")
+    if is_clang(compiler):
+        pcm = os.path.join(directory, "optional.pcm")
+        cost = run([compiler, "-std=c++20", "-I", include, "--precompile", source, "-o", pcm], directory)
+        return cost, [f"-fmodule-file=optional={pcm}"]
+    cost = run([compiler, "-std=c++20", "-fmodules-ts", "-I", include, "-x", "c++", "-c", source, "-o", "optional.o"],
+               directory)
+    return cost, ["-fmodules-ts"]
+
+
+def build(compiler, include, variant, count, jobs, flags):
+    with tempfile.TemporaryDirectory() as directory:
+        extra = ["-I", include]
+        interface = (0.0, 0.0)
+        if variant == "module":
+            interface, extra = module_flags(compiler, directory, include)
+
+        sources = []
+        for index in range(count):
+            source = os.path.join(directory, f"tu-{index}.cpp")
+            with open(source, "w") as file:
+                file.write(PROLOGUE[variant] + TU_BODY.format(index=index))
+            sources.append(source)
+
+        def compile_tu(source):
+            command = [compiler, "-std=c++20", "-O1", *extra, *flags, "-c", source, "-o", source + ".o"]
+            return run(command, directory)
+
+        start = time.perf_counter()
+        with concurrent.futures.ThreadPoolExecutor(max_workers=jobs) as pool:
+            results = list(pool.map(compile_tu, sources))
+        wall = time.perf_counter() - start
+        cpu = sum(result[1] for result in results)
+        return interface[1], cpu, wall
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--compiler", required=True)
+    parser.add_argument("--include", required=True, help="directory containing optional.h and optional.cppm")
+    parser.add_argument("--tus", type=int, default=500)
+    parser.add_argument("--jobs", type=int, default=os.cpu_count())
+    parser.add_argument("--variants", default="header,module")
+    parser.add_argument("flags", nargs="*")
+    args = parser.parse_args()
+
+    include = os.path.abspath(args.include)
+    print("variant,interface_cpu_s,tu_cpu_s,tu_wall_s,cpu_ms_per_tu")
+    failed = False
+    for variant in args.variants.split(","):
+        try:
+            interface, cpu, wall = build(args.compiler, include, variant, args.tus, args.jobs, args.flags)
+        except RuntimeError as error:
+            print(f"{variant} variant failed to build:\n{error}", file=sys.stderr)
+            failed = True
+            continue
+        print(f"{variant},{interface:.2f},{cpu:.2f},{wall:.2f},{cpu * 1000 / args.tus:.1f}", flush=True)
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,191 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+
+// Bump-pointer arena: deallocation is a no-op, all memory is returned at once by release() or destruction
+class monotonic_arena {
+public:
+  explicit monotonic_arena(std::size_t initial_chunk_size = 4096) noexcept
+      : next_chunk_size(std::max(initial_chunk_size, sizeof(chunk))) {}
+
+  monotonic_arena(const monotonic_arena&) = delete;
+  monotonic_arena& operator=(const monotonic_arena&) = delete;
+
+  ~monotonic_arena() {
+    release();
+  }
+
+  void* allocate(std::size_t size, std::size_t alignment) {
+    auto aligned = (current + alignment - 1) & ~(alignment - 1);
+    if (current == 0 || aligned + size > end) {
+      grow(size + alignment);
+      aligned = (current + alignment - 1) & ~(alignment - 1);
+    }
+    current = aligned + size;
+    return reinterpret_cast<void*>(aligned);
+  }
+
+  void deallocate(void*, std::size_t, std::size_t) noexcept {}
+
+  void release() noexcept {
+    while (head != nullptr) {
+      chunk* next = head->next;
+      ::operator delete(head, head->size);
+      head = next;
+    }
+    current = 0;
+    end = 0;
+  }
+
+private:
+  struct chunk {
+    chunk* next;
+    std::size_t size;
+  };
+
+  void grow(std::size_t min_size) {
+    std::size_t size = std::max(next_chunk_size, min_size + sizeof(chunk));
+    head = ::new (::operator new(size)) chunk{head, size};
+    current = reinterpret_cast<std::uintptr_t>(head + 1);
+    end = reinterpret_cast<std::uintptr_t>(head) + size;
+    next_chunk_size = size * 2;
+  }
+
+  chunk* head = nullptr;
+  std::uintptr_t current = 0;
+  std::uintptr_t end = 0;
+  std::size_t next_chunk_size;
+};
+
+// Segregated free lists for power-of-two size classes; larger or over-aligned requests go to operator new
+class size_class_pool {
+public:
+  static constexpr std::size_t min_class_size = 16;
+  static constexpr std::size_t max_class_size = 4096;
+
+  explicit size_class_pool(std::size_t block_size = 64 * 1024) noexcept
+      : block_size(std::max(block_size, node_offset + max_class_size)) {}
+
+  size_class_pool(const size_class_pool&) = delete;
+  size_class_pool& operator=(const size_class_pool&) = delete;
+
+  ~size_class_pool() {
+    while (blocks != nullptr) {
+      block* next = blocks->next;
+      ::operator delete(blocks, block_size);
+      blocks = next;
+    }
+  }
+
+  void* allocate(std::size_t size, std::size_t alignment) {
+    if (!is_pooled(size, alignment)) {
+      return ::operator new(size, std::align_val_t(alignment));
+    }
+    std::size_t index = class_index(size);
+    node*& free_list = free_lists[index];
+    if (free_list == nullptr) {
+      refill(index);
+    }
+    node* result = free_list;
+    free_list = result->next;
+    return result;
+  }
+
+  void deallocate(void* p, std::size_t size, std::size_t alignment) noexcept {
+    if (!is_pooled(size, alignment)) {
+      ::operator delete(p, size, std::align_val_t(alignment));
+      return;
+    }
+    node*& free_list = free_lists[class_index(size)];
+    free_list = ::new (p) node{free_list};
+  }
+
+private:
+  struct node {
+    node* next;
+  };
+
+  struct block {
+    block* next;
+  };
+
+  // Nodes start past the block header, at the alignment every pooled request may ask for
+  static constexpr std::size_t node_offset = std::max(sizeof(block), alignof(std::max_align_t));
+
+  static constexpr std::size_t class_count = std::countr_zero(max_class_size / min_class_size) + 1;
+
+  static bool is_pooled(std::size_t size, std::size_t alignment) noexcept {
+    return size <= max_class_size && alignment <= alignof(std::max_align_t);
+  }
+
+  static std::size_t class_index(std::size_t size) noexcept {
+    return std::countr_zero(std::bit_ceil(std::max(size, min_class_size)) / min_class_size);
+  }
+
+  void refill(std::size_t index) {
+    std::size_t class_size = min_class_size << index;
+    blocks = ::new (::operator new(block_size)) block{blocks};
+
+    auto* first = reinterpret_cast<std::byte*>(blocks) + node_offset;
+    auto* last = reinterpret_cast<std::byte*>(blocks) + block_size;
+    node* free_list = nullptr;
+    for (std::byte* p = first; p + class_size <= last; p += class_size) {
+      free_list = ::new (p) node{free_list};
+    }
+    // The constructor sizes blocks to hold at least one node of the largest class
+    if (free_list == nullptr) {
+      throw std::bad_alloc();
+    }
+    free_lists[index] = free_list;
+  }
+
+  std::array<node*, class_count> free_lists{};
+  block* blocks = nullptr;
+  std::size_t block_size;
+};
+
+// Stateful allocator that forwards to a memory resource with allocate(size, alignment)/deallocate(p, size, alignment)
+template <typename T, typename Resource>
+class resource_allocator {
+public:
+  using value_type = T;
+
+  explicit resource_allocator(Resource& memory) noexcept
+      : resource(std::addressof(memory)) {}
+
+  template <typename U>
+  resource_allocator(const resource_allocator<U, Resource>& other) noexcept
+      : resource(std::addressof(other.get_resource())) {}
+
+  T* allocate(std::size_t n) {
+    return static_cast<T*>(resource->allocate(n * sizeof(T), alignof(T)));
+  }
+
+  void deallocate(T* p, std::size_t n) noexcept {
+    resource->deallocate(p, n * sizeof(T), alignof(T));
+  }
+
+  Resource& get_resource() const noexcept {
+    return *resource;
+  }
+
+  template <typename U>
+  friend bool operator==(const resource_allocator& lhs, const resource_allocator<U, Resource>& rhs) noexcept {
+    return lhs.resource == std::addressof(rhs.get_resource());
+  }
+
+private:
+  Resource* resource;
+};
+
+template <typename T>
+using arena_allocator = resource_allocator<T, monotonic_arena>;
+
+template <typename T>
+using pool_allocator = resource_allocator<T, size_class_pool>;
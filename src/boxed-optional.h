@@ -0,0 +1,284 @@
+#pragma once
+
+#include "optional.h"
+
+#include <compare>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+// optional that keeps its value out of line, in memory obtained from Allocator.
+// Moves transfer ownership of the box and leave the source disengaged when the allocators allow it.
+template <typename T, typename Allocator = std::allocator<T>>
+class boxed_optional {
+  using alloc_traits = std::allocator_traits<Allocator>;
+  using pointer = typename alloc_traits::pointer;
+
+  static_assert(std::is_same_v<typename alloc_traits::value_type, T>, "Allocator::value_type must be T");
+
+public:
+  using value_type = T;
+  using allocator_type = Allocator;
+
+  boxed_optional() noexcept(std::is_nothrow_default_constructible_v<Allocator>) = default;
+
+  boxed_optional(nullopt_t) noexcept(std::is_nothrow_default_constructible_v<Allocator>) {}
+
+  explicit boxed_optional(const Allocator& allocator) noexcept
+      : alloc(allocator) {}
+
+  boxed_optional(const boxed_optional& other)
+      : alloc(alloc_traits::select_on_container_copy_construction(other.alloc)) {
+    if (other.ptr) {
+      ptr = create(*other);
+    }
+  }
+
+  boxed_optional(boxed_optional&& other) noexcept
+      : alloc(std::move(other.alloc))
+      , ptr(std::exchange(other.ptr, nullptr)) {}
+
+  template <
+      typename U = T,
+      std::enable_if_t<
+          std::is_constructible_v<T, U&&> && !std::is_same_v<std::remove_cvref_t<U>, in_place_t> &&
+              !std::is_same_v<std::remove_cvref_t<U>, boxed_optional>,
+          int> = 0>
+  explicit(!std::is_convertible_v<U&&, T>) boxed_optional(U&& value)
+      : ptr(create(std::forward<U>(value))) {}
+
+  template <typename... Args, std::enable_if_t<std::is_constructible_v<T, Args&&...>, int> = 0>
+  explicit boxed_optional(in_place_t, Args&&... args)
+      : ptr(create(std::forward<Args>(args)...)) {}
+
+  template <typename... Args, std::enable_if_t<std::is_constructible_v<T, Args&&...>, int> = 0>
+  boxed_optional(std::allocator_arg_t, const Allocator& allocator, in_place_t, Args&&... args)
+      : alloc(allocator)
+      , ptr(create(std::forward<Args>(args)...)) {}
+
+  ~boxed_optional() {
+    reset();
+  }
+
+  boxed_optional& operator=(const boxed_optional& other) {
+    if (this == &other) {
+      return *this;
+    }
+    if constexpr (alloc_traits::propagate_on_container_copy_assignment::value) {
+      if (alloc != other.alloc) {
+        reset();
+      }
+      alloc = other.alloc;
+    }
+    assign_from(other);
+    return *this;
+  }
+
+  boxed_optional& operator=(boxed_optional&& other) noexcept(
+      alloc_traits::propagate_on_container_move_assignment::value || alloc_traits::is_always_equal::value
+  ) {
+    if (this == &other) {
+      return *this;
+    }
+    if constexpr (alloc_traits::propagate_on_container_move_assignment::value) {
+      reset();
+      alloc = std::move(other.alloc);
+      ptr = std::exchange(other.ptr, nullptr);
+    } else if (alloc_traits::is_always_equal::value || alloc == other.alloc) {
+      reset();
+      ptr = std::exchange(other.ptr, nullptr);
+    } else {
+      assign_from(std::move(other));
+    }
+    return *this;
+  }
+
+  boxed_optional& operator=(nullopt_t) noexcept {
+    reset();
+    return *this;
+  }
+
+  template <
+      typename U = T,
+      std::enable_if_t<
+          detail::is_optional_value_assignable_v<T, U> && !std::is_same_v<std::remove_cvref_t<U>, boxed_optional>,
+          int> = 0>
+  boxed_optional& operator=(U&& value) {
+    if (ptr) {
+      *ptr = std::forward<U>(value);
+    } else {
+      ptr = create(std::forward<U>(value));
+    }
+    return *this;
+  }
+
+  // Boxes change hands only when each one stays with an allocator that can free it; between unequal allocators that
+  // do not propagate, the values are swapped or moved instead, which may allocate
+  void swap(boxed_optional& other) noexcept(
+      alloc_traits::propagate_on_container_swap::value || alloc_traits::is_always_equal::value
+  ) {
+    using std::swap;
+    if constexpr (alloc_traits::propagate_on_container_swap::value) {
+      swap(alloc, other.alloc);
+      swap(ptr, other.ptr);
+    } else if (alloc_traits::is_always_equal::value || alloc == other.alloc) {
+      swap(ptr, other.ptr);
+    } else if (ptr && other.ptr) {
+      swap(*ptr, *other.ptr);
+    } else if (ptr) {
+      other.ptr = other.create(std::move(*ptr));
+      reset();
+    } else if (other.ptr) {
+      ptr = create(std::move(*other.ptr));
+      other.reset();
+    }
+  }
+
+  bool has_value() const noexcept {
+    return ptr != nullptr;
+  }
+
+  explicit operator bool() const noexcept {
+    return ptr != nullptr;
+  }
+
+  T& operator*() & noexcept {
+    return *ptr;
+  }
+
+  const T& operator*() const& noexcept {
+    return *ptr;
+  }
+
+  T&& operator*() && noexcept {
+    return std::move(*ptr);
+  }
+
+  const T&& operator*() const&& noexcept {
+    return std::move(*ptr);
+  }
+
+  T* operator->() noexcept {
+    return std::to_address(ptr);
+  }
+
+  const T* operator->() const noexcept {
+    return std::to_address(ptr);
+  }
+
+  template <typename... Args>
+  T& emplace(Args&&... args) {
+    if (!ptr) {
+      ptr = create(std::forward<Args>(args)...);
+      return *ptr;
+    }
+    // reuse the box instead of going back to the allocator
+    alloc_traits::destroy(alloc, std::to_address(ptr));
+    try {
+      alloc_traits::construct(alloc, std::to_address(ptr), std::forward<Args>(args)...);
+    } catch (...) {
+      alloc_traits::deallocate(alloc, std::exchange(ptr, nullptr), 1);
+      throw;
+    }
+    return *ptr;
+  }
+
+  void reset() noexcept {
+    if (ptr) {
+      alloc_traits::destroy(alloc, std::to_address(ptr));
+      alloc_traits::deallocate(alloc, std::exchange(ptr, nullptr), 1);
+    }
+  }
+
+  allocator_type get_allocator() const noexcept {
+    return alloc;
+  }
+
+private:
+  template <typename... Args>
+  pointer create(Args&&... args) {
+    pointer p = alloc_traits::allocate(alloc, 1);
+    try {
+      alloc_traits::construct(alloc, std::to_address(p), std::forward<Args>(args)...);
+    } catch (...) {
+      alloc_traits::deallocate(alloc, p, 1);
+      throw;
+    }
+    return p;
+  }
+
+  template <typename Other>
+  void assign_from(Other&& other) {
+    if (!other.ptr) {
+      reset();
+    } else if (ptr) {
+      *ptr = std::forward<Other>(other).operator*();
+    } else {
+      ptr = create(std::forward<Other>(other).operator*());
+    }
+  }
+
+  [[no_unique_address]] Allocator alloc;
+  pointer ptr = nullptr;
+};
+
+template <typename T, typename Allocator>
+void swap(boxed_optional<T, Allocator>& lhs, boxed_optional<T, Allocator>& rhs) noexcept(noexcept(lhs.swap(rhs))) {
+  lhs.swap(rhs);
+}
+
+template <typename T, typename A>
+bool operator==(const boxed_optional<T, A>& lhs, const boxed_optional<T, A>& rhs) {
+  if (lhs.has_value() != rhs.has_value()) {
+    return false;
+  }
+  return !lhs.has_value() || *lhs == *rhs;
+}
+
+template <typename T, typename A>
+bool operator!=(const boxed_optional<T, A>& lhs, const boxed_optional<T, A>& rhs) {
+  if (lhs.has_value() != rhs.has_value()) {
+    return true;
+  }
+  return lhs.has_value() && *lhs != *rhs;
+}
+
+template <typename T, typename A>
+bool operator<(const boxed_optional<T, A>& lhs, const boxed_optional<T, A>& rhs) {
+  if (!rhs.has_value()) {
+    return false;
+  }
+  return !lhs.has_value() || *lhs < *rhs;
+}
+
+template <typename T, typename A>
+bool operator<=(const boxed_optional<T, A>& lhs, const boxed_optional<T, A>& rhs) {
+  if (!lhs.has_value()) {
+    return true;
+  }
+  return rhs.has_value() && *lhs <= *rhs;
+}
+
+template <typename T, typename A>
+bool operator>(const boxed_optional<T, A>& lhs, const boxed_optional<T, A>& rhs) {
+  if (!lhs.has_value()) {
+    return false;
+  }
+  return !rhs.has_value() || *lhs > *rhs;
+}
+
+template <typename T, typename A>
+bool operator>=(const boxed_optional<T, A>& lhs, const boxed_optional<T, A>& rhs) {
+  if (!rhs.has_value()) {
+    return true;
+  }
+  return lhs.has_value() && *lhs >= *rhs;
+}
+
+template <typename T, typename A>
+std::compare_three_way_result_t<T> operator<=>(const boxed_optional<T, A>& lhs, const boxed_optional<T, A>& rhs) {
+  if (lhs.has_value() && rhs.has_value()) {
+    return *lhs <=> *rhs;
+  }
+  return lhs.has_value() <=> rhs.has_value();
+}
@@ -0,0 +1,447 @@
+#pragma once
+
+#include "optional.h"
+
+#include <atomic>
+#include <compare>
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+// optional whose value lives in a reference-counted block shared by its copies: copying is a counter increment,
+// however large T is. Non-const access to the value first gives *this a block of its own, cloning the value if the
+// block is shared, so no copy ever sees another one change. Const access never clones.
+//
+// The counter is atomic, so copies of one cow_optional can be made, read and destroyed on different threads. As with
+// copy-on-write strings, a reference obtained through non-const access must not be kept across a copy of *this: the
+// copy would share the value that the reference still modifies.
+template <typename T>
+class cow_optional;
+
+namespace detail {
+
+template <typename T>
+inline constexpr bool is_cow_optional_v = false;
+
+template <typename T>
+inline constexpr bool is_cow_optional_v<cow_optional<T>> = true;
+
+} // namespace detail
+
+template <typename T>
+class cow_optional {
+  template <typename>
+  friend class cow_optional;
+
+  struct factory_tag {};
+
+  struct block {
+    template <typename... Args>
+    explicit block(in_place_t, Args&&... args)
+        : value(std::forward<Args>(args)...) {}
+
+    template <typename F>
+    block(factory_tag, F&& f)
+        : value(std::forward<F>(f)()) {}
+
+    std::atomic<std::size_t> owners{1};
+    T value;
+  };
+
+public:
+  using value_type = T;
+
+  cow_optional() noexcept = default;
+
+  cow_optional(nullopt_t) noexcept {}
+
+  cow_optional(const cow_optional& other) noexcept
+      : shared(other.shared) {
+    if (shared) {
+      shared->owners.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+
+  cow_optional(cow_optional&& other) noexcept
+      : shared(std::exchange(other.shared, nullptr)) {}
+
+  template <
+      typename U = T,
+      std::enable_if_t<
+          std::is_constructible_v<T, U&&> && !std::is_same_v<std::remove_cvref_t<U>, in_place_t> &&
+              !detail::is_cow_optional_v<std::remove_cvref_t<U>> && !detail::is_optional_v<std::remove_cvref_t<U>>,
+          int> = 0>
+  explicit(!std::is_convertible_v<U&&, T>) cow_optional(U&& value)
+      : shared(new block(in_place, std::forward<U>(value))) {}
+
+  // Converting copies always make a block of their own, since the value changes type
+  template <typename U, std::enable_if_t<detail::is_optional_converting_constructible_v<T, U, const U&>, int> = 0>
+  explicit(!std::is_convertible_v<const U&, T>) cow_optional(const cow_optional<U>& other)
+      : shared(other.shared ? new block(in_place, std::as_const(other.shared->value)) : nullptr) {}
+
+  // Moves the value out of other if no other copy shares it, and copies it otherwise, so T must be constructible from
+  // both
+  template <
+      typename U,
+      std::enable_if_t<
+          detail::is_optional_converting_constructible_v<T, U, U&&> && std::is_constructible_v<T, const U&>,
+          int> = 0>
+  explicit(!std::is_convertible_v<U&&, T>) cow_optional(cow_optional<U>&& other) {
+    if (other.unique()) {
+      shared = new block(in_place, std::move(other.shared->value));
+    } else if (other.shared) {
+      shared = new block(in_place, std::as_const(other.shared->value));
+    }
+  }
+
+  template <typename... Args, std::enable_if_t<std::is_constructible_v<T, Args&&...>, int> = 0>
+  explicit cow_optional(in_place_t, Args&&... args)
+      : shared(new block(in_place, std::forward<Args>(args)...)) {}
+
+  explicit cow_optional(const optional<T>& other)
+      : shared(other.has_value() ? new block(in_place, *other) : nullptr) {}
+
+  explicit cow_optional(optional<T>&& other)
+      : shared(other.has_value() ? new block(in_place, *std::move(other)) : nullptr) {}
+
+  ~cow_optional() {
+    release(shared);
+  }
+
+  cow_optional& operator=(const cow_optional& other) noexcept {
+    cow_optional(other).swap(*this);
+    return *this;
+  }
+
+  cow_optional& operator=(cow_optional&& other) noexcept {
+    cow_optional(std::move(other)).swap(*this);
+    return *this;
+  }
+
+  cow_optional& operator=(nullopt_t) noexcept {
+    reset();
+    return *this;
+  }
+
+  // Assigns to the value when no other copy shares it; otherwise stores the value in a new block
+  template <
+      typename U = T,
+      std::enable_if_t<
+          detail::is_optional_value_assignable_v<T, U> && !detail::is_cow_optional_v<std::remove_cvref_t<U>> &&
+              !detail::is_optional_v<std::remove_cvref_t<U>>,
+          int> = 0>
+  cow_optional& operator=(U&& value) {
+    if (unique()) {
+      shared->value = std::forward<U>(value);
+    } else {
+      emplace(std::forward<U>(value));
+    }
+    return *this;
+  }
+
+  template <typename U, std::enable_if_t<detail::is_optional_converting_assignable_v<T, U, const U&>, int> = 0>
+  cow_optional& operator=(const cow_optional<U>& other) {
+    if (other.has_value()) {
+      *this = std::as_const(other.shared->value);
+    } else {
+      reset();
+    }
+    return *this;
+  }
+
+  template <
+      typename U,
+      std::enable_if_t<
+          detail::is_optional_converting_assignable_v<T, U, U&&> &&
+              detail::is_optional_converting_assignable_v<T, U, const U&>,
+          int> = 0>
+  cow_optional& operator=(cow_optional<U>&& other) {
+    if (other.unique()) {
+      *this = std::move(other.shared->value);
+    } else if (other.has_value()) {
+      *this = std::as_const(other.shared->value);
+    } else {
+      reset();
+    }
+    return *this;
+  }
+
+  void swap(cow_optional& other) noexcept {
+    std::swap(shared, other.shared);
+  }
+
+  bool has_value() const noexcept {
+    return shared != nullptr;
+  }
+
+  explicit operator bool() const noexcept {
+    return shared != nullptr;
+  }
+
+  // The number of cow_optionals sharing the value, or 0 if there is none
+  std::size_t use_count() const noexcept {
+    return shared ? shared->owners.load(std::memory_order_relaxed) : 0;
+  }
+
+  // Whether *this is engaged and the only owner of its value, so that non-const access does not clone it
+  bool unique() const noexcept {
+    return shared && shared->owners.load(std::memory_order_acquire) == 1;
+  }
+
+  T& operator*() & {
+    return detach();
+  }
+
+  const T& operator*() const& noexcept {
+    return shared->value;
+  }
+
+  T&& operator*() && {
+    return std::move(detach());
+  }
+
+  const T&& operator*() const&& noexcept {
+    return std::move(shared->value);
+  }
+
+  T* operator->() {
+    return std::addressof(detach());
+  }
+
+  const T* operator->() const noexcept {
+    return std::addressof(shared->value);
+  }
+
+  // Always constructs the value in a new block, so *this is unchanged if the constructor throws
+  template <typename... Args>
+  T& emplace(Args&&... args) {
+    block* created = new block(in_place, std::forward<Args>(args)...);
+    release(std::exchange(shared, created));
+    return created->value;
+  }
+
+  // Assigns to the value when no other copy shares it and T is assignable from the single argument; otherwise behaves
+  // like emplace
+  template <typename... Args, std::enable_if_t<std::is_constructible_v<T, Args&&...>, int> = 0>
+  T& assign_or_emplace(Args&&... args) {
+    if constexpr (detail::is_optional_assign_v<T, Args&&...>) {
+      if (unique()) {
+        shared->value = (std::forward<Args>(args), ...);
+        return shared->value;
+      }
+    }
+    return emplace(std::forward<Args>(args)...);
+  }
+
+  template <typename F, std::enable_if_t<detail::is_optional_factory_v<T, F>, int> = 0>
+  T& emplace_with(F&& f) {
+    block* created = new block(factory_tag{}, std::forward<F>(f));
+    release(std::exchange(shared, created));
+    return created->value;
+  }
+
+  void reset() noexcept {
+    release(std::exchange(shared, nullptr));
+  }
+
+  // Moves the value out and leaves *this empty; the value itself is not touched
+  cow_optional take() noexcept {
+    return cow_optional(std::move(*this));
+  }
+
+  // Stores value and returns what was stored before
+  template <typename U = T, std::enable_if_t<std::is_constructible_v<T, U&&>, int> = 0>
+  cow_optional replace(U&& value) {
+    cow_optional old;
+    old.shared = new block(in_place, std::forward<U>(value));
+    old.swap(*this);
+    return old;
+  }
+
+  // A plain optional with a copy of the value
+  optional<T> to_optional() const {
+    return shared ? optional<T>(shared->value) : optional<T>();
+  }
+
+private:
+  static void release(block* released) noexcept {
+    if (released && released->owners.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      delete released;
+    }
+  }
+
+  // Called only on an engaged *this
+  T& detach() {
+    if (!unique()) {
+      block* clone = new block(in_place, std::as_const(shared->value));
+      release(std::exchange(shared, clone));
+    }
+    return shared->value;
+  }
+
+  block* shared = nullptr;
+};
+
+template <typename T>
+void swap(cow_optional<T>& lhs, cow_optional<T>& rhs) noexcept {
+  lhs.swap(rhs);
+}
+
+template <typename T>
+bool operator==(const cow_optional<T>& lhs, const cow_optional<T>& rhs) {
+  if (lhs.has_value() != rhs.has_value()) {
+    return false;
+  }
+  return !lhs.has_value() || *lhs == *rhs;
+}
+
+template <typename T>
+bool operator!=(const cow_optional<T>& lhs, const cow_optional<T>& rhs) {
+  if (lhs.has_value() != rhs.has_value()) {
+    return true;
+  }
+  return lhs.has_value() && *lhs != *rhs;
+}
+
+template <typename T>
+bool operator<(const cow_optional<T>& lhs, const cow_optional<T>& rhs) {
+  if (!rhs.has_value()) {
+    return false;
+  }
+  return !lhs.has_value() || *lhs < *rhs;
+}
+
+template <typename T>
+bool operator<=(const cow_optional<T>& lhs, const cow_optional<T>& rhs) {
+  if (!lhs.has_value()) {
+    return true;
+  }
+  return rhs.has_value() && *lhs <= *rhs;
+}
+
+template <typename T>
+bool operator>(const cow_optional<T>& lhs, const cow_optional<T>& rhs) {
+  if (!lhs.has_value()) {
+    return false;
+  }
+  return !rhs.has_value() || *lhs > *rhs;
+}
+
+template <typename T>
+bool operator>=(const cow_optional<T>& lhs, const cow_optional<T>& rhs) {
+  if (!rhs.has_value()) {
+    return true;
+  }
+  return lhs.has_value() && *lhs >= *rhs;
+}
+
+template <typename T>
+std::compare_three_way_result_t<T> operator<=>(const cow_optional<T>& lhs, const cow_optional<T>& rhs) {
+  if (lhs.has_value() && rhs.has_value()) {
+    return *lhs <=> *rhs;
+  }
+  return lhs.has_value() <=> rhs.has_value();
+}
+
+// Comparisons with nullopt; the reversed and != / < / ... forms are rewritten from these two
+
+template <typename T>
+bool operator==(const cow_optional<T>& lhs, nullopt_t) noexcept {
+  return !lhs.has_value();
+}
+
+template <typename T>
+std::strong_ordering operator<=>(const cow_optional<T>& lhs, nullopt_t) noexcept {
+  return lhs.has_value() <=> false;
+}
+
+// Comparisons with a value of any other type, as for optional: an empty cow_optional is less than every value
+
+namespace detail {
+
+template <typename U>
+inline constexpr bool is_cow_comparable_value_v = !is_optional_v<U> && !is_cow_optional_v<U>;
+
+} // namespace detail
+
+template <typename T, typename U, std::enable_if_t<detail::is_cow_comparable_value_v<U>, int> = 0>
+auto operator==(const cow_optional<T>& lhs, const U& rhs)
+    -> detail::optional_comparison_result_t<decltype(*lhs == rhs)> {
+  return lhs.has_value() && *lhs == rhs;
+}
+
+template <typename T, typename U, std::enable_if_t<detail::is_cow_comparable_value_v<U>, int> = 0>
+auto operator==(const U& lhs, const cow_optional<T>& rhs)
+    -> detail::optional_comparison_result_t<decltype(lhs == *rhs)> {
+  return rhs.has_value() && lhs == *rhs;
+}
+
+template <typename T, typename U, std::enable_if_t<detail::is_cow_comparable_value_v<U>, int> = 0>
+auto operator!=(const cow_optional<T>& lhs, const U& rhs)
+    -> detail::optional_comparison_result_t<decltype(*lhs != rhs)> {
+  return !lhs.has_value() || *lhs != rhs;
+}
+
+template <typename T, typename U, std::enable_if_t<detail::is_cow_comparable_value_v<U>, int> = 0>
+auto operator!=(const U& lhs, const cow_optional<T>& rhs)
+    -> detail::optional_comparison_result_t<decltype(lhs != *rhs)> {
+  return !rhs.has_value() || lhs != *rhs;
+}
+
+template <typename T, typename U, std::enable_if_t<detail::is_cow_comparable_value_v<U>, int> = 0>
+auto operator<(const cow_optional<T>& lhs, const U& rhs)
+    -> detail::optional_comparison_result_t<decltype(*lhs < rhs)> {
+  return !lhs.has_value() || *lhs < rhs;
+}
+
+template <typename T, typename U, std::enable_if_t<detail::is_cow_comparable_value_v<U>, int> = 0>
+auto operator<(const U& lhs, const cow_optional<T>& rhs)
+    -> detail::optional_comparison_result_t<decltype(lhs < *rhs)> {
+  return rhs.has_value() && lhs < *rhs;
+}
+
+template <typename T, typename U, std::enable_if_t<detail::is_cow_comparable_value_v<U>, int> = 0>
+auto operator<=(const cow_optional<T>& lhs, const U& rhs)
+    -> detail::optional_comparison_result_t<decltype(*lhs <= rhs)> {
+  return !lhs.has_value() || *lhs <= rhs;
+}
+
+template <typename T, typename U, std::enable_if_t<detail::is_cow_comparable_value_v<U>, int> = 0>
+auto operator<=(const U& lhs, const cow_optional<T>& rhs)
+    -> detail::optional_comparison_result_t<decltype(lhs <= *rhs)> {
+  return rhs.has_value() && lhs <= *rhs;
+}
+
+template <typename T, typename U, std::enable_if_t<detail::is_cow_comparable_value_v<U>, int> = 0>
+auto operator>(const cow_optional<T>& lhs, const U& rhs)
+    -> detail::optional_comparison_result_t<decltype(*lhs > rhs)> {
+  return lhs.has_value() && *lhs > rhs;
+}
+
+template <typename T, typename U, std::enable_if_t<detail::is_cow_comparable_value_v<U>, int> = 0>
+auto operator>(const U& lhs, const cow_optional<T>& rhs)
+    -> detail::optional_comparison_result_t<decltype(lhs > *rhs)> {
+  return !rhs.has_value() || lhs > *rhs;
+}
+
+template <typename T, typename U, std::enable_if_t<detail::is_cow_comparable_value_v<U>, int> = 0>
+auto operator>=(const cow_optional<T>& lhs, const U& rhs)
+    -> detail::optional_comparison_result_t<decltype(*lhs >= rhs)> {
+  return lhs.has_value() && *lhs >= rhs;
+}
+
+template <typename T, typename U, std::enable_if_t<detail::is_cow_comparable_value_v<U>, int> = 0>
+auto operator>=(const U& lhs, const cow_optional<T>& rhs)
+    -> detail::optional_comparison_result_t<decltype(lhs >= *rhs)> {
+  return !rhs.has_value() || lhs >= *rhs;
+}
+
+// U <=> cow_optional<T> is rewritten from this one
+template <typename T, typename U, std::enable_if_t<detail::is_cow_comparable_value_v<U>, int> = 0>
+std::compare_three_way_result_t<T, U> operator<=>(const cow_optional<T>& lhs, const U& rhs) {
+  if (lhs.has_value()) {
+    return *lhs <=> rhs;
+  }
+  return std::strong_ordering::less;
+}
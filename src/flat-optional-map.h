@@ -0,0 +1,556 @@
+#pragma once
+
+#include "optional.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Specialize with `static constexpr bool has_niche = true` and `static constexpr K empty() noexcept`
+// to let containers mark vacant key slots with a sentinel value instead of a presence flag
+template <typename K, typename = void>
+struct niche_traits {
+  static constexpr bool has_niche = false;
+};
+
+namespace detail {
+
+template <typename K, typename V>
+class optional_pair_buckets {
+public:
+  explicit optional_pair_buckets(std::size_t count = 0)
+      : buckets(count == 0 ? nullptr : std::make_unique<optional<std::pair<K, V>>[]>(count))
+      , count(count) {}
+
+  optional_pair_buckets(optional_pair_buckets&& other) noexcept
+      : buckets(std::move(other.buckets))
+      , count(std::exchange(other.count, 0)) {}
+
+  optional_pair_buckets& operator=(optional_pair_buckets&& other) noexcept {
+    buckets = std::move(other.buckets);
+    count = std::exchange(other.count, 0);
+    return *this;
+  }
+
+  std::size_t size() const noexcept {
+    return count;
+  }
+
+  bool occupied(std::size_t i) const noexcept {
+    return buckets[i].has_value();
+  }
+
+  const K& key(std::size_t i) const noexcept {
+    return buckets[i]->first;
+  }
+
+  V& value(std::size_t i) const noexcept {
+    return buckets[i]->second;
+  }
+
+  template <typename Key, typename... Args>
+  void emplace(std::size_t i, Key&& key, Args&&... args) {
+    buckets[i].emplace(
+        std::piecewise_construct,
+        std::forward_as_tuple(std::forward<Key>(key)),
+        std::forward_as_tuple(std::forward<Args>(args)...)
+    );
+  }
+
+  void destroy(std::size_t i) noexcept {
+    buckets[i].reset();
+  }
+
+  void relocate(std::size_t from, optional_pair_buckets& to_buckets, std::size_t to) {
+    to_buckets.buckets[to].emplace(std::move(*buckets[from]));
+    buckets[from].reset();
+  }
+
+  // Copies the element into to_buckets, leaving it in place; it is moved instead only if it cannot be copied
+  void copy_to(std::size_t from, optional_pair_buckets& to_buckets, std::size_t to) {
+    to_buckets.buckets[to].emplace(std::move_if_noexcept(*buckets[from]));
+  }
+
+  std::size_t vacant(std::size_t pos) const noexcept {
+    const std::size_t mask = count - 1;
+    while (buckets[pos].has_value()) {
+      pos = (pos + 1) & mask;
+    }
+    return pos;
+  }
+
+  template <typename KeyEqual>
+  std::pair<std::size_t, bool> probe(const K& key, std::size_t pos, const KeyEqual& eq) const {
+    const std::size_t mask = count - 1;
+    for (;; pos = (pos + 1) & mask) {
+      if (!buckets[pos].has_value()) {
+        return {pos, false};
+      }
+      if (eq(buckets[pos]->first, key)) {
+        return {pos, true};
+      }
+    }
+  }
+
+private:
+  std::unique_ptr<optional<std::pair<K, V>>[]> buckets;
+  std::size_t count;
+};
+
+// Keys live in their own contiguous array, vacant ones hold the niche sentinel
+template <typename K, typename V>
+class niche_key_buckets {
+  using traits = niche_traits<K>;
+
+  union value_slot {
+    value_slot() noexcept {}
+
+    ~value_slot() {}
+
+    V value;
+  };
+
+public:
+  explicit niche_key_buckets(std::size_t count = 0)
+      : keys(count == 0 ? nullptr : std::make_unique<K[]>(count))
+      , values(count == 0 ? nullptr : std::make_unique<value_slot[]>(count))
+      , count(count) {
+    for (std::size_t i = 0; i < count; ++i) {
+      keys[i] = traits::empty();
+    }
+  }
+
+  niche_key_buckets(niche_key_buckets&& other) noexcept
+      : keys(std::move(other.keys))
+      , values(std::move(other.values))
+      , count(std::exchange(other.count, 0)) {}
+
+  niche_key_buckets& operator=(niche_key_buckets&& other) noexcept {
+    clear();
+    keys = std::move(other.keys);
+    values = std::move(other.values);
+    count = std::exchange(other.count, 0);
+    return *this;
+  }
+
+  ~niche_key_buckets() {
+    clear();
+  }
+
+  std::size_t size() const noexcept {
+    return count;
+  }
+
+  bool occupied(std::size_t i) const noexcept {
+    return keys[i] != traits::empty();
+  }
+
+  const K& key(std::size_t i) const noexcept {
+    return keys[i];
+  }
+
+  V& value(std::size_t i) const noexcept {
+    return values[i].value;
+  }
+
+  template <typename Key, typename... Args>
+  void emplace(std::size_t i, Key&& key, Args&&... args) {
+    std::construct_at(std::addressof(values[i].value), std::forward<Args>(args)...);
+    keys[i] = std::forward<Key>(key);
+  }
+
+  void destroy(std::size_t i) noexcept {
+    std::destroy_at(std::addressof(values[i].value));
+    keys[i] = traits::empty();
+  }
+
+  void relocate(std::size_t from, niche_key_buckets& to_buckets, std::size_t to) {
+    to_buckets.emplace(to, std::move(keys[from]), std::move(values[from].value));
+    destroy(from);
+  }
+
+  void copy_to(std::size_t from, niche_key_buckets& to_buckets, std::size_t to) {
+    to_buckets.emplace(to, keys[from], std::move_if_noexcept(values[from].value));
+  }
+
+  std::size_t vacant(std::size_t pos) const noexcept {
+    const std::size_t mask = count - 1;
+    while (occupied(pos)) {
+      pos = (pos + 1) & mask;
+    }
+    return pos;
+  }
+
+  template <typename KeyEqual>
+  std::pair<std::size_t, bool> probe(const K& key, std::size_t pos, const KeyEqual& eq) const {
+    const std::size_t mask = count - 1;
+#if defined(__SSE2__)
+    if constexpr (simd_probe_v<KeyEqual>) {
+      while (pos + group_width <= count) {
+        auto match = group_match(pos, key);
+        if (match != 0) {
+          // The first matching lane holds either the key or the sentinel, and a lookup of the sentinel itself must not
+          // find a vacant slot
+          std::size_t offset = std::countr_zero(match) / sizeof(K);
+          return {pos + offset, occupied(pos + offset)};
+        }
+        pos = (pos + group_width) & mask;
+      }
+    }
+#endif
+    for (;; pos = (pos + 1) & mask) {
+      if (!occupied(pos)) {
+        return {pos, false};
+      }
+      if (eq(keys[pos], key)) {
+        return {pos, true};
+      }
+    }
+  }
+
+private:
+  void clear() noexcept {
+    if constexpr (!std::is_trivially_destructible_v<V>) {
+      for (std::size_t i = 0; i < count; ++i) {
+        if (occupied(i)) {
+          destroy(i);
+        }
+      }
+    }
+  }
+
+#if defined(__SSE2__)
+  static constexpr std::size_t group_width = 16 / sizeof(K);
+
+  template <typename KeyEqual>
+  static constexpr bool simd_probe_v =
+      (std::is_integral_v<K> || std::is_enum_v<K>) && (sizeof(K) == 4 || sizeof(K) == 8) &&
+      (std::is_same_v<KeyEqual, std::equal_to<K>> || std::is_same_v<KeyEqual, std::equal_to<>>);
+
+  // Byte mask of the group lanes that hold either the key or the empty sentinel
+  unsigned group_match(std::size_t pos, K key) const noexcept {
+    __m128i group = _mm_loadu_si128(reinterpret_cast<const __m128i*>(keys.get() + pos));
+    __m128i eq_key;
+    __m128i eq_empty;
+    if constexpr (sizeof(K) == 4) {
+      eq_key = _mm_cmpeq_epi32(group, _mm_set1_epi32(static_cast<int>(key)));
+      eq_empty = _mm_cmpeq_epi32(group, _mm_set1_epi32(static_cast<int>(traits::empty())));
+    } else {
+      auto cmpeq_epi64 = [](__m128i a, __m128i b) {
+        __m128i eq32 = _mm_cmpeq_epi32(a, b);
+        return _mm_and_si128(eq32, _mm_shuffle_epi32(eq32, _MM_SHUFFLE(2, 3, 0, 1)));
+      };
+      eq_key = cmpeq_epi64(group, _mm_set1_epi64x(static_cast<long long>(key)));
+      eq_empty = cmpeq_epi64(group, _mm_set1_epi64x(static_cast<long long>(traits::empty())));
+    }
+    return static_cast<unsigned>(_mm_movemask_epi8(_mm_or_si128(eq_key, eq_empty)));
+  }
+#endif
+
+  std::unique_ptr<K[]> keys;
+  std::unique_ptr<value_slot[]> values;
+  std::size_t count;
+};
+
+template <typename K, typename V>
+using flat_map_buckets =
+    std::conditional_t<niche_traits<K>::has_niche, niche_key_buckets<K, V>, optional_pair_buckets<K, V>>;
+
+} // namespace detail
+
+// Open-addressing hash map with linear probing and backward-shift deletion (no tombstones).
+// Bucket emptiness is encoded by optional<pair<K, V>> or, for keys with a niche, by the sentinel key itself.
+template <typename K, typename V, typename Hash = std::hash<K>, typename KeyEqual = std::equal_to<K>>
+class flat_optional_map {
+  using buckets_type = detail::flat_map_buckets<K, V>;
+
+  template <bool Const>
+  class basic_iterator {
+    using map_type = std::conditional_t<Const, const flat_optional_map, flat_optional_map>;
+    using mapped_reference = std::conditional_t<Const, const V&, V&>;
+
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using difference_type = std::ptrdiff_t;
+    using value_type = std::pair<const K, V>;
+    using reference = std::pair<const K&, mapped_reference>;
+
+    struct pointer {
+      reference ref;
+
+      const reference* operator->() const noexcept {
+        return std::addressof(ref);
+      }
+    };
+
+    basic_iterator() = default;
+
+    template <bool C = Const, std::enable_if_t<C, int> = 0>
+    basic_iterator(const basic_iterator<false>& other) noexcept
+        : map(other.map)
+        , index(other.index) {}
+
+    reference operator*() const noexcept {
+      return {map->buckets.key(index), map->buckets.value(index)};
+    }
+
+    pointer operator->() const noexcept {
+      return {**this};
+    }
+
+    basic_iterator& operator++() noexcept {
+      index = map->next_occupied(index + 1);
+      return *this;
+    }
+
+    basic_iterator operator++(int) noexcept {
+      basic_iterator result = *this;
+      ++*this;
+      return result;
+    }
+
+    friend bool operator==(const basic_iterator& lhs, const basic_iterator& rhs) noexcept {
+      return lhs.index == rhs.index;
+    }
+
+  private:
+    friend class flat_optional_map;
+
+    template <bool>
+    friend class basic_iterator;
+
+    basic_iterator(map_type* map, std::size_t index) noexcept
+        : map(map)
+        , index(index) {}
+
+    map_type* map = nullptr;
+    std::size_t index = 0;
+  };
+
+public:
+  using key_type = K;
+  using mapped_type = V;
+  using size_type = std::size_t;
+  using hasher = Hash;
+  using key_equal = KeyEqual;
+  using iterator = basic_iterator<false>;
+  using const_iterator = basic_iterator<true>;
+
+  flat_optional_map() = default;
+
+  explicit flat_optional_map(size_type capacity) {
+    reserve(capacity);
+  }
+
+  flat_optional_map(const flat_optional_map&) = delete;
+  flat_optional_map& operator=(const flat_optional_map&) = delete;
+
+  // The moved-from map is left empty, with no buckets
+  flat_optional_map(flat_optional_map&& other) noexcept
+      : buckets(std::move(other.buckets))
+      , count(std::exchange(other.count, 0))
+      , hash(std::move(other.hash))
+      , eq(std::move(other.eq)) {}
+
+  flat_optional_map& operator=(flat_optional_map&& other) noexcept {
+    buckets = std::move(other.buckets);
+    count = std::exchange(other.count, 0);
+    hash = std::move(other.hash);
+    eq = std::move(other.eq);
+    return *this;
+  }
+
+  size_type size() const noexcept {
+    return count;
+  }
+
+  bool empty() const noexcept {
+    return count == 0;
+  }
+
+  size_type bucket_count() const noexcept {
+    return buckets.size();
+  }
+
+  iterator begin() noexcept {
+    return {this, next_occupied(0)};
+  }
+
+  const_iterator begin() const noexcept {
+    return {this, next_occupied(0)};
+  }
+
+  iterator end() noexcept {
+    return {this, buckets.size()};
+  }
+
+  const_iterator end() const noexcept {
+    return {this, buckets.size()};
+  }
+
+  iterator find(const K& key) {
+    return {this, find_index(key)};
+  }
+
+  const_iterator find(const K& key) const {
+    return {this, find_index(key)};
+  }
+
+  bool contains(const K& key) const {
+    return find_index(key) != buckets.size();
+  }
+
+  template <typename... Args>
+  std::pair<iterator, bool> try_emplace(const K& key, Args&&... args) {
+    return emplace_impl(key, std::forward<Args>(args)...);
+  }
+
+  template <typename... Args>
+  std::pair<iterator, bool> try_emplace(K&& key, Args&&... args) {
+    return emplace_impl(std::move(key), std::forward<Args>(args)...);
+  }
+
+  template <typename M>
+  std::pair<iterator, bool> insert_or_assign(const K& key, M&& value) {
+    auto result = try_emplace(key, std::forward<M>(value));
+    if (!result.second) {
+      result.first->second = std::forward<M>(value);
+    }
+    return result;
+  }
+
+  V& operator[](const K& key) {
+    return try_emplace(key).first->second;
+  }
+
+  size_type erase(const K& key) {
+    size_type index = find_index(key);
+    if (index == buckets.size()) {
+      return 0;
+    }
+    erase_at(index);
+    return 1;
+  }
+
+  void clear() noexcept {
+    buckets = buckets_type(buckets.size());
+    count = 0;
+  }
+
+  void reserve(size_type n) {
+    size_type required = std::bit_ceil(n + n / 3 + 1);
+    if (required > buckets.size()) {
+      rehash(required);
+    }
+  }
+
+  // Strong exception guarantee, unless the elements can neither be copied nor moved without throwing. Keys are unique,
+  // so each one goes to the first vacant bucket from its home without being compared.
+  void rehash(size_type bucket_count) {
+    bucket_count = std::bit_ceil(std::max({bucket_count, count + count / 3 + 1, min_bucket_count}));
+    buckets_type new_buckets(bucket_count);
+    if constexpr (std::is_nothrow_move_constructible_v<K> && std::is_nothrow_move_constructible_v<V>) {
+      // Once the first element has moved nothing may throw, so a hash that can throw runs over every key beforehand
+      if constexpr (std::is_nothrow_invocable_v<const Hash&, const K&>) {
+        for (size_type i = 0; i < buckets.size(); ++i) {
+          if (buckets.occupied(i)) {
+            buckets.relocate(i, new_buckets, new_buckets.vacant(home(buckets.key(i), bucket_count)));
+          }
+        }
+      } else {
+        auto homes = std::make_unique_for_overwrite<size_type[]>(buckets.size());
+        for (size_type i = 0; i < buckets.size(); ++i) {
+          if (buckets.occupied(i)) {
+            homes[i] = home(buckets.key(i), bucket_count);
+          }
+        }
+        for (size_type i = 0; i < buckets.size(); ++i) {
+          if (buckets.occupied(i)) {
+            buckets.relocate(i, new_buckets, new_buckets.vacant(homes[i]));
+          }
+        }
+      }
+    } else {
+      // The elements stay in the old buckets until every copy has succeeded
+      for (size_type i = 0; i < buckets.size(); ++i) {
+        if (buckets.occupied(i)) {
+          buckets.copy_to(i, new_buckets, new_buckets.vacant(home(buckets.key(i), bucket_count)));
+        }
+      }
+    }
+    buckets = std::move(new_buckets);
+  }
+
+private:
+  static constexpr size_type min_bucket_count = 16;
+
+  // Fibonacci hashing spreads identity-hashed integer keys over the high bits
+  size_type home(const K& key, size_type bucket_count) const {
+    auto h = static_cast<std::uint64_t>(hash(key)) * 0x9E3779B97F4A7C15ull;
+    return static_cast<size_type>(h >> (64 - std::countr_zero(bucket_count)));
+  }
+
+  size_type next_occupied(size_type index) const noexcept {
+    while (index < buckets.size() && !buckets.occupied(index)) {
+      ++index;
+    }
+    return index;
+  }
+
+  size_type find_index(const K& key) const {
+    if (count == 0) {
+      return buckets.size();
+    }
+    auto [pos, found] = buckets.probe(key, home(key, buckets.size()), eq);
+    return found ? pos : buckets.size();
+  }
+
+  template <typename Key, typename... Args>
+  std::pair<iterator, bool> emplace_impl(Key&& key, Args&&... args) {
+    if constexpr (niche_traits<K>::has_niche) {
+      if (key == niche_traits<K>::empty()) {
+        throw std::invalid_argument("flat_optional_map: key is reserved as the empty niche");
+      }
+    }
+    if ((count + 1) * 4 > buckets.size() * 3) {
+      rehash(buckets.size() * 2);
+    }
+    auto [pos, found] = buckets.probe(key, home(key, buckets.size()), eq);
+    if (found) {
+      return {{this, pos}, false};
+    }
+    buckets.emplace(pos, std::forward<Key>(key), std::forward<Args>(args)...);
+    ++count;
+    return {{this, pos}, true};
+  }
+
+  void erase_at(size_type hole) {
+    const size_type mask = buckets.size() - 1;
+    buckets.destroy(hole);
+    --count;
+    for (size_type next = (hole + 1) & mask; buckets.occupied(next); next = (next + 1) & mask) {
+      size_type ideal = home(buckets.key(next), buckets.size());
+      // shift back only if the hole lies on the probe path from ideal to next
+      if (((next - ideal) & mask) >= ((next - hole) & mask)) {
+        buckets.relocate(next, buckets, hole);
+        hole = next;
+      }
+    }
+  }
+
+  buckets_type buckets;
+  size_type count = 0;
+  [[no_unique_address]] Hash hash;
+  [[no_unique_address]] KeyEqual eq;
+};
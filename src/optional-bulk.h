@@ -0,0 +1,89 @@
+#pragma once
+
+#include "optional.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <span>
+#include <type_traits>
+#include <utility>
+
+namespace detail {
+
+// optional<T> may be written as raw bytes: it is trivially copyable, and T is not const. An all-zero object
+// representation is a disengaged optional, since its flag is a bool.
+template <typename T>
+inline constexpr bool is_bytewise_optional_v = std::is_trivially_copyable_v<optional<T>> && !std::is_const_v<T>;
+
+// Writes the bytes of prototype to every element. The first block is filled by doubling and then copied over the
+// rest, so that all writes are memcpy-sized and the source stays in L1.
+template <typename T>
+void fill_bytewise(std::span<optional<T>> values, const optional<T>& prototype) noexcept {
+  constexpr std::size_t block = std::max<std::size_t>(1, 4096 / sizeof(optional<T>));
+
+  auto* data = values.data();
+  std::size_t size = values.size();
+  if (size == 0) {
+    return;
+  }
+  // prototype may be one of the elements, even the first
+  std::memmove(static_cast<void*>(data), static_cast<const void*>(&prototype), sizeof(optional<T>));
+  std::size_t filled = 1;
+  for (; filled < size && filled < block; filled *= 2) {
+    std::size_t count = std::min(filled, size - filled);
+    std::memcpy(static_cast<void*>(data + filled), static_cast<const void*>(data), count * sizeof(optional<T>));
+  }
+  filled = std::min(filled, size);
+  for (std::size_t i = filled; i < size; i += filled) {
+    std::size_t count = std::min(filled, size - i);
+    std::memcpy(static_cast<void*>(data + i), static_cast<const void*>(data), count * sizeof(optional<T>));
+  }
+}
+
+} // namespace detail
+
+// Disengages every element
+template <typename T>
+void reset_all(std::span<optional<T>> values) noexcept {
+  if constexpr (detail::is_bytewise_optional_v<T>) {
+    std::memset(static_cast<void*>(values.data()), 0, values.size_bytes());
+  } else {
+    // for trivially destructible T this is one flag store per element
+    for (auto& value : values) {
+      value.reset();
+    }
+  }
+}
+
+// Stores a copy of value in every element
+template <typename T>
+void fill(std::span<optional<T>> values, const optional<T>& value) {
+  if constexpr (detail::is_bytewise_optional_v<T>) {
+    if (!value.has_value()) {
+      reset_all(values);
+      return;
+    }
+    detail::fill_bytewise(values, value);
+  } else {
+    // assignment reuses the resources of elements that are already engaged
+    for (auto& element : values) {
+      element = value;
+    }
+  }
+}
+
+// Constructs T(args...) in every element, destroying the previous values
+template <typename T, typename... Args>
+void emplace_all(std::span<optional<T>> values, Args&&... args) {
+  if constexpr (detail::is_bytewise_optional_v<T>) {
+    if (!values.empty()) {
+      detail::fill_bytewise(values, optional<T>(in_place, std::forward<Args>(args)...));
+    }
+  } else {
+    // args are not forwarded, since they are used more than once
+    for (auto& element : values) {
+      element.emplace(args...);
+    }
+  }
+}
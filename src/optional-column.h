@@ -0,0 +1,152 @@
+#pragma once
+
+#include "optional.h"
+#include "rank-select-index.h"
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <utility>
+#include <vector>
+
+// An append-only column of optional<T>, stored as a validity bitmap plus the engaged values alone, in row order.
+// A sparse column costs one bit per empty row instead of a whole optional<T>.
+//
+// The values are reached through a rank/select index over the bitmap: row i holds value rank(i), found in constant
+// time, and the k-th value lives in row select(k), found in O(log n) time on a sparse column and nearly constant time
+// on a dense one. Appends extend the index in constant time.
+template <typename T>
+class optional_column {
+public:
+  using value_type = T;
+
+  optional_column() = default;
+
+  std::size_t size() const noexcept {
+    return length;
+  }
+
+  bool empty() const noexcept {
+    return length == 0;
+  }
+
+  // The number of engaged rows
+  std::size_t count() const noexcept {
+    return values.size();
+  }
+
+  void push_back(nullopt_t) {
+    append(false);
+  }
+
+  void push_back(const optional<T>& value) {
+    if (value.has_value()) {
+      emplace_back(*value);
+    } else {
+      append(false);
+    }
+  }
+
+  void push_back(optional<T>&& value) {
+    if (value.has_value()) {
+      emplace_back(*std::move(value));
+    } else {
+      append(false);
+    }
+  }
+
+  template <typename... Args>
+  T& emplace_back(Args&&... args) {
+    T& result = values.emplace_back(std::forward<Args>(args)...);
+    try {
+      append(true);
+    } catch (...) {
+      values.pop_back();
+      throw;
+    }
+    return result;
+  }
+
+  bool has_value(std::size_t i) const noexcept {
+    assert(i < length);
+    return (bits[i / 64] >> i % 64) & 1;
+  }
+
+  // The value of row i, which must be engaged
+  const T& operator[](std::size_t i) const noexcept {
+    assert(has_value(i));
+    return values[rank(i)];
+  }
+
+  T& operator[](std::size_t i) noexcept {
+    assert(has_value(i));
+    return values[rank(i)];
+  }
+
+  optional<T> get(std::size_t i) const {
+    return has_value(i) ? optional<T>(values[rank(i)]) : optional<T>();
+  }
+
+  // The number of engaged rows before row i, for i <= size()
+  std::size_t rank(std::size_t i) const noexcept {
+    return static_cast<std::size_t>(index.rank(bits, i));
+  }
+
+  // The row of the k-th engaged value, for k < count()
+  std::size_t select(std::size_t k) const noexcept {
+    return index.select(bits, k);
+  }
+
+  // The engaged values in row order; the k-th is in row select(k)
+  std::span<const T> engaged_values() const noexcept {
+    return values;
+  }
+
+  std::span<T> engaged_values() noexcept {
+    return values;
+  }
+
+  std::span<const std::uint64_t> validity() const noexcept {
+    return bits;
+  }
+
+  const rank_select_index& validity_index() const noexcept {
+    return index;
+  }
+
+  void reserve(std::size_t rows, std::size_t engaged) {
+    bits.reserve((rows + 63) / 64);
+    values.reserve(engaged);
+  }
+
+  void clear() noexcept {
+    values.clear();
+    bits.clear();
+    length = 0;
+    index = rank_select_index();
+  }
+
+private:
+  // Leaves the column unchanged if it throws
+  void append(bool engaged) {
+    if (length % 64 == 0) {
+      bits.push_back(0);
+    }
+    try {
+      index.push_back(engaged);
+    } catch (...) {
+      if (length % 64 == 0) {
+        bits.pop_back();
+      }
+      throw;
+    }
+    bits.back() |= std::uint64_t(engaged) << length % 64;
+    ++length;
+  }
+
+  std::vector<T> values;
+  std::vector<std::uint64_t> bits;
+  std::size_t length = 0;
+  rank_select_index index;
+};
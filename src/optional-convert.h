@@ -0,0 +1,30 @@
+#pragma once
+
+#include "optional.h"
+
+#include <cassert>
+#include <cstddef>
+#include <span>
+#include <utility>
+
+// Assigns to[i] = from[i], constructing or assigning each T directly from the U in from[i]
+template <typename T, typename U>
+constexpr void batch_convert(std::span<const optional<U>> from, std::span<optional<T>> to) {
+  assert(to.size() >= from.size());
+
+  optional<T>* dst = to.data();
+  for (std::size_t i = 0, n = from.size(); i < n; ++i) {
+    dst[i] = from[i];
+  }
+}
+
+// Same as batch_convert, but moves the values out of from; its optionals stay engaged
+template <typename T, typename U>
+constexpr void batch_convert_move(std::span<optional<U>> from, std::span<optional<T>> to) {
+  assert(to.size() >= from.size());
+
+  optional<T>* dst = to.data();
+  for (std::size_t i = 0, n = from.size(); i < n; ++i) {
+    dst[i] = std::move(from[i]);
+  }
+}
@@ -0,0 +1,488 @@
+#pragma once
+
+#include "optional.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+// optional_fields<Ts...> holds one optional value of each of Ts, like a struct of optional<Ts>, but keeps all the
+// engaged flags in a single bitmask after the values. The values are laid out by decreasing alignment, so a row
+// carries no padding other than at its very end: optional_fields<double, char, int> is 16 bytes, where a struct of
+// the three optionals is 32.
+//
+// Copying, moving and destroying a row is trivial exactly when it is for every optional<Ts>.
+
+template <typename T, bool Const = false>
+class optional_field_ref;
+
+namespace detail {
+
+template <typename... Ts>
+struct fields_layout {
+  static constexpr std::size_t count = sizeof...(Ts);
+  static constexpr std::size_t values_size = (sizeof(Ts) + ...);
+  static constexpr std::size_t alignment = std::max({alignof(Ts)...});
+  static constexpr std::size_t mask_size = (count + 7) / 8;
+
+  // Sizes are multiples of alignments, so after sorting by decreasing alignment every offset is aligned
+  static constexpr std::array<std::size_t, count> offsets = [] {
+    constexpr std::array<std::size_t, count> sizes{sizeof(Ts)...};
+    constexpr std::array<std::size_t, count> alignments{alignof(Ts)...};
+    std::array<std::size_t, count> order{};
+    for (std::size_t i = 0; i < count; ++i) {
+      order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), [&](std::size_t a, std::size_t b) {
+      return alignments[a] > alignments[b] || (alignments[a] == alignments[b] && a < b);
+    });
+    std::array<std::size_t, count> result{};
+    std::size_t offset = 0;
+    for (std::size_t i : order) {
+      result[i] = offset;
+      offset += sizes[i];
+    }
+    return result;
+  }();
+};
+
+template <typename... Ts>
+struct fields_storage_base {
+  using layout = fields_layout<Ts...>;
+
+  alignas(layout::alignment) std::byte values[layout::values_size];
+  unsigned char mask[layout::mask_size] = {};
+};
+
+template <bool TriviallyDestructible, typename... Ts>
+struct fields_storage : fields_storage_base<Ts...> {};
+
+template <typename... Ts>
+struct fields_storage<false, Ts...> : fields_storage_base<Ts...> {
+  fields_storage() = default;
+  fields_storage(const fields_storage&) = default;
+  fields_storage(fields_storage&&) = default;
+  fields_storage& operator=(const fields_storage&) = default;
+  fields_storage& operator=(fields_storage&&) = default;
+
+  ~fields_storage() {
+    destroy_all(std::index_sequence_for<Ts...>{});
+  }
+
+private:
+  template <std::size_t... Is>
+  void destroy_all(std::index_sequence<Is...>) noexcept {
+    (destroy<Is, Ts>(), ...);
+  }
+
+  template <std::size_t I, typename T>
+  void destroy() noexcept {
+    if (this->mask[I / 8] & (1u << I % 8)) {
+      std::destroy_at(std::launder(reinterpret_cast<T*>(this->values + fields_layout<Ts...>::offsets[I])));
+    }
+  }
+};
+
+template <typename... Ts>
+struct fields_ops : fields_storage<(std::is_trivially_destructible_v<Ts> && ...), Ts...> {
+  using layout = fields_layout<Ts...>;
+
+  template <std::size_t I>
+  using type = std::tuple_element_t<I, std::tuple<Ts...>>;
+
+  static constexpr bool trivially_copy_constructible = (std::is_trivially_copy_constructible_v<Ts> && ...);
+  static constexpr bool trivially_move_constructible = (std::is_trivially_move_constructible_v<Ts> && ...);
+  static constexpr bool trivially_copy_assignable = (is_trivially_copy_assignable_optional_v<Ts> && ...);
+  static constexpr bool trivially_move_assignable = (is_trivially_move_assignable_optional_v<Ts> && ...);
+
+  static constexpr bool nothrow_copy_constructible = (std::is_nothrow_copy_constructible_v<Ts> && ...);
+  static constexpr bool nothrow_move_constructible = (std::is_nothrow_move_constructible_v<Ts> && ...);
+  static constexpr bool nothrow_copy_assignable =
+      ((std::is_nothrow_copy_constructible_v<Ts> && std::is_nothrow_copy_assignable_v<Ts>) && ...);
+  static constexpr bool nothrow_move_assignable =
+      ((std::is_nothrow_move_constructible_v<Ts> && std::is_nothrow_move_assignable_v<Ts>) && ...);
+
+  template <std::size_t I>
+  bool engaged() const noexcept {
+    return this->mask[I / 8] & (1u << I % 8);
+  }
+
+  template <std::size_t I>
+  optional_field_ref<type<I>> field() noexcept {
+    return {this->values + layout::offsets[I], this->mask + I / 8, static_cast<unsigned char>(1u << I % 8)};
+  }
+
+  template <std::size_t I>
+  optional_field_ref<type<I>, true> field() const noexcept {
+    return {this->values + layout::offsets[I], this->mask + I / 8, static_cast<unsigned char>(1u << I % 8)};
+  }
+
+  template <typename Other>
+  void construct_from(Other&& other) {
+    construct_from(std::forward<Other>(other), std::index_sequence_for<Ts...>{});
+  }
+
+  template <typename Other>
+  void assign_from(Other&& other) {
+    assign_from(std::forward<Other>(other), std::index_sequence_for<Ts...>{});
+  }
+
+private:
+  // Fields are constructed one by one, so if one throws, the destructor of the storage cleans up the others
+  template <typename Other, std::size_t... Is>
+  void construct_from(Other&& other, std::index_sequence<Is...>) {
+    ((other.template engaged<Is>() ? static_cast<void>(field<Is>().emplace(forward_value<Other, Is>(other)))
+                                   : static_cast<void>(0)),
+     ...);
+  }
+
+  template <typename Other, std::size_t... Is>
+  void assign_from(Other&& other, std::index_sequence<Is...>) {
+    (assign_field<Is>(std::forward<Other>(other)), ...);
+  }
+
+  template <std::size_t I, typename Other>
+  void assign_field(Other&& other) {
+    auto to = field<I>();
+    if (other.template engaged<I>()) {
+      if (to.has_value()) {
+        *to = forward_value<Other, I>(other);
+      } else {
+        to.emplace(forward_value<Other, I>(other));
+      }
+    } else {
+      to.reset();
+    }
+  }
+
+  template <typename Other, std::size_t I>
+  static decltype(auto) forward_value(Other& other) noexcept {
+    auto& value = *other.template field<I>();
+    if constexpr (std::is_const_v<std::remove_reference_t<Other>> || std::is_lvalue_reference_v<Other>) {
+      return static_cast<const type<I>&>(value);
+    } else {
+      return std::move(value);
+    }
+  }
+};
+
+// Same layering as optional_ctor_base and optional_assign_base, over the whole row
+template <
+    typename Ops,
+    bool = Ops::trivially_copy_constructible,
+    bool = Ops::trivially_move_constructible>
+struct fields_ctor_base : Ops {};
+
+template <typename Ops>
+struct fields_ctor_base<Ops, false, true> : Ops {
+  fields_ctor_base() = default;
+
+  fields_ctor_base(const fields_ctor_base& other) noexcept(Ops::nothrow_copy_constructible)
+      : Ops() {
+    this->construct_from(other);
+  }
+
+  fields_ctor_base(fields_ctor_base&&) = default;
+  fields_ctor_base& operator=(const fields_ctor_base&) = default;
+  fields_ctor_base& operator=(fields_ctor_base&&) = default;
+};
+
+template <typename Ops>
+struct fields_ctor_base<Ops, true, false> : Ops {
+  fields_ctor_base() = default;
+  fields_ctor_base(const fields_ctor_base&) = default;
+
+  fields_ctor_base(fields_ctor_base&& other) noexcept(Ops::nothrow_move_constructible)
+      : Ops() {
+    this->construct_from(std::move(other));
+  }
+
+  fields_ctor_base& operator=(const fields_ctor_base&) = default;
+  fields_ctor_base& operator=(fields_ctor_base&&) = default;
+};
+
+template <typename Ops>
+struct fields_ctor_base<Ops, false, false> : Ops {
+  fields_ctor_base() = default;
+
+  fields_ctor_base(const fields_ctor_base& other) noexcept(Ops::nothrow_copy_constructible)
+      : Ops() {
+    this->construct_from(other);
+  }
+
+  fields_ctor_base(fields_ctor_base&& other) noexcept(Ops::nothrow_move_constructible)
+      : Ops() {
+    this->construct_from(std::move(other));
+  }
+
+  fields_ctor_base& operator=(const fields_ctor_base&) = default;
+  fields_ctor_base& operator=(fields_ctor_base&&) = default;
+};
+
+template <
+    typename Ops,
+    bool = Ops::trivially_copy_assignable,
+    bool = Ops::trivially_move_assignable>
+struct fields_assign_base : fields_ctor_base<Ops> {};
+
+template <typename Ops>
+struct fields_assign_base<Ops, false, true> : fields_ctor_base<Ops> {
+  fields_assign_base() = default;
+  fields_assign_base(const fields_assign_base&) = default;
+  fields_assign_base(fields_assign_base&&) = default;
+
+  fields_assign_base& operator=(const fields_assign_base& other) noexcept(Ops::nothrow_copy_assignable) {
+    this->assign_from(other);
+    return *this;
+  }
+
+  fields_assign_base& operator=(fields_assign_base&&) = default;
+};
+
+template <typename Ops>
+struct fields_assign_base<Ops, true, false> : fields_ctor_base<Ops> {
+  fields_assign_base() = default;
+  fields_assign_base(const fields_assign_base&) = default;
+  fields_assign_base(fields_assign_base&&) = default;
+  fields_assign_base& operator=(const fields_assign_base&) = default;
+
+  fields_assign_base& operator=(fields_assign_base&& other) noexcept(Ops::nothrow_move_assignable) {
+    this->assign_from(std::move(other));
+    return *this;
+  }
+};
+
+template <typename Ops>
+struct fields_assign_base<Ops, false, false> : fields_ctor_base<Ops> {
+  fields_assign_base() = default;
+  fields_assign_base(const fields_assign_base&) = default;
+  fields_assign_base(fields_assign_base&&) = default;
+
+  fields_assign_base& operator=(const fields_assign_base& other) noexcept(Ops::nothrow_copy_assignable) {
+    this->assign_from(other);
+    return *this;
+  }
+
+  fields_assign_base& operator=(fields_assign_base&& other) noexcept(Ops::nothrow_move_assignable) {
+    this->assign_from(std::move(other));
+    return *this;
+  }
+};
+
+} // namespace detail
+
+// A reference to one field of an optional_fields row that behaves like an optional<T>. Assigning to it assigns to
+// the field; it is never rebound.
+template <typename T, bool Const>
+class optional_field_ref {
+  using byte_pointer = std::conditional_t<Const, const std::byte*, std::byte*>;
+  using mask_pointer = std::conditional_t<Const, const unsigned char*, unsigned char*>;
+  using element_type = std::conditional_t<Const, const T, T>;
+
+  template <typename... Ts>
+  friend struct detail::fields_ops;
+
+  friend class optional_field_ref<T, true>;
+
+  optional_field_ref(byte_pointer value, mask_pointer mask, unsigned char bit) noexcept
+      : address(value)
+      , mask(mask)
+      , bit(bit) {}
+
+public:
+  using value_type = T;
+
+  template <bool OtherConst = Const, std::enable_if_t<OtherConst, int> = 0>
+  optional_field_ref(const optional_field_ref<T>& other) noexcept
+      : address(other.address)
+      , mask(other.mask)
+      , bit(other.bit) {}
+
+  optional_field_ref(const optional_field_ref&) = default;
+
+  bool has_value() const noexcept {
+    return *mask & bit;
+  }
+
+  explicit operator bool() const noexcept {
+    return has_value();
+  }
+
+  element_type& operator*() const noexcept {
+    return *std::launder(reinterpret_cast<element_type*>(address));
+  }
+
+  element_type* operator->() const noexcept {
+    return std::addressof(**this);
+  }
+
+  template <typename U = std::remove_cv_t<T>>
+  std::remove_cv_t<T> value_or(U&& default_value) const {
+    return has_value() ? static_cast<std::remove_cv_t<T>>(**this)
+                       : static_cast<std::remove_cv_t<T>>(std::forward<U>(default_value));
+  }
+
+  template <typename U, std::enable_if_t<std::is_same_v<U, std::remove_cv_t<T>>, int> = 0>
+  operator optional<U>() const {
+    return has_value() ? optional<U>(**this) : optional<U>();
+  }
+
+  template <bool Mutable = !Const, std::enable_if_t<Mutable, int> = 0>
+  void reset() const noexcept {
+    if (has_value()) {
+      *mask &= static_cast<unsigned char>(~bit);
+      std::destroy_at(std::addressof(**this));
+    }
+  }
+
+  template <
+      typename... Args,
+      bool Mutable = !Const,
+      std::enable_if_t<Mutable && std::is_constructible_v<T, Args&&...>, int> = 0>
+  T& emplace(Args&&... args) const noexcept(std::is_nothrow_constructible_v<T, Args&&...>) {
+    reset();
+    T* value = ::new (static_cast<void*>(address)) T(std::forward<Args>(args)...);
+    *mask |= bit;
+    return *value;
+  }
+
+  template <bool Mutable = !Const, std::enable_if_t<Mutable, int> = 0>
+  const optional_field_ref& operator=(nullopt_t) const noexcept {
+    reset();
+    return *this;
+  }
+
+  template <
+      typename U = T,
+      bool Mutable = !Const,
+      std::enable_if_t<
+          Mutable && !std::is_same_v<std::remove_cvref_t<U>, optional_field_ref> &&
+              std::is_constructible_v<T, U> && std::is_assignable_v<T&, U>,
+          int> = 0>
+  const optional_field_ref& operator=(U&& value) const {
+    if (has_value()) {
+      **this = std::forward<U>(value);
+    } else {
+      emplace(std::forward<U>(value));
+    }
+    return *this;
+  }
+
+  // Assigns the other field's contents, like assigning one optional to another
+  const optional_field_ref& operator=(const optional_field_ref& other) const {
+    static_assert(!Const, "a const field reference cannot be assigned to");
+    if (!other.has_value()) {
+      reset();
+    } else if (has_value()) {
+      **this = *other;
+    } else {
+      emplace(*other);
+    }
+    return *this;
+  }
+
+private:
+  byte_pointer address;
+  mask_pointer mask;
+  unsigned char bit;
+};
+
+template <typename... Ts>
+class optional_fields
+    : private detail::fields_assign_base<detail::fields_ops<Ts...>>
+    , private detail::enable_ctors<
+          (std::is_copy_constructible_v<Ts> && ...),
+          (std::is_move_constructible_v<Ts> && ...)>
+    , private detail::enable_assigns<
+          ((std::is_copy_constructible_v<Ts> && std::is_copy_assignable_v<Ts>) && ...),
+          ((std::is_move_constructible_v<Ts> && std::is_move_assignable_v<Ts>) && ...)> {
+  static_assert(sizeof...(Ts) > 0, "optional_fields needs at least one field");
+
+  using ops = detail::fields_ops<Ts...>;
+
+public:
+  template <std::size_t I>
+  using field_type = std::tuple_element_t<I, std::tuple<Ts...>>;
+
+  optional_fields() noexcept = default;
+
+  optional_fields(const optional_fields&) = default;
+  optional_fields(optional_fields&&) = default;
+
+  optional_fields& operator=(const optional_fields&) = default;
+  optional_fields& operator=(optional_fields&&) = default;
+
+  static constexpr std::size_t size() noexcept {
+    return sizeof...(Ts);
+  }
+
+  template <std::size_t I>
+  bool has() const noexcept {
+    static_assert(I < sizeof...(Ts), "field index out of range");
+    return this->template engaged<I>();
+  }
+
+  template <std::size_t I>
+  optional_field_ref<field_type<I>> get() noexcept {
+    static_assert(I < sizeof...(Ts), "field index out of range");
+    return this->template field<I>();
+  }
+
+  template <std::size_t I>
+  optional_field_ref<field_type<I>, true> get() const noexcept {
+    static_assert(I < sizeof...(Ts), "field index out of range");
+    return this->template field<I>();
+  }
+
+  bool any() const noexcept {
+    for (std::size_t i = 0; i < mask_size; i += sizeof(std::uint64_t)) {
+      if (mask_word(i) != 0) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  bool all() const noexcept {
+    return count() == sizeof...(Ts);
+  }
+
+  std::size_t count() const noexcept {
+    std::size_t result = 0;
+    for (std::size_t i = 0; i < mask_size; i += sizeof(std::uint64_t)) {
+      result += static_cast<std::size_t>(std::popcount(mask_word(i)));
+    }
+    return result;
+  }
+
+  void reset() noexcept {
+    reset(std::index_sequence_for<Ts...>{});
+  }
+
+private:
+  static constexpr std::size_t mask_size = ops::layout::mask_size;
+
+  // Unused bits of the mask are always clear, so whole words can be counted
+  std::uint64_t mask_word(std::size_t offset) const noexcept {
+    std::uint64_t word = 0;
+    std::memcpy(&word, this->mask + offset, std::min(sizeof(word), mask_size - offset));
+    return word;
+  }
+
+  template <std::size_t... Is>
+  void reset(std::index_sequence<Is...>) noexcept {
+    if constexpr ((std::is_trivially_destructible_v<Ts> && ...)) {
+      std::fill(std::begin(this->mask), std::end(this->mask), 0);
+    } else {
+      (get<Is>().reset(), ...);
+    }
+  }
+};
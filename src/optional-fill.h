@@ -0,0 +1,336 @@
+#pragma once
+
+#include "optional-bulk.h"
+#include "optional.h"
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Gap filling over spans of optional<T>, into dense T or in place:
+//  - fill_value_or puts a default in place of every empty element;
+//  - forward_fill carries the last engaged value forward over the empty elements after it;
+//  - backward_fill carries the next engaged value backward over the empty elements before it.
+//
+// For arithmetic T the loops have no data-dependent branches: the value bytes are read whether the optional is
+// engaged or not, and the flag selects between them through a bit mask, so the loops run at the same speed however the
+// empty elements are scattered. parallel_forward_fill splits a long span into chunks filled on separate threads.
+
+namespace detail {
+
+template <std::size_t Size>
+struct fill_bits {};
+
+template <>
+struct fill_bits<1> {
+  using type = std::uint8_t;
+};
+
+template <>
+struct fill_bits<2> {
+  using type = std::uint16_t;
+};
+
+template <>
+struct fill_bits<4> {
+  using type = std::uint32_t;
+};
+
+template <>
+struct fill_bits<8> {
+  using type = std::uint64_t;
+};
+
+// The branchless loops read the value bytes of empty optionals too. Those bytes are indeterminate when the optional was
+// default-constructed or reset, and using them as a T is formally undefined in C++20; the loops rely on the compilers
+// they target to treat such a read as producing some unspecified bits, which the mask then discards. MemorySanitizer
+// reports it, so an MSan build should not use these loops. Zeroing the storage of every empty optional would make the
+// reads well-defined at the cost of a store in each default constructor and reset, which optional does not pay.
+template <typename T, typename = void>
+inline constexpr bool is_branchless_fill_v = false;
+
+template <typename T>
+inline constexpr bool is_branchless_fill_v<T, std::void_t<typename fill_bits<sizeof(T)>::type>> =
+    std::is_arithmetic_v<T> && is_bytewise_optional_v<T>;
+
+// The stored bytes, which are only a value of T when the optional is engaged; see is_branchless_fill_v
+template <typename T>
+T raw_value(const optional<T>& value) noexcept {
+  T result;
+  std::memcpy(&result, optional_access::storage(value), sizeof(T));
+  return result;
+}
+
+// engaged ? value : fallback, as a mask over the bits. GCC turns a conditional on floating-point values into a branch,
+// which mispredicts on irregular data.
+template <typename T>
+T select(bool engaged, T value, T fallback) noexcept {
+  using bits = typename fill_bits<sizeof(T)>::type;
+  auto mask = static_cast<bits>(-static_cast<bits>(engaged));
+  return std::bit_cast<T>(
+      static_cast<bits>((std::bit_cast<bits>(value) & mask) | (std::bit_cast<bits>(fallback) & ~mask))
+  );
+}
+
+// Both the value bytes and the flag are written unconditionally, without a branch on engaged
+template <typename T>
+void store_raw(optional<T>& target, T value, bool engaged) noexcept {
+  std::memcpy(optional_access::storage(target), &value, sizeof(T));
+  optional_access::engaged(target) = engaged;
+}
+
+// Number of chunks for a parallel fill: no more than threads, and none shorter than min_chunk
+inline std::size_t fill_chunks(std::size_t size, std::size_t threads) noexcept {
+  constexpr std::size_t min_chunk = std::size_t(1) << 16;
+  if (threads == 0) {
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  return std::max<std::size_t>(1, std::min(threads, size / min_chunk));
+}
+
+// Runs f(0), ..., f(count - 1) on count threads, the calling one included
+template <typename F>
+void run_chunks(std::size_t count, const F& f) {
+  std::vector<std::thread> threads;
+  threads.reserve(count - 1);
+  try {
+    for (std::size_t i = 1; i < count; ++i) {
+      threads.emplace_back(f, i);
+    }
+  } catch (...) {
+    for (auto& thread : threads) {
+      thread.join();
+    }
+    throw;
+  }
+  f(0);
+  for (auto& thread : threads) {
+    thread.join();
+  }
+}
+
+} // namespace detail
+
+// out[i] is *values[i], or default_value where values[i] is empty
+template <typename T>
+void fill_value_or(std::span<const optional<T>> values, std::span<T> out, const T& default_value) {
+  assert(out.size() == values.size());
+  if constexpr (detail::is_branchless_fill_v<T>) {
+    const T fallback = default_value;
+    for (std::size_t i = 0; i < values.size(); ++i) {
+      T value = detail::raw_value(values[i]);
+      out[i] = detail::select(values[i].has_value(), value, fallback);
+    }
+  } else {
+    for (std::size_t i = 0; i < values.size(); ++i) {
+      out[i] = values[i].has_value() ? *values[i] : default_value;
+    }
+  }
+}
+
+// Engages every empty element with a copy of default_value
+template <typename T>
+void fill_value_or(std::span<optional<T>> values, const T& default_value) {
+  if constexpr (detail::is_branchless_fill_v<T>) {
+    const T fallback = default_value;
+    for (auto& element : values) {
+      T value = detail::raw_value(element);
+      detail::store_raw(element, detail::select(element.has_value(), value, fallback), true);
+    }
+  } else {
+    for (auto& element : values) {
+      if (!element.has_value()) {
+        element.emplace(default_value);
+      }
+    }
+  }
+}
+
+// out[i] is the value of the last engaged values[j] with j <= i, or initial if there is none
+template <typename T>
+void forward_fill(std::span<const optional<T>> values, std::span<T> out, const T& initial) {
+  assert(out.size() == values.size());
+  if constexpr (detail::is_branchless_fill_v<T>) {
+    T carry = initial;
+    for (std::size_t i = 0; i < values.size(); ++i) {
+      T value = detail::raw_value(values[i]);
+      carry = detail::select(values[i].has_value(), value, carry);
+      out[i] = carry;
+    }
+  } else {
+    const T* carry = &initial;
+    for (std::size_t i = 0; i < values.size(); ++i) {
+      if (values[i].has_value()) {
+        carry = &*values[i];
+      }
+      out[i] = *carry;
+    }
+  }
+}
+
+// Engages every empty element that follows an engaged one with the value of the last engaged element before it.
+// Leading empty elements stay empty.
+template <typename T>
+void forward_fill(std::span<optional<T>> values) {
+  if constexpr (detail::is_branchless_fill_v<T>) {
+    T carry{};
+    bool seen = false;
+    for (auto& element : values) {
+      T value = detail::raw_value(element);
+      bool engaged = element.has_value();
+      carry = detail::select(engaged, value, carry);
+      seen |= engaged;
+      detail::store_raw(element, carry, seen);
+    }
+  } else {
+    const optional<T>* carry = nullptr;
+    for (auto& element : values) {
+      if (element.has_value()) {
+        carry = &element;
+      } else if (carry != nullptr) {
+        element.emplace(**carry);
+      }
+    }
+  }
+}
+
+// out[i] is the value of the first engaged values[j] with j >= i, or initial if there is none
+template <typename T>
+void backward_fill(std::span<const optional<T>> values, std::span<T> out, const T& initial) {
+  assert(out.size() == values.size());
+  if constexpr (detail::is_branchless_fill_v<T>) {
+    T carry = initial;
+    for (std::size_t i = values.size(); i-- > 0;) {
+      T value = detail::raw_value(values[i]);
+      carry = detail::select(values[i].has_value(), value, carry);
+      out[i] = carry;
+    }
+  } else {
+    const T* carry = &initial;
+    for (std::size_t i = values.size(); i-- > 0;) {
+      if (values[i].has_value()) {
+        carry = &*values[i];
+      }
+      out[i] = *carry;
+    }
+  }
+}
+
+// Engages every empty element that precedes an engaged one with the value of the first engaged element after it.
+// Trailing empty elements stay empty.
+template <typename T>
+void backward_fill(std::span<optional<T>> values) {
+  if constexpr (detail::is_branchless_fill_v<T>) {
+    T carry{};
+    bool seen = false;
+    for (std::size_t i = values.size(); i-- > 0;) {
+      T value = detail::raw_value(values[i]);
+      bool engaged = values[i].has_value();
+      carry = detail::select(engaged, value, carry);
+      seen |= engaged;
+      detail::store_raw(values[i], carry, seen);
+    }
+  } else {
+    const optional<T>* carry = nullptr;
+    for (std::size_t i = values.size(); i-- > 0;) {
+      if (values[i].has_value()) {
+        carry = &values[i];
+      } else if (carry != nullptr) {
+        values[i].emplace(**carry);
+      }
+    }
+  }
+}
+
+// forward_fill in place, on up to threads threads (0 for one per core). Every chunk is filled on its own, then the
+// leading empty elements of each chunk get the last value of the closest earlier chunk that has one.
+template <typename T>
+void parallel_forward_fill(std::span<optional<T>> values, std::size_t threads = 0) {
+  static_assert(std::is_nothrow_copy_constructible_v<T>, "a copy that throws would escape a worker thread");
+
+  std::size_t chunks = detail::fill_chunks(values.size(), threads);
+  if (chunks == 1) {
+    forward_fill(values);
+    return;
+  }
+  std::size_t chunk_size = (values.size() + chunks - 1) / chunks;
+  auto chunk = [&](std::size_t i) {
+    return values.subspan(i * chunk_size, std::min(chunk_size, values.size() - i * chunk_size));
+  };
+
+  detail::run_chunks(chunks, [&](std::size_t i) { forward_fill(chunk(i)); });
+
+  // After filling, the last element of a chunk is engaged exactly when the chunk has any engaged element
+  std::vector<const optional<T>*> carry(chunks, nullptr);
+  for (std::size_t i = 1; i < chunks; ++i) {
+    const optional<T>& last = chunk(i - 1).back();
+    carry[i] = last.has_value() ? &last : carry[i - 1];
+  }
+
+  detail::run_chunks(chunks, [&](std::size_t i) {
+    if (carry[i] == nullptr) {
+      return;
+    }
+    for (auto& element : chunk(i)) {
+      if (element.has_value()) {
+        break;
+      }
+      element.emplace(**carry[i]);
+    }
+  });
+}
+
+// forward_fill into dense out, on up to threads threads (0 for one per core)
+template <typename T>
+void parallel_forward_fill(
+    std::span<const optional<T>> values,
+    std::span<T> out,
+    const T& initial,
+    std::size_t threads = 0
+) {
+  static_assert(std::is_nothrow_copy_assignable_v<T>, "a copy that throws would escape a worker thread");
+  assert(out.size() == values.size());
+
+  std::size_t chunks = detail::fill_chunks(values.size(), threads);
+  if (chunks == 1) {
+    forward_fill(values, out, initial);
+    return;
+  }
+  std::size_t chunk_size = (values.size() + chunks - 1) / chunks;
+  auto bounds = [&](std::size_t i) {
+    return std::pair(i * chunk_size, std::min(values.size(), (i + 1) * chunk_size));
+  };
+
+  // Every chunk starts from initial; its leading empty elements are corrected below
+  std::vector<const T*> last(chunks, nullptr);
+  detail::run_chunks(chunks, [&](std::size_t i) {
+    auto [begin, end] = bounds(i);
+    forward_fill(values.subspan(begin, end - begin), out.subspan(begin, end - begin), initial);
+    for (std::size_t j = end; j-- > begin;) {
+      if (values[j].has_value()) {
+        last[i] = &*values[j];
+        break;
+      }
+    }
+  });
+
+  std::vector<const T*> carry(chunks, &initial);
+  for (std::size_t i = 1; i < chunks; ++i) {
+    carry[i] = last[i - 1] != nullptr ? last[i - 1] : carry[i - 1];
+  }
+
+  detail::run_chunks(chunks, [&](std::size_t i) {
+    auto [begin, end] = bounds(i);
+    for (std::size_t j = begin; j < end && !values[j].has_value(); ++j) {
+      out[j] = *carry[i];
+    }
+  });
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "optional.h"
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <type_traits>
+
+// 64-bit finalizer from MurmurHash3: full avalanche using only xor, shift and multiply
+constexpr std::uint64_t hash_mix(std::uint64_t x) noexcept {
+  x ^= x >> 33;
+  x *= 0xff51afd7ed558ccdull;
+  x ^= x >> 33;
+  x *= 0xc4ceb9fe1a85ec53ull;
+  x ^= x >> 33;
+  return x;
+}
+
+// Well-mixed hash of one optional, identical to what batch_hash produces for it
+template <typename T>
+std::uint64_t mixed_hash(const optional<T>& value) {
+  if constexpr (std::is_integral_v<T>) {
+    return hash_mix(value.has_value() ? static_cast<std::uint64_t>(*value) : detail::optional_empty_hash);
+  } else {
+    return hash_mix(std::hash<optional<T>>{}(value));
+  }
+}
+
+// Writes mixed_hash(values[i]) to out[i]
+template <typename T>
+void batch_hash(std::span<const optional<T>> values, std::span<std::uint64_t> out) {
+  assert(out.size() >= values.size());
+
+  // Iterations are independent and call-free for integral T, so the multiplies pipeline; the compiler is left to
+  // vectorize them where the target has a 64-bit vector multiply
+  const optional<T>* in = values.data();
+  std::uint64_t* dst = out.data();
+  for (std::size_t i = 0, n = values.size(); i < n; ++i) {
+    dst[i] = mixed_hash(in[i]);
+  }
+}
@@ -0,0 +1,282 @@
+#pragma once
+
+// Opt-in operation counters for optional<T>, enabled by compiling with OPTIONAL_INSTRUMENTATION=1.
+// The setting must be the same in every translation unit of a program, since it changes optional's member functions.
+//
+// Copies and moves are counted only where optional performs them itself: for trivially copyable T the copy and
+// move operations of optional stay trivial and are not observable.
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <typeinfo>
+#include <utility>
+#include <vector>
+
+#if __has_include(<cxxabi.h>)
+#include <cstdlib>
+#include <cxxabi.h>
+#endif
+
+enum class optional_event : unsigned char {
+  construct,
+  copy,
+  move,
+  emplace,
+  reset,
+  swap,
+  empty_dereference,
+};
+
+inline constexpr std::size_t optional_event_count = 7;
+
+inline const char* to_string(optional_event event) noexcept {
+  constexpr std::array<const char*, optional_event_count> names = {
+      "construct", "copy", "move", "emplace", "reset", "swap", "empty_dereference",
+  };
+  return names[static_cast<std::size_t>(event)];
+}
+
+struct optional_counters {
+  std::array<std::uint64_t, optional_event_count> counts{};
+
+  std::uint64_t operator[](optional_event event) const noexcept {
+    return counts[static_cast<std::size_t>(event)];
+  }
+
+  std::uint64_t total() const noexcept {
+    std::uint64_t sum = 0;
+    for (auto count : counts) {
+      sum += count;
+    }
+    return sum;
+  }
+
+  optional_counters& operator+=(const optional_counters& other) noexcept {
+    for (std::size_t i = 0; i < optional_event_count; ++i) {
+      counts[i] += other.counts[i];
+    }
+    return *this;
+  }
+
+  friend bool operator==(const optional_counters&, const optional_counters&) = default;
+};
+
+// Receives every event as it happens, with the addresses of the optionals involved: self is the optional the event
+// happens to, other (or nullptr) the one it copies, moves or swaps with. Called on the thread of the event, from inside
+// the special members of optional, so it must not throw.
+struct optional_event_sink {
+  virtual void on_event(
+      const std::type_info& type,
+      optional_event event,
+      const void* self,
+      const void* other
+  ) noexcept = 0;
+
+protected:
+  ~optional_event_sink() = default;
+};
+
+namespace detail {
+
+inline std::atomic<optional_event_sink*> optional_sink{nullptr};
+
+// Counters of one thread for one T. Only the owning thread writes them, so an increment is a plain load and store;
+// they are atomic so that aggregation from another thread is race-free.
+struct optional_thread_counters {
+  std::array<std::atomic<std::uint64_t>, optional_event_count> counts{};
+
+  void increment(optional_event event) noexcept {
+    auto& count = counts[static_cast<std::size_t>(event)];
+    count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  }
+
+  optional_counters load() const noexcept {
+    optional_counters result;
+    for (std::size_t i = 0; i < optional_event_count; ++i) {
+      result.counts[i] = counts[i].load(std::memory_order_relaxed);
+    }
+    return result;
+  }
+
+  void clear() noexcept {
+    for (auto& count : counts) {
+      count.store(0, std::memory_order_relaxed);
+    }
+  }
+};
+
+struct optional_type_record {
+  std::string name;
+  optional_counters retired;
+  std::vector<optional_thread_counters*> live;
+
+  optional_counters total() const noexcept {
+    optional_counters result = retired;
+    for (auto* counters : live) {
+      result += counters->load();
+    }
+    return result;
+  }
+};
+
+class optional_registry {
+public:
+  static optional_registry& instance() {
+    static optional_registry registry;
+    return registry;
+  }
+
+  optional_type_record& add_type(std::string name) {
+    std::lock_guard lock(mutex);
+    types.push_back(std::make_unique<optional_type_record>());
+    types.back()->name = std::move(name);
+    return *types.back();
+  }
+
+  void attach(optional_type_record& type, optional_thread_counters& counters) {
+    std::lock_guard lock(mutex);
+    type.live.push_back(&counters);
+  }
+
+  void detach(optional_type_record& type, optional_thread_counters& counters) {
+    std::lock_guard lock(mutex);
+    type.retired += counters.load();
+    std::erase(type.live, &counters);
+  }
+
+  optional_counters snapshot(const optional_type_record& type) {
+    std::lock_guard lock(mutex);
+    return type.total();
+  }
+
+  std::vector<std::pair<std::string, optional_counters>> snapshot_all() {
+    std::lock_guard lock(mutex);
+    std::vector<std::pair<std::string, optional_counters>> result;
+    result.reserve(types.size());
+    for (const auto& type : types) {
+      result.emplace_back(type->name, type->total());
+    }
+    return result;
+  }
+
+  void clear() {
+    std::lock_guard lock(mutex);
+    for (const auto& type : types) {
+      type->retired = {};
+      for (auto* counters : type->live) {
+        counters->clear();
+      }
+    }
+  }
+
+private:
+  std::mutex mutex;
+  std::vector<std::unique_ptr<optional_type_record>> types;
+};
+
+template <typename T>
+std::string optional_type_name() {
+  const char* mangled = typeid(T).name();
+#if __has_include(<cxxabi.h>)
+  int status = 0;
+  std::unique_ptr<char, void (*)(void*)> demangled(abi::__cxa_demangle(mangled, nullptr, nullptr, &status), std::free);
+  if (status == 0 && demangled) {
+    return demangled.get();
+  }
+#endif
+  return mangled;
+}
+
+template <typename T>
+optional_type_record& optional_type() {
+  static optional_type_record& type = optional_registry::instance().add_type(optional_type_name<T>());
+  return type;
+}
+
+template <typename T>
+class optional_thread_slot {
+public:
+  optional_thread_slot()
+      : type(optional_type<T>()) {
+    optional_registry::instance().attach(type, counters);
+  }
+
+  optional_thread_slot(const optional_thread_slot&) = delete;
+  optional_thread_slot& operator=(const optional_thread_slot&) = delete;
+
+  ~optional_thread_slot() {
+    optional_registry::instance().detach(type, counters);
+  }
+
+  void increment(optional_event event) noexcept {
+    counters.increment(event);
+  }
+
+private:
+  optional_type_record& type;
+  optional_thread_counters counters;
+};
+
+} // namespace detail
+
+// Aggregated view of the counters; totals include threads that have already exited
+struct optional_instrumentation {
+  // The first event of a thread registers its counters, which allocates. If that fails, the event is not counted and
+  // the next one tries again, rather than terminating the program from inside optional's noexcept members.
+  template <typename T>
+  static void record(optional_event event) noexcept {
+    try {
+      thread_local detail::optional_thread_slot<T> slot;
+      slot.increment(event);
+    } catch (...) {
+    }
+  }
+
+  template <typename T>
+  static void record(optional_event event, const void* self, const void* other) noexcept {
+    record<T>(event);
+    if (auto* sink = detail::optional_sink.load(std::memory_order_acquire)) {
+      sink->on_event(typeid(T), event, self, other);
+    }
+  }
+
+  // Installs a sink that sees every event from now on, or removes it with nullptr; returns the previous one. The sink
+  // must outlive any event that may still be delivered to it.
+  static optional_event_sink* set_sink(optional_event_sink* sink) noexcept {
+    return detail::optional_sink.exchange(sink, std::memory_order_acq_rel);
+  }
+
+  template <typename T>
+  static optional_counters snapshot() {
+    return detail::optional_registry::instance().snapshot(detail::optional_type<T>());
+  }
+
+  static std::vector<std::pair<std::string, optional_counters>> snapshot_all() {
+    return detail::optional_registry::instance().snapshot_all();
+  }
+
+  // Zeroes all counters. Increments racing with a reset may survive it.
+  static void reset() {
+    detail::optional_registry::instance().clear();
+  }
+
+  // One line per value type that recorded anything: "optional<T>: event=count ..."
+  static void report(std::ostream& out) {
+    for (const auto& [name, counters] : snapshot_all()) {
+      if (counters.total() == 0) {
+        continue;
+      }
+      out << "optional<" << name << ">:";
+      for (std::size_t i = 0; i < optional_event_count; ++i) {
+        out << ' ' << to_string(static_cast<optional_event>(i)) << '=' << counters.counts[i];
+      }
+      out << '\n';
+    }
+  }
+};
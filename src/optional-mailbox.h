@@ -0,0 +1,185 @@
+#pragma once
+
+#include "optional.h"
+#include "padded-optional.h"
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+// A latest-value-wins handoff of optional<T> from one writer thread to a fixed number of reader threads, for values
+// that cannot be copied atomically. Neither side takes a lock.
+//
+// The mailbox is a triple buffer with one extra buffer per additional reader. The writer fills a back buffer that no
+// reader holds, then publishes it with a single atomic exchange. A reader keeps the buffer it last read until something
+// newer is published, so reading an unchanged value costs one atomic load and never copies it. Every buffer counts the
+// readers holding it, and the writer only reuses a buffer whose count is zero. A read that races with a publish may
+// retry; the writer never waits for a reader that is done with its read() call.
+template <typename T>
+class optional_mailbox {
+  // The buffer index sits in the low half, the publication number in the high half
+  using state_type = std::uint64_t;
+
+  static constexpr std::size_t none = static_cast<std::size_t>(-1);
+
+  struct alignas(destructive_interference_size) slot {
+    optional<T> value;
+    std::atomic<std::size_t> readers{0};
+  };
+
+  static std::size_t buffer(state_type state) noexcept {
+    return static_cast<std::uint32_t>(state);
+  }
+
+  static std::uint32_t publication(state_type state) noexcept {
+    return static_cast<std::uint32_t>(state >> 32);
+  }
+
+public:
+  using value_type = T;
+
+  class reader {
+    friend class optional_mailbox;
+
+    explicit reader(optional_mailbox& mailbox) noexcept
+        : mailbox(&mailbox) {}
+
+  public:
+    reader(reader&& other) noexcept
+        : mailbox(std::exchange(other.mailbox, nullptr))
+        , held(std::exchange(other.held, none))
+        , seen(other.seen) {}
+
+    reader& operator=(reader&& other) noexcept {
+      if (this != &other) {
+        detach();
+        mailbox = std::exchange(other.mailbox, nullptr);
+        held = std::exchange(other.held, none);
+        seen = other.seen;
+      }
+      return *this;
+    }
+
+    ~reader() {
+      detach();
+    }
+
+    // The newest published value, empty until the first publish. The reference stays valid until the next read() or
+    // the destruction of this reader.
+    const optional<T>& read() noexcept {
+      assert(mailbox != nullptr);
+      state_type state = mailbox->latest.load(std::memory_order_seq_cst);
+      if (held != none && publication(state) == seen) {
+        return mailbox->slots[held].value;
+      }
+      release();
+      for (;;) {
+        auto& candidate = mailbox->slots[buffer(state)].readers;
+        candidate.fetch_add(1, std::memory_order_seq_cst);
+        // The writer may have reused the buffer between the load and the increment; it cannot once the count is seen
+        state_type current = mailbox->latest.load(std::memory_order_seq_cst);
+        if (current == state) {
+          break;
+        }
+        candidate.fetch_sub(1, std::memory_order_release);
+        state = current;
+      }
+      held = buffer(state);
+      seen = publication(state);
+      return mailbox->slots[held].value;
+    }
+
+    // Whether read() would return a value published after the one it last returned
+    bool changed() const noexcept {
+      assert(mailbox != nullptr);
+      return held == none || publication(mailbox->latest.load(std::memory_order_acquire)) != seen;
+    }
+
+  private:
+    void release() noexcept {
+      if (held != none) {
+        mailbox->slots[held].readers.fetch_sub(1, std::memory_order_release);
+        held = none;
+      }
+    }
+
+    void detach() noexcept {
+      if (mailbox != nullptr) {
+        release();
+        mailbox->attached.fetch_sub(1, std::memory_order_relaxed);
+        mailbox = nullptr;
+      }
+    }
+
+    optional_mailbox* mailbox;
+    std::size_t held = none;
+    std::uint32_t seen = 0;
+  };
+
+  explicit optional_mailbox(std::size_t readers = 1)
+      : slots(std::make_unique<slot[]>(readers + 2))
+      , count(readers + 2) {}
+
+  optional_mailbox(const optional_mailbox&) = delete;
+  optional_mailbox& operator=(const optional_mailbox&) = delete;
+
+  ~optional_mailbox() {
+    assert(attached.load(std::memory_order_relaxed) == 0 && "a reader outlives its mailbox");
+  }
+
+  // A reader for the calling thread, or nullopt if all the readers the mailbox was built for are taken
+  optional<reader> make_reader() noexcept {
+    std::size_t current = attached.load(std::memory_order_relaxed);
+    do {
+      if (current == count - 2) {
+        return nullopt;
+      }
+    } while (!attached.compare_exchange_weak(current, current + 1, std::memory_order_relaxed));
+    return reader(*this);
+  }
+
+  // Writer side, for one thread at a time
+
+  // The buffer the next publish() hands out. No reader holds it; it keeps an older value, whose storage can be reused.
+  optional<T>& back() noexcept {
+    return slots[writing].value;
+  }
+
+  void publish() noexcept {
+    state_type previous = latest.exchange(
+        static_cast<state_type>(++publications) << 32 | writing,
+        std::memory_order_seq_cst
+    );
+    std::size_t published = writing;
+    // Only a read() in progress can make this take more than one pass: every reader holds one buffer at most
+    for (std::size_t i = buffer(previous);; i = (i + 1) % count) {
+      if (i != published && slots[i].readers.load(std::memory_order_seq_cst) == 0) {
+        writing = i;
+        return;
+      }
+    }
+  }
+
+  // Nothing is published if the constructor of T throws
+  template <typename... Args>
+  void emplace(Args&&... args) {
+    back().emplace(std::forward<Args>(args)...);
+    publish();
+  }
+
+  void reset() noexcept {
+    back().reset();
+    publish();
+  }
+
+private:
+  std::unique_ptr<slot[]> slots;
+  std::size_t count;
+  std::atomic<state_type> latest{0};
+  std::atomic<std::size_t> attached{0};
+  std::size_t writing = 1;
+  std::uint32_t publications = 0;
+};
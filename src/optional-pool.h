@@ -0,0 +1,202 @@
+#pragma once
+
+#include "optional.h"
+
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace detail {
+
+// Singly-linked list of free slot indices, threaded through the value storage of disengaged optionals
+template <typename T>
+class optional_free_list {
+public:
+  using size_type = std::uint32_t;
+
+  static_assert(sizeof(T) >= sizeof(size_type), "T is too small to hold a free-list link");
+
+  static constexpr size_type npos = std::numeric_limits<size_type>::max();
+
+  bool empty() const noexcept {
+    return head == npos;
+  }
+
+  void push(optional<T>* slots, size_type index) noexcept {
+    assert(!slots[index].has_value());
+    std::memcpy(optional_access::storage(slots[index]), &head, sizeof(head));
+    head = index;
+  }
+
+  size_type pop(const optional<T>* slots) noexcept {
+    assert(!empty());
+    size_type index = head;
+    std::memcpy(&head, optional_access::storage(slots[index]), sizeof(head));
+    return index;
+  }
+
+private:
+  size_type head = npos;
+};
+
+} // namespace detail
+
+// Fixed-capacity pool of optional<T> slots. Free slots link to each other through their value storage, so T must be at
+// least as large as a std::uint32_t index.
+template <typename T>
+class optional_pool {
+public:
+  using size_type = typename detail::optional_free_list<T>::size_type;
+
+  explicit optional_pool(size_type capacity)
+      : slots(std::make_unique<optional<T>[]>(capacity))
+      , cap(capacity) {
+    for (size_type i = capacity; i-- > 0;) {
+      free_list.push(slots.get(), i);
+    }
+  }
+
+  optional_pool(const optional_pool&) = delete;
+  optional_pool& operator=(const optional_pool&) = delete;
+
+  template <typename... Args>
+  optional<size_type> acquire(Args&&... args) {
+    if (free_list.empty()) {
+      return nullopt;
+    }
+    size_type index = free_list.pop(slots.get());
+    try {
+      slots[index].emplace(std::forward<Args>(args)...);
+    } catch (...) {
+      free_list.push(slots.get(), index);
+      throw;
+    }
+    ++count;
+    return index;
+  }
+
+  void release(size_type index) noexcept {
+    assert(index < cap && slots[index].has_value());
+    slots[index].reset();
+    free_list.push(slots.get(), index);
+    --count;
+  }
+
+  T& operator[](size_type index) noexcept {
+    assert(index < cap && slots[index].has_value());
+    return *slots[index];
+  }
+
+  const T& operator[](size_type index) const noexcept {
+    assert(index < cap && slots[index].has_value());
+    return *slots[index];
+  }
+
+  bool contains(size_type index) const noexcept {
+    return index < cap && slots[index].has_value();
+  }
+
+  size_type size() const noexcept {
+    return count;
+  }
+
+  size_type capacity() const noexcept {
+    return cap;
+  }
+
+  bool full() const noexcept {
+    return free_list.empty();
+  }
+
+private:
+  std::unique_ptr<optional<T>[]> slots;
+  size_type cap;
+  size_type count = 0;
+  detail::optional_free_list<T> free_list;
+};
+
+// Growable pool addressed by generational handles; T has the same minimum size as in optional_pool
+template <typename T>
+class optional_slot_map {
+public:
+  using size_type = typename detail::optional_free_list<T>::size_type;
+
+  struct handle {
+    size_type index;
+    size_type generation;
+
+    friend bool operator==(const handle&, const handle&) = default;
+  };
+
+  optional_slot_map() = default;
+
+  optional_slot_map(const optional_slot_map&) = delete;
+  optional_slot_map& operator=(const optional_slot_map&) = delete;
+
+  template <typename... Args>
+  handle insert(Args&&... args) {
+    if (free_list.empty()) {
+      // The generation goes first, so that a throwing constructor or allocation leaves both vectors the same size.
+      // Every slot is engaged here, so relocating them cannot lose free-list links.
+      generations.push_back(0);
+      try {
+        slots.emplace_back(in_place, std::forward<Args>(args)...);
+      } catch (...) {
+        generations.pop_back();
+        throw;
+      }
+      ++count;
+      return {static_cast<size_type>(slots.size() - 1), 0};
+    }
+    size_type index = free_list.pop(slots.data());
+    try {
+      slots[index].emplace(std::forward<Args>(args)...);
+    } catch (...) {
+      free_list.push(slots.data(), index);
+      throw;
+    }
+    ++count;
+    return {index, generations[index]};
+  }
+
+  bool erase(handle h) noexcept {
+    if (!contains(h)) {
+      return false;
+    }
+    slots[h.index].reset();
+    ++generations[h.index];
+    free_list.push(slots.data(), h.index);
+    --count;
+    return true;
+  }
+
+  bool contains(handle h) const noexcept {
+    return h.index < slots.size() && generations[h.index] == h.generation && slots[h.index].has_value();
+  }
+
+  T* get(handle h) noexcept {
+    return contains(h) ? std::addressof(*slots[h.index]) : nullptr;
+  }
+
+  const T* get(handle h) const noexcept {
+    return contains(h) ? std::addressof(*slots[h.index]) : nullptr;
+  }
+
+  size_type size() const noexcept {
+    return count;
+  }
+
+  bool empty() const noexcept {
+    return count == 0;
+  }
+
+private:
+  std::vector<optional<T>> slots;
+  std::vector<size_type> generations;
+  size_type count = 0;
+  detail::optional_free_list<T> free_list;
+};
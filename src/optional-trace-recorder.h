@@ -0,0 +1,133 @@
+#pragma once
+
+// Records the optional<T> operations of a program as a trace, through the instrumentation hooks; needs
+// OPTIONAL_INSTRUMENTATION=1.
+//
+// The hooks see less than a trace can express, so a recording is an approximation of the real workload:
+//  - has_value, comparisons and the end of an optional's lifetime are not observed;
+//  - an optional is first seen when an event happens to it. A copy or move into one that was never seen is recorded
+//    as a construction; before any other first event it is recorded as construct_empty;
+//  - a value constructed into an optional that is already known (assignment of a value to an empty optional, or a new
+//    optional at the address of one that has died unseen) is recorded as assign; assigning to an engaged value is
+//    not observed;
+//  - copies and moves of trivially copyable T are not observed at all.
+// Values are not observed either, and are recorded as 0.
+
+#include "optional.h"
+#include "optional-trace.h"
+
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <typeinfo>
+#include <unordered_map>
+
+static_assert(OPTIONAL_INSTRUMENTATION, "optional-trace-recorder.h needs OPTIONAL_INSTRUMENTATION=1");
+
+// Records the events of optional<T> from every thread while it exists. Only one sink can be installed at a time.
+// If recording an event fails, for lack of memory, the recorder stops and trace() throws the error.
+template <typename T>
+class optional_trace_recorder final : public optional_event_sink {
+public:
+  optional_trace_recorder() {
+    previous = optional_instrumentation::set_sink(this);
+  }
+
+  optional_trace_recorder(const optional_trace_recorder&) = delete;
+  optional_trace_recorder& operator=(const optional_trace_recorder&) = delete;
+
+  ~optional_trace_recorder() {
+    optional_instrumentation::set_sink(previous);
+  }
+
+  void on_event(
+      const std::type_info& type,
+      optional_event event,
+      const void* self,
+      const void* other
+  ) noexcept override {
+    if (type != typeid(T)) {
+      return;
+    }
+    std::lock_guard lock(mutex);
+    if (error) {
+      return;
+    }
+    try {
+      record(event, self, other);
+    } catch (...) {
+      error = std::current_exception();
+    }
+  }
+
+  // The trace so far, with every optional that was seen still live at its end
+  optional_trace trace() const {
+    std::lock_guard lock(mutex);
+    if (error) {
+      std::rethrow_exception(error);
+    }
+    return recorded;
+  }
+
+private:
+  void record(optional_event event, const void* self, const void* other) {
+    switch (event) {
+    case optional_event::construct:
+      if (auto known = slots.find(self); known != slots.end()) {
+        add(trace_op::assign, known->second);
+      } else {
+        add(trace_op::construct, new_slot(self));
+      }
+      break;
+    case optional_event::copy:
+    case optional_event::move:
+      record_copy(event == optional_event::copy, self, other);
+      break;
+    case optional_event::emplace:
+      add(trace_op::emplace, slot(self));
+      break;
+    case optional_event::reset:
+      add(trace_op::reset, slot(self));
+      break;
+    case optional_event::swap:
+      add(trace_op::swap, slot(self), slot(other));
+      break;
+    case optional_event::empty_dereference:
+      break;
+    }
+  }
+
+  void add(trace_op op, std::uint32_t slot, std::uint64_t operand = 0) {
+    recorded.records.push_back({op, slot, operand});
+  }
+
+  std::uint32_t new_slot(const void* address) {
+    std::uint32_t index = recorded.slots++;
+    slots.emplace(address, index);
+    return index;
+  }
+
+  std::uint32_t slot(const void* address) {
+    if (auto known = slots.find(address); known != slots.end()) {
+      return known->second;
+    }
+    std::uint32_t index = new_slot(address);
+    add(trace_op::construct_empty, index);
+    return index;
+  }
+
+  void record_copy(bool copy, const void* self, const void* other) {
+    std::uint32_t source = slot(other);
+    if (auto known = slots.find(self); known != slots.end()) {
+      add(copy ? trace_op::copy_assign : trace_op::move_assign, known->second, source);
+    } else {
+      add(copy ? trace_op::copy_construct : trace_op::move_construct, new_slot(self), source);
+    }
+  }
+
+  optional_event_sink* previous = nullptr;
+  mutable std::mutex mutex;
+  std::exception_ptr error;
+  std::unordered_map<const void*, std::uint32_t> slots;
+  optional_trace recorded;
+};
@@ -0,0 +1,439 @@
+#pragma once
+
+// Recorded sequences of optional operations, and a driver that replays them against any optional-like template.
+//
+// Text format: a header line, then one operation per line.
+//
+//   optional-trace 1 <slots>
+//   <operation> <slot> [<operand>]
+//
+// Slots are numbered from 0 and each holds at most one live optional. The operand is another slot for the operations
+// between two optionals, and a value for construct, assign and emplace. Values are abstract: the replayer maps them
+// to T, so one trace can be replayed for any T.
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <memory>
+#include <new>
+#include <ostream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+enum class trace_op : unsigned char {
+  construct,       // slot = optional(value)
+  construct_empty, // slot = optional()
+  copy_construct,  // slot = optional(other)
+  move_construct,  // slot = optional(std::move(other))
+  destroy,         // slot ends its lifetime
+  assign,          // slot = value
+  copy_assign,     // slot = other
+  move_assign,     // slot = std::move(other)
+  emplace,         // slot.emplace(value)
+  reset,           // slot.reset()
+  swap,            // slot.swap(other)
+  has_value,       // slot.has_value()
+  compare,         // slot == other
+};
+
+inline constexpr std::size_t trace_op_count = 13;
+
+inline const char* to_string(trace_op op) noexcept {
+  constexpr std::array<const char*, trace_op_count> names = {
+      "construct",   "construct_empty", "copy_construct", "move_construct", "destroy",   "assign",  "copy_assign",
+      "move_assign", "emplace",         "reset",          "swap",           "has_value", "compare",
+  };
+  return names[static_cast<std::size_t>(op)];
+}
+
+// Whether the operand of op is a slot rather than a value
+constexpr bool is_binary(trace_op op) noexcept {
+  switch (op) {
+  case trace_op::copy_construct:
+  case trace_op::move_construct:
+  case trace_op::copy_assign:
+  case trace_op::move_assign:
+  case trace_op::swap:
+  case trace_op::compare:
+    return true;
+  default:
+    return false;
+  }
+}
+
+constexpr bool has_operand(trace_op op) noexcept {
+  return is_binary(op) || op == trace_op::construct || op == trace_op::assign || op == trace_op::emplace;
+}
+
+constexpr bool is_construction(trace_op op) noexcept {
+  return op == trace_op::construct || op == trace_op::construct_empty || op == trace_op::copy_construct ||
+         op == trace_op::move_construct;
+}
+
+struct trace_record {
+  trace_op op;
+  std::uint32_t slot;
+  std::uint64_t operand = 0;
+
+  friend bool operator==(const trace_record&, const trace_record&) = default;
+};
+
+struct optional_trace {
+  std::uint32_t slots = 0;
+  std::vector<trace_record> records;
+};
+
+class trace_error : public std::runtime_error {
+public:
+  using std::runtime_error::runtime_error;
+};
+
+namespace detail {
+
+// Throws unless every operation finds its slots in the state it needs: constructions need a free slot, everything
+// else live ones
+inline void validate_trace(const optional_trace& trace) {
+  std::vector<bool> live(trace.slots);
+  for (std::size_t i = 0; i < trace.records.size(); ++i) {
+    const trace_record& record = trace.records[i];
+    auto fail = [&](const char* what) {
+      throw trace_error("operation " + std::to_string(i) + " (" + to_string(record.op) + "): " + what);
+    };
+    if (record.slot >= trace.slots || (is_binary(record.op) && record.operand >= trace.slots)) {
+      fail("slot out of range");
+    }
+    if (is_binary(record.op) && !live[record.operand]) {
+      fail("operand slot is not live");
+    }
+    if (is_construction(record.op)) {
+      if (live[record.slot]) {
+        fail("slot is already live");
+      }
+      live[record.slot] = true;
+    } else if (!live[record.slot]) {
+      fail("slot is not live");
+    } else if (record.op == trace_op::destroy) {
+      live[record.slot] = false;
+    }
+  }
+}
+
+} // namespace detail
+
+inline void write_trace(std::ostream& out, const optional_trace& trace) {
+  out << "optional-trace 1 " << trace.slots << '\n';
+  for (const trace_record& record : trace.records) {
+    out << to_string(record.op) << ' ' << record.slot;
+    if (has_operand(record.op)) {
+      out << ' ' << record.operand;
+    }
+    out << '\n';
+  }
+}
+
+// Throws trace_error on a malformed trace, or one whose operations do not fit the lifetimes of their slots
+inline optional_trace read_trace(std::istream& in) {
+  optional_trace trace;
+  std::string magic;
+  int version = 0;
+  if (!(in >> magic >> version >> trace.slots) || magic != "optional-trace" || version != 1) {
+    throw trace_error("not an optional-trace version 1 header");
+  }
+
+  std::string line;
+  std::getline(in, line);
+  while (std::getline(in, line)) {
+    if (line.empty() || line[0] == '#') {
+      continue;
+    }
+    std::istringstream fields(line);
+    std::string name;
+    trace_record record{};
+    fields >> name >> record.slot;
+
+    std::size_t op = 0;
+    while (op < trace_op_count && name != to_string(static_cast<trace_op>(op))) {
+      ++op;
+    }
+    if (op == trace_op_count || fields.fail()) {
+      throw trace_error("malformed line: " + line);
+    }
+    record.op = static_cast<trace_op>(op);
+    if (has_operand(record.op) && !(fields >> record.operand)) {
+      throw trace_error("missing operand: " + line);
+    }
+    trace.records.push_back(record);
+  }
+
+  detail::validate_trace(trace);
+  return trace;
+}
+
+struct trace_config {
+  std::size_t operations = 100'000;
+  std::uint32_t slots = 64;
+  // Chance that an operation which stores something stores a value rather than nothing
+  double engaged_ratio = 0.5;
+  // Number of distinct values; equal values make some comparisons succeed
+  std::uint64_t values = 64;
+  std::uint64_t seed = 1;
+  // Relative frequencies, indexed by trace_op
+  std::array<double, trace_op_count> weights = {
+      4,  // construct
+      2,  // construct_empty
+      2,  // copy_construct
+      2,  // move_construct
+      4,  // destroy
+      8,  // assign
+      6,  // copy_assign
+      4,  // move_assign
+      4,  // emplace
+      4,  // reset
+      4,  // swap
+      30, // has_value
+      10, // compare
+  };
+};
+
+// Random trace with the operation mix of config. A free slot is always filled by one of the constructions; a live
+// slot gets any other operation.
+inline optional_trace generate_trace(const trace_config& config) {
+  if (config.slots < 2 || config.values == 0) {
+    throw trace_error("a trace needs at least two slots and one value");
+  }
+
+  std::mt19937_64 rng(config.seed);
+  auto weights_of = [&](bool constructions) {
+    std::array<double, trace_op_count> weights{};
+    for (std::size_t i = 0; i < trace_op_count; ++i) {
+      if (is_construction(static_cast<trace_op>(i)) == constructions) {
+        weights[i] = config.weights[i];
+      }
+    }
+    return std::discrete_distribution<std::size_t>(weights.begin(), weights.end());
+  };
+  auto construction = weights_of(true);
+  auto operation = weights_of(false);
+  std::bernoulli_distribution engaged(config.engaged_ratio);
+  std::uniform_int_distribution<std::uint32_t> pick_slot(0, config.slots - 1);
+  std::uniform_int_distribution<std::uint64_t> pick_value(0, config.values - 1);
+
+  optional_trace trace;
+  trace.slots = config.slots;
+  trace.records.reserve(config.operations);
+  std::vector<bool> live(config.slots);
+  std::uint32_t live_count = 0;
+
+  // Some other live slot, or slot itself if there is none
+  auto other_live = [&](std::uint32_t slot) {
+    if (live_count == (live[slot] ? 1 : 0)) {
+      return slot;
+    }
+    for (;;) {
+      std::uint32_t other = pick_slot(rng);
+      if (other != slot && live[other]) {
+        return other;
+      }
+    }
+  };
+
+  while (trace.records.size() < config.operations) {
+    std::uint32_t slot = pick_slot(rng);
+    trace_record record{trace_op::construct, slot};
+    if (!live[slot]) {
+      record.op = static_cast<trace_op>(construction(rng));
+      if (record.op == trace_op::construct && !engaged(rng)) {
+        record.op = trace_op::construct_empty;
+      }
+      if (is_binary(record.op)) {
+        record.operand = other_live(slot);
+        if (record.operand == slot) {
+          record.op = trace_op::construct_empty;
+        }
+      }
+      live[slot] = true;
+      ++live_count;
+    } else {
+      record.op = static_cast<trace_op>(operation(rng));
+      if (record.op == trace_op::assign && !engaged(rng)) {
+        record.op = trace_op::reset;
+      }
+      if (is_binary(record.op)) {
+        record.operand = other_live(slot);
+        if (record.operand == slot && record.op != trace_op::copy_assign && record.op != trace_op::compare) {
+          record.op = trace_op::has_value;
+        }
+      }
+      if (record.op == trace_op::destroy) {
+        live[slot] = false;
+        --live_count;
+      }
+    }
+    if (!is_binary(record.op) && has_operand(record.op)) {
+      record.operand = pick_value(rng);
+    }
+    trace.records.push_back(record);
+  }
+  return trace;
+}
+
+// T for each abstract value of a trace: the value itself for arithmetic T and T constructible from int, and a string
+// long enough to live on the heap for string-like T
+template <typename T>
+T make_trace_value(std::uint64_t value) {
+  if constexpr (std::is_arithmetic_v<T>) {
+    return static_cast<T>(value);
+  } else if constexpr (std::is_constructible_v<T, int>) {
+    return T(static_cast<int>(value));
+  } else {
+    static_assert(std::is_constructible_v<T, std::string>, "make_trace_value supports numeric and string types");
+    return T("value " + std::to_string(value) + " padded past the small buffer");
+  }
+}
+
+// Executes a trace against Optional, which is optional<T> or anything with the same interface, such as
+// std::optional<T>. Values are made up front, so a replay measures only the optional operations.
+//
+// The replayer refers to the trace rather than copying it, so the trace must outlive it.
+template <typename Optional>
+class trace_replayer {
+public:
+  using value_type = typename Optional::value_type;
+
+  // The trace must be valid, as read_trace and generate_trace guarantee
+  explicit trace_replayer(const optional_trace& trace)
+      : trace(trace)
+      , slots(std::make_unique<slot_storage[]>(trace.slots))
+      , live(std::make_unique<bool[]>(trace.slots)) {
+    std::uint64_t max_value = 0;
+    for (const trace_record& record : trace.records) {
+      if (!is_binary(record.op) && has_operand(record.op)) {
+        max_value = std::max(max_value, record.operand);
+      }
+    }
+    values.reserve(max_value + 1);
+    for (std::uint64_t value = 0; value <= max_value; ++value) {
+      values.push_back(make_trace_value<value_type>(value));
+    }
+  }
+
+  // A temporary trace would be gone before run()
+  explicit trace_replayer(optional_trace&&) = delete;
+
+  trace_replayer(const trace_replayer&) = delete;
+  trace_replayer& operator=(const trace_replayer&) = delete;
+
+  // Destroys the slots left live by a replay that threw or was never finished
+  ~trace_replayer() {
+    destroy_live();
+  }
+
+  // Replays the whole trace and destroys whatever is still live. Returns a checksum of everything that was observed
+  // (has_value and compare results, and the final state), which is the same for every correct Optional.
+  std::uint64_t run() {
+    destroy_live();
+    std::uint64_t checksum = 0;
+    for (const trace_record& record : trace.records) {
+      checksum = checksum * 31 + step(record);
+    }
+    for (std::uint32_t slot = 0; slot < trace.slots; ++slot) {
+      if (live[slot]) {
+        checksum = checksum * 31 + at(slot).has_value();
+      }
+    }
+    destroy_live();
+    return checksum;
+  }
+
+private:
+  struct slot_storage {
+    alignas(Optional) std::byte bytes[sizeof(Optional)];
+  };
+
+  Optional& at(std::uint64_t slot) noexcept {
+    return *std::launder(reinterpret_cast<Optional*>(slots[slot].bytes));
+  }
+
+  void* raw(std::uint32_t slot) noexcept {
+    return slots[slot].bytes;
+  }
+
+  template <typename... Args>
+  void construct(std::uint32_t slot, Args&&... args) {
+    ::new (raw(slot)) Optional(std::forward<Args>(args)...);
+    live[slot] = true;
+  }
+
+  void destroy(std::uint32_t slot) noexcept {
+    live[slot] = false;
+    std::destroy_at(&at(slot));
+  }
+
+  void destroy_live() noexcept {
+    for (std::uint32_t slot = 0; slot < trace.slots; ++slot) {
+      if (live[slot]) {
+        destroy(slot);
+      }
+    }
+  }
+
+  const value_type& value(std::uint64_t value) const noexcept {
+    return values[value];
+  }
+
+  std::uint64_t step(const trace_record& record) {
+    switch (record.op) {
+    case trace_op::construct:
+      construct(record.slot, value(record.operand));
+      return 0;
+    case trace_op::construct_empty:
+      construct(record.slot);
+      return 0;
+    case trace_op::copy_construct:
+      construct(record.slot, std::as_const(at(record.operand)));
+      return 0;
+    case trace_op::move_construct:
+      construct(record.slot, std::move(at(record.operand)));
+      return 0;
+    case trace_op::destroy:
+      destroy(record.slot);
+      return 0;
+    case trace_op::assign:
+      at(record.slot) = value(record.operand);
+      return 0;
+    case trace_op::copy_assign:
+      at(record.slot) = std::as_const(at(record.operand));
+      return 0;
+    case trace_op::move_assign:
+      at(record.slot) = std::move(at(record.operand));
+      return 0;
+    case trace_op::emplace:
+      at(record.slot).emplace(value(record.operand));
+      return 0;
+    case trace_op::reset:
+      at(record.slot).reset();
+      return 0;
+    case trace_op::swap:
+      at(record.slot).swap(at(record.operand));
+      return 0;
+    case trace_op::has_value:
+      return at(record.slot).has_value();
+    case trace_op::compare:
+      return at(record.slot) == at(record.operand);
+    }
+    return 0;
+  }
+
+  const optional_trace& trace;
+  std::unique_ptr<slot_storage[]> slots;
+  std::unique_ptr<bool[]> live;
+  std::vector<value_type> values;
+};
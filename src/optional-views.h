@@ -0,0 +1,345 @@
+#pragma once
+
+#include "optional-column.h"
+#include "optional.h"
+
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <ranges>
+#include <span>
+#include <type_traits>
+#include <utility>
+
+// Lazy views over ranges of optionals (optional, std::optional, or anything with operator bool and operator*):
+//
+//   values | views::engaged        the engaged optionals
+//   values | views::values         the values of the engaged optionals
+//   values | views::value_or(d)    every value, with d in place of the empty ones
+//
+// values and value_or applied directly to views::engaged fuse with it rather than stacking: engaged | values is a single
+// filter that unwraps what it keeps. A transform in between ends the fusion, since the standard transform_view does not
+// expose its function: engaged | transform(f) | values is still one lazy loop with no intermediate storage, but it
+// filters twice, once on the optionals and once on what f returns. When the range yields its optionals by value, as a
+// transform does, each one is computed once and kept in the iterator, which makes the view an input range. On an
+// optional_column, values is the span of its engaged values, skipping all the empty rows at once.
+
+namespace detail {
+
+template <typename V, bool Unwrap>
+class engaged_view : public std::ranges::view_interface<engaged_view<V, Unwrap>> {
+  using base_iterator = std::ranges::iterator_t<V>;
+  using base_sentinel = std::ranges::sentinel_t<V>;
+  using base_reference = std::ranges::range_reference_t<V>;
+
+  static constexpr bool caches = !std::is_reference_v<base_reference>;
+  using cached = std::remove_cv_t<base_reference>;
+
+public:
+  class iterator {
+    friend class engaged_view;
+
+    iterator(base_iterator current, base_sentinel end)
+        : current(std::move(current))
+        , end(std::move(end)) {
+      satisfy();
+    }
+
+  public:
+    using iterator_concept = std::conditional_t<
+        !caches && std::ranges::forward_range<V>,
+        std::forward_iterator_tag,
+        std::input_iterator_tag>;
+    using value_type = std::remove_cvref_t<
+        std::conditional_t<Unwrap, decltype(*std::declval<base_reference>()), base_reference>>;
+    using difference_type = std::ranges::range_difference_t<V>;
+
+    iterator() = default;
+
+    decltype(auto) operator*() const {
+      if constexpr (caches && Unwrap) {
+        return **cache;
+      } else if constexpr (caches) {
+        return *cache;
+      } else if constexpr (Unwrap) {
+        return **current;
+      } else {
+        return *current;
+      }
+    }
+
+    iterator& operator++() {
+      ++current;
+      satisfy();
+      return *this;
+    }
+
+    auto operator++(int) {
+      if constexpr (std::is_same_v<iterator_concept, std::forward_iterator_tag>) {
+        iterator result = *this;
+        ++*this;
+        return result;
+      } else {
+        ++*this;
+      }
+    }
+
+    friend bool operator==(const iterator& lhs, const iterator& rhs) {
+      return lhs.current == rhs.current;
+    }
+
+    friend bool operator==(const iterator& it, std::default_sentinel_t) {
+      return it.current == it.end;
+    }
+
+  private:
+    void satisfy() {
+      if constexpr (caches) {
+        for (; current != end; ++current) {
+          cache.emplace(*current);
+          if (static_cast<bool>(*cache)) {
+            return;
+          }
+        }
+        cache.reset();
+      } else {
+        while (current != end && !static_cast<bool>(*current)) {
+          ++current;
+        }
+      }
+    }
+
+    base_iterator current{};
+    base_sentinel end{};
+    // Only used when the range yields its optionals by value
+    mutable optional<std::conditional_t<caches, cached, char>> cache;
+  };
+
+  engaged_view() = default;
+
+  explicit engaged_view(V base)
+      : underlying(std::move(base)) {}
+
+  V base() const& {
+    return underlying;
+  }
+
+  V base() && {
+    return std::move(underlying);
+  }
+
+  // Like filter_view, a forward view finds its first element once and keeps it, so that begin() is amortized constant
+  // time as a range requires. An element must not become empty after that, or begin() would still return it.
+  iterator begin() {
+    if constexpr (std::is_same_v<typename iterator::iterator_concept, std::forward_iterator_tag>) {
+      if (!first.position) {
+        first.position.emplace(iterator(std::ranges::begin(underlying), std::ranges::end(underlying)));
+      }
+      return *first.position;
+    } else {
+      return iterator(std::ranges::begin(underlying), std::ranges::end(underlying));
+    }
+  }
+
+  std::default_sentinel_t end() const noexcept {
+    return std::default_sentinel;
+  }
+
+private:
+  // Copies and moves of the view start without it: the iterator may point into the source's own storage
+  struct begin_cache {
+    begin_cache() = default;
+
+    begin_cache(const begin_cache&) noexcept {}
+
+    begin_cache& operator=(const begin_cache&) noexcept {
+      position.reset();
+      return *this;
+    }
+
+    optional<iterator> position;
+  };
+
+  V underlying;
+  begin_cache first;
+};
+
+template <typename T, typename D>
+class column_value_or_view : public std::ranges::view_interface<column_value_or_view<T, D>> {
+public:
+  class iterator {
+    friend class column_value_or_view;
+
+    iterator(const column_value_or_view* view, std::size_t row, const T* next) noexcept
+        : view(view)
+        , row(row)
+        , next(next) {}
+
+  public:
+    using iterator_concept = std::forward_iterator_tag;
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = T;
+    using difference_type = std::ptrdiff_t;
+
+    iterator() = default;
+
+    T operator*() const {
+      return view->column->has_value(row) ? *next : static_cast<T>(view->default_value);
+    }
+
+    iterator& operator++() noexcept {
+      next += view->column->has_value(row);
+      ++row;
+      return *this;
+    }
+
+    iterator operator++(int) noexcept {
+      iterator result = *this;
+      ++*this;
+      return result;
+    }
+
+    friend bool operator==(const iterator& lhs, const iterator& rhs) noexcept {
+      return lhs.row == rhs.row;
+    }
+
+  private:
+    const column_value_or_view* view = nullptr;
+    std::size_t row = 0;
+    const T* next = nullptr;
+  };
+
+  column_value_or_view() = default;
+
+  column_value_or_view(const optional_column<T>& column, D default_value)
+      : column(std::addressof(column))
+      , default_value(std::move(default_value)) {}
+
+  iterator begin() const noexcept {
+    return iterator(this, 0, column->engaged_values().data());
+  }
+
+  iterator end() const noexcept {
+    return iterator(this, column->size(), column->engaged_values().data() + column->count());
+  }
+
+  std::size_t size() const noexcept {
+    return column->size();
+  }
+
+private:
+  const optional_column<T>* column = nullptr;
+  D default_value;
+};
+
+template <typename R>
+inline constexpr bool is_engaged_view_v = false;
+
+// Only views::engaged: a values view yields the values themselves, which may be optionals again
+template <typename V>
+inline constexpr bool is_engaged_view_v<engaged_view<V, false>> = true;
+
+template <typename R>
+inline constexpr bool is_optional_column_v = false;
+
+template <typename T>
+inline constexpr bool is_optional_column_v<optional_column<T>> = true;
+
+template <typename R>
+using engaged_view_for = engaged_view<std::views::all_t<R>, false>;
+
+template <typename R>
+using values_view_for = engaged_view<std::views::all_t<R>, true>;
+
+// Unwrapping an engaged view keeps its filter and drops the repeated check
+template <typename R>
+auto unwrap_engaged(R&& range) {
+  using view = std::remove_cvref_t<R>;
+  if constexpr (is_engaged_view_v<view>) {
+    return engaged_view<decltype(std::forward<R>(range).base()), true>(std::forward<R>(range).base());
+  } else {
+    return values_view_for<R>(std::views::all(std::forward<R>(range)));
+  }
+}
+
+struct engaged_fn {
+  template <typename R>
+  auto operator()(R&& range) const {
+    if constexpr (is_engaged_view_v<std::remove_cvref_t<R>>) {
+      return std::views::all(std::forward<R>(range));
+    } else {
+      return engaged_view_for<R>(std::views::all(std::forward<R>(range)));
+    }
+  }
+
+  template <typename R, std::enable_if_t<std::ranges::viewable_range<R>, int> = 0>
+  friend auto operator|(R&& range, const engaged_fn& self) {
+    return self(std::forward<R>(range));
+  }
+};
+
+struct values_fn {
+  template <typename R>
+  auto operator()(R&& range) const {
+    if constexpr (is_optional_column_v<std::remove_cvref_t<R>>) {
+      static_assert(std::is_lvalue_reference_v<R>, "the view would outlive the column");
+      return range.engaged_values();
+    } else {
+      return unwrap_engaged(std::forward<R>(range));
+    }
+  }
+
+  template <
+      typename R,
+      std::enable_if_t<std::ranges::viewable_range<R> || is_optional_column_v<std::remove_cvref_t<R>>, int> = 0>
+  friend auto operator|(R&& range, const values_fn& self) {
+    return self(std::forward<R>(range));
+  }
+};
+
+template <typename D>
+struct value_or_closure {
+  D default_value;
+
+  template <typename R>
+  auto operator()(R&& range) const {
+    using view = std::remove_cvref_t<R>;
+    if constexpr (is_optional_column_v<view>) {
+      static_assert(std::is_lvalue_reference_v<R>, "the view would outlive the column");
+      return column_value_or_view<typename view::value_type, D>(range, default_value);
+    } else if constexpr (is_engaged_view_v<view>) {
+      // Nothing left to substitute
+      return unwrap_engaged(std::forward<R>(range));
+    } else {
+      return std::views::transform(std::forward<R>(range), [default_value = default_value](auto&& element) {
+        using value = std::remove_cvref_t<decltype(*element)>;
+        return static_cast<bool>(element) ? static_cast<value>(*std::forward<decltype(element)>(element))
+                                          : static_cast<value>(default_value);
+      });
+    }
+  }
+
+  template <
+      typename R,
+      std::enable_if_t<std::ranges::viewable_range<R> || is_optional_column_v<std::remove_cvref_t<R>>, int> = 0>
+  friend auto operator|(R&& range, const value_or_closure& self) {
+    return self(std::forward<R>(range));
+  }
+};
+
+struct value_or_fn {
+  template <typename D>
+  value_or_closure<std::decay_t<D>> operator()(D&& default_value) const {
+    return {std::forward<D>(default_value)};
+  }
+};
+
+} // namespace detail
+
+namespace views {
+
+inline constexpr detail::engaged_fn engaged;
+inline constexpr detail::values_fn values;
+inline constexpr detail::value_or_fn value_or;
+
+} // namespace views
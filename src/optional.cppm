@@ -0,0 +1,29 @@
+// Named module exporting the declarations of optional.h. They stay attached to the global module, so a program may
+// mix TUs that import the module with TUs that include the header: both see the very same entities.
+//
+// Experimental: this interface has not been built by any compiler the project is tested with. GCC 12 compiles it but
+// does not make the exported using-declarations visible to importers, and CMake only supports module file sets from
+// 3.28. Use optional.h unless you are checking the module on a newer toolchain.
+
+module;
+
+#include "optional.h"
+
+export module optional;
+
+export using ::bad_optional_access;
+export using ::in_place;
+export using ::in_place_t;
+export using ::nullopt;
+export using ::nullopt_t;
+export using ::optional;
+
+export using ::swap;
+
+export using ::operator==;
+export using ::operator!=;
+export using ::operator<;
+export using ::operator<=;
+export using ::operator>;
+export using ::operator>=;
+export using ::operator<=>;
@@ -1,75 +1,958 @@
 #pragma once
 
 #include <compare>
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
 
-struct nullopt_t;
+#ifndef OPTIONAL_INSTRUMENTATION
+#define OPTIONAL_INSTRUMENTATION 0
+#endif
 
-struct in_place_t;
+#if OPTIONAL_INSTRUMENTATION
+#include "optional-instrumentation.h"
+
+namespace detail {
 
 template <typename T>
-class optional {
+constexpr void optional_count(optional_event event, const void* self, const void* other) noexcept {
+  if (!std::is_constant_evaluated()) {
+    optional_instrumentation::record<T>(event, self, other);
+  }
+}
+
+} // namespace detail
+
+// self is the optional the event happens to, other the one it copies, moves or swaps with
+#define OPTIONAL_COUNT_ON(T, event, self, other) ::detail::optional_count<T>(optional_event::event, self, other)
+#define OPTIONAL_COUNT(T, event) OPTIONAL_COUNT_ON(T, event, this, nullptr)
+#define OPTIONAL_COUNT_FROM(T, event, other) OPTIONAL_COUNT_ON(T, event, this, std::addressof(other))
+#define OPTIONAL_COUNT_IF(condition, T, event) ((condition) ? OPTIONAL_COUNT(T, event) : static_cast<void>(0))
+#else
+// Expand to nothing, so that a default build carries no trace of the instrumentation
+#define OPTIONAL_COUNT_ON(T, event, self, other) static_cast<void>(0)
+#define OPTIONAL_COUNT(T, event) static_cast<void>(0)
+#define OPTIONAL_COUNT_FROM(T, event, other) static_cast<void>(0)
+#define OPTIONAL_COUNT_IF(condition, T, event) static_cast<void>(0)
+#endif
+
+struct nullopt_t {
+  struct tag_t {};
+
+  explicit constexpr nullopt_t(tag_t) noexcept {}
+};
+
+inline constexpr nullopt_t nullopt{nullopt_t::tag_t{}};
+
+struct in_place_t {
+  explicit in_place_t() = default;
+};
+
+inline constexpr in_place_t in_place{};
+
+class bad_optional_access : public std::exception {
 public:
-  using value_type = T;
+  const char* what() const noexcept override {
+    return "bad optional access";
+  }
+};
+
+#if defined(__GNUC__)
+#define OPTIONAL_COLD_NOINLINE __attribute__((cold, noinline))
+#elif defined(_MSC_VER)
+#define OPTIONAL_COLD_NOINLINE __declspec(noinline)
+#else
+#define OPTIONAL_COLD_NOINLINE
+#endif
+
+template <typename T>
+class optional;
+
+namespace detail {
+
+struct optional_access;
+
+// Out of line and in the cold section, so that value() inlines to a test and a rarely taken branch to this call, and
+// the code that builds and throws the exception stays out of the hot loops that call it
+[[noreturn]] OPTIONAL_COLD_NOINLINE inline void throw_bad_optional_access() {
+  throw bad_optional_access();
+}
+
+template <typename T, bool = std::is_trivially_destructible_v<T>>
+struct optional_storage {
+  constexpr optional_storage() noexcept
+      : dummy() {}
+
+  template <typename... Args>
+  constexpr explicit optional_storage(in_place_t, Args&&... args)
+      : payload(std::forward<Args>(args)...)
+      , engaged(true) {}
+
+  optional_storage(const optional_storage&) = default;
+  optional_storage(optional_storage&&) = default;
+  optional_storage& operator=(const optional_storage&) = default;
+  optional_storage& operator=(optional_storage&&) = default;
+
+  constexpr ~optional_storage() {
+    if (engaged) {
+      payload.~T();
+    }
+  }
 
-  constexpr optional() noexcept;
-  constexpr optional(nullopt_t) noexcept;
+  union {
+    char dummy;
+    T payload;
+  };
 
-  constexpr optional(const optional&);
-  constexpr optional(optional&&);
+  bool engaged = false;
+};
+
+template <typename T>
+struct optional_storage<T, true> {
+  constexpr optional_storage() noexcept
+      : dummy() {}
+
+  template <typename... Args>
+  constexpr explicit optional_storage(in_place_t, Args&&... args)
+      : payload(std::forward<Args>(args)...)
+      , engaged(true) {}
+
+  union {
+    char dummy;
+    T payload;
+  };
 
-  constexpr optional& operator=(const optional&);
-  constexpr optional& operator=(optional&&);
+  bool engaged = false;
+};
 
-  template <typename U = T>
-  constexpr optional(U&& value);
+template <typename T>
+struct optional_ops : optional_storage<T> {
+  using optional_storage<T>::optional_storage;
 
   template <typename... Args>
-  explicit constexpr optional(in_place_t, Args&&... args);
+  constexpr void construct(Args&&... args) {
+    std::construct_at(std::addressof(this->payload), std::forward<Args>(args)...);
+    this->engaged = true;
+  }
+
+  constexpr void destroy() noexcept {
+    if constexpr (std::is_trivially_destructible_v<T>) {
+      this->engaged = false;
+    } else if (this->engaged) {
+      this->engaged = false;
+      std::destroy_at(std::addressof(this->payload));
+    }
+  }
+
+  // The prvalue returned by f initializes the value directly, so T need not be movable
+  template <typename F>
+  constexpr void construct_with(F&& f) {
+    if constexpr (std::is_move_constructible_v<T>) {
+      // Placement new is not allowed during constant evaluation; a move there is unobservable
+      if (std::is_constant_evaluated()) {
+        construct(std::forward<F>(f)());
+        return;
+      }
+    }
+    ::new (const_cast<void*>(static_cast<const volatile void*>(std::addressof(this->payload))))
+        T(std::forward<F>(f)());
+    this->engaged = true;
+  }
+
+  template <typename Other>
+  constexpr void construct_from(Other&& other) {
+    if (other.engaged) {
+      construct(std::forward<Other>(other).payload);
+    }
+  }
+
+  template <typename Other>
+  constexpr void assign_from(Other&& other) {
+    if (this->engaged && other.engaged) {
+      this->payload = std::forward<Other>(other).payload;
+    } else if (other.engaged) {
+      construct(std::forward<Other>(other).payload);
+    } else {
+      destroy();
+    }
+  }
+};
+
+// Copy and move constructors are trivial exactly when T's are. All four combinations are spelled out, so that an
+// optional<T> instantiates a single constructor layer (and a single assignment layer below).
+template <
+    typename T,
+    bool = std::is_trivially_copy_constructible_v<T>,
+    bool = std::is_trivially_move_constructible_v<T>>
+struct optional_ctor_base : optional_ops<T> {
+  using optional_ops<T>::optional_ops;
+};
+
+template <typename T>
+struct optional_ctor_base<T, false, true> : optional_ops<T> {
+  using optional_ops<T>::optional_ops;
+
+  optional_ctor_base() = default;
+
+  constexpr optional_ctor_base(const optional_ctor_base& other) noexcept(std::is_nothrow_copy_constructible_v<T>)
+      : optional_ops<T>() {
+    OPTIONAL_COUNT_FROM(T, copy, other);
+    this->construct_from(other);
+  }
+
+  optional_ctor_base(optional_ctor_base&&) = default;
+  optional_ctor_base& operator=(const optional_ctor_base&) = default;
+  optional_ctor_base& operator=(optional_ctor_base&&) = default;
+};
+
+template <typename T>
+struct optional_ctor_base<T, true, false> : optional_ops<T> {
+  using optional_ops<T>::optional_ops;
+
+  optional_ctor_base() = default;
+  optional_ctor_base(const optional_ctor_base&) = default;
+
+  constexpr optional_ctor_base(optional_ctor_base&& other) noexcept(std::is_nothrow_move_constructible_v<T>)
+      : optional_ops<T>() {
+    OPTIONAL_COUNT_FROM(T, move, other);
+    this->construct_from(std::move(other));
+  }
+
+  optional_ctor_base& operator=(const optional_ctor_base&) = default;
+  optional_ctor_base& operator=(optional_ctor_base&&) = default;
+};
+
+template <typename T>
+struct optional_ctor_base<T, false, false> : optional_ops<T> {
+  using optional_ops<T>::optional_ops;
+
+  optional_ctor_base() = default;
+
+  constexpr optional_ctor_base(const optional_ctor_base& other) noexcept(std::is_nothrow_copy_constructible_v<T>)
+      : optional_ops<T>() {
+    OPTIONAL_COUNT_FROM(T, copy, other);
+    this->construct_from(other);
+  }
+
+  constexpr optional_ctor_base(optional_ctor_base&& other) noexcept(std::is_nothrow_move_constructible_v<T>)
+      : optional_ops<T>() {
+    OPTIONAL_COUNT_FROM(T, move, other);
+    this->construct_from(std::move(other));
+  }
+
+  optional_ctor_base& operator=(const optional_ctor_base&) = default;
+  optional_ctor_base& operator=(optional_ctor_base&&) = default;
+};
+
+template <typename T>
+inline constexpr bool is_trivially_copy_assignable_optional_v =
+    std::is_trivially_copy_constructible_v<T> && std::is_trivially_copy_assignable_v<T> &&
+    std::is_trivially_destructible_v<T>;
+
+template <typename T>
+inline constexpr bool is_trivially_move_assignable_optional_v =
+    std::is_trivially_move_constructible_v<T> && std::is_trivially_move_assignable_v<T> &&
+    std::is_trivially_destructible_v<T>;
+
+template <
+    typename T,
+    bool = is_trivially_copy_assignable_optional_v<T>,
+    bool = is_trivially_move_assignable_optional_v<T>>
+struct optional_assign_base : optional_ctor_base<T> {
+  using optional_ctor_base<T>::optional_ctor_base;
+};
+
+template <typename T>
+struct optional_assign_base<T, false, true> : optional_ctor_base<T> {
+  using optional_ctor_base<T>::optional_ctor_base;
+
+  optional_assign_base() = default;
+  optional_assign_base(const optional_assign_base&) = default;
+  optional_assign_base(optional_assign_base&&) = default;
+
+  constexpr optional_assign_base& operator=(const optional_assign_base& other
+  ) noexcept(std::is_nothrow_copy_constructible_v<T> && std::is_nothrow_copy_assignable_v<T>) {
+    OPTIONAL_COUNT_FROM(T, copy, other);
+    this->assign_from(other);
+    return *this;
+  }
+
+  optional_assign_base& operator=(optional_assign_base&&) = default;
+};
+
+template <typename T>
+struct optional_assign_base<T, true, false> : optional_ctor_base<T> {
+  using optional_ctor_base<T>::optional_ctor_base;
+
+  optional_assign_base() = default;
+  optional_assign_base(const optional_assign_base&) = default;
+  optional_assign_base(optional_assign_base&&) = default;
+  optional_assign_base& operator=(const optional_assign_base&) = default;
+
+  constexpr optional_assign_base& operator=(optional_assign_base&& other
+  ) noexcept(std::is_nothrow_move_constructible_v<T> && std::is_nothrow_move_assignable_v<T>) {
+    OPTIONAL_COUNT_FROM(T, move, other);
+    this->assign_from(std::move(other));
+    return *this;
+  }
+};
+
+template <typename T>
+struct optional_assign_base<T, false, false> : optional_ctor_base<T> {
+  using optional_ctor_base<T>::optional_ctor_base;
+
+  optional_assign_base() = default;
+  optional_assign_base(const optional_assign_base&) = default;
+  optional_assign_base(optional_assign_base&&) = default;
+
+  constexpr optional_assign_base& operator=(const optional_assign_base& other
+  ) noexcept(std::is_nothrow_copy_constructible_v<T> && std::is_nothrow_copy_assignable_v<T>) {
+    OPTIONAL_COUNT_FROM(T, copy, other);
+    this->assign_from(other);
+    return *this;
+  }
+
+  constexpr optional_assign_base& operator=(optional_assign_base&& other
+  ) noexcept(std::is_nothrow_move_constructible_v<T> && std::is_nothrow_move_assignable_v<T>) {
+    OPTIONAL_COUNT_FROM(T, move, other);
+    this->assign_from(std::move(other));
+    return *this;
+  }
+};
+
+template <bool Copy, bool Move>
+struct enable_ctors {};
+
+template <>
+struct enable_ctors<false, true> {
+  enable_ctors() = default;
+  enable_ctors(const enable_ctors&) = delete;
+  enable_ctors(enable_ctors&&) = default;
+  enable_ctors& operator=(const enable_ctors&) = default;
+  enable_ctors& operator=(enable_ctors&&) = default;
+};
+
+template <>
+struct enable_ctors<true, false> {
+  enable_ctors() = default;
+  enable_ctors(const enable_ctors&) = default;
+  enable_ctors(enable_ctors&&) = delete;
+  enable_ctors& operator=(const enable_ctors&) = default;
+  enable_ctors& operator=(enable_ctors&&) = default;
+};
+
+template <>
+struct enable_ctors<false, false> {
+  enable_ctors() = default;
+  enable_ctors(const enable_ctors&) = delete;
+  enable_ctors(enable_ctors&&) = delete;
+  enable_ctors& operator=(const enable_ctors&) = default;
+  enable_ctors& operator=(enable_ctors&&) = default;
+};
+
+template <bool Copy, bool Move>
+struct enable_assigns {};
+
+template <>
+struct enable_assigns<false, true> {
+  enable_assigns() = default;
+  enable_assigns(const enable_assigns&) = default;
+  enable_assigns(enable_assigns&&) = default;
+  enable_assigns& operator=(const enable_assigns&) = delete;
+  enable_assigns& operator=(enable_assigns&&) = default;
+};
+
+template <>
+struct enable_assigns<true, false> {
+  enable_assigns() = default;
+  enable_assigns(const enable_assigns&) = default;
+  enable_assigns(enable_assigns&&) = default;
+  enable_assigns& operator=(const enable_assigns&) = default;
+  enable_assigns& operator=(enable_assigns&&) = delete;
+};
+
+template <>
+struct enable_assigns<false, false> {
+  enable_assigns() = default;
+  enable_assigns(const enable_assigns&) = default;
+  enable_assigns(enable_assigns&&) = default;
+  enable_assigns& operator=(const enable_assigns&) = delete;
+  enable_assigns& operator=(enable_assigns&&) = delete;
+};
 
-  constexpr optional& operator=(nullopt_t) noexcept;
+template <typename T>
+using optional_enable_ctors = enable_ctors<std::is_copy_constructible_v<T>, std::is_move_constructible_v<T>>;
+
+template <typename T>
+using optional_enable_assigns = enable_assigns<
+    std::is_copy_constructible_v<T> && std::is_copy_assignable_v<T>,
+    std::is_move_constructible_v<T> && std::is_move_assignable_v<T>>;
+
+template <typename T>
+std::true_type is_optional_test(const optional<T>*);
+std::false_type is_optional_test(const void*);
+
+// Also true for classes derived from optional, which are treated as optionals rather than as values
+template <typename T>
+inline constexpr bool is_optional_v =
+    decltype(is_optional_test(static_cast<std::remove_cvref_t<T>*>(nullptr)))::value;
+
+template <typename T, typename U>
+inline constexpr bool is_optional_value_constructible_v =
+    std::is_constructible_v<T, U&&> && !std::is_same_v<std::remove_cvref_t<U>, in_place_t> &&
+    !std::is_same_v<std::remove_cvref_t<U>, optional<T>> &&
+    !(std::is_same_v<std::remove_cv_t<T>, bool> && is_optional_v<U>);
+
+// Whether T can be made from some optional<U> as a whole, in which case converting from optional<U> would be ambiguous
+template <typename T, typename U>
+inline constexpr bool converts_from_optional_v =
+    std::is_constructible_v<T, optional<U>&> || std::is_constructible_v<T, const optional<U>&> ||
+    std::is_constructible_v<T, optional<U>&&> || std::is_constructible_v<T, const optional<U>&&> ||
+    std::is_convertible_v<optional<U>&, T> || std::is_convertible_v<const optional<U>&, T> ||
+    std::is_convertible_v<optional<U>&&, T> || std::is_convertible_v<const optional<U>&&, T>;
+
+template <typename T, typename U>
+inline constexpr bool assigns_from_optional_v =
+    std::is_assignable_v<T&, optional<U>&> || std::is_assignable_v<T&, const optional<U>&> ||
+    std::is_assignable_v<T&, optional<U>&&> || std::is_assignable_v<T&, const optional<U>&&>;
+
+// Arg is const U& or U&&, depending on whether the source optional is copied or moved from
+template <typename T, typename U, typename Arg>
+inline constexpr bool is_optional_converting_constructible_v =
+    !std::is_same_v<T, U> && std::is_constructible_v<T, Arg> &&
+    (std::is_same_v<std::remove_cv_t<T>, bool> || !converts_from_optional_v<T, U>);
+
+template <typename T, typename U, typename Arg>
+inline constexpr bool is_optional_converting_assignable_v =
+    !std::is_same_v<T, U> && std::is_constructible_v<T, Arg> && std::is_assignable_v<T&, Arg> &&
+    !converts_from_optional_v<T, U> && !assigns_from_optional_v<T, U>;
+
+template <typename F>
+using optional_factory_result_t = decltype(std::declval<F>()());
+
+// A factory returning T itself is always usable, since its result is never moved
+template <typename T, typename F, typename = void>
+inline constexpr bool is_optional_factory_v = false;
+
+template <typename T, typename F>
+inline constexpr bool is_optional_factory_v<T, F, std::void_t<optional_factory_result_t<F>>> =
+    std::is_same_v<std::remove_cv_t<optional_factory_result_t<F>>, std::remove_cv_t<T>> ||
+    std::is_constructible_v<T, optional_factory_result_t<F>>;
+
+template <typename T, typename F>
+inline constexpr bool is_nothrow_optional_factory_v =
+    noexcept(std::declval<F>()()) &&
+    (std::is_same_v<std::remove_cv_t<optional_factory_result_t<F>>, std::remove_cv_t<T>> ||
+     std::is_nothrow_constructible_v<T, optional_factory_result_t<F>>);
+
+template <typename T, typename... Args>
+inline constexpr bool is_optional_assign_v = false;
+
+template <typename T, typename Arg>
+inline constexpr bool is_optional_assign_v<T, Arg> = std::is_assignable_v<T&, Arg>;
+
+template <typename T, typename... Args>
+inline constexpr bool is_nothrow_optional_assign_v = true;
+
+template <typename T, typename Arg>
+inline constexpr bool is_nothrow_optional_assign_v<T, Arg> =
+    !std::is_assignable_v<T&, Arg> || std::is_nothrow_assignable_v<T&, Arg>;
+
+template <typename T, typename U>
+inline constexpr bool is_optional_value_assignable_v =
+    !std::is_same_v<std::remove_cvref_t<U>, optional<T>> && std::is_constructible_v<T, U> &&
+    std::is_assignable_v<T&, U> && !(std::is_scalar_v<T> && std::is_same_v<T, std::decay_t<U>>);
+
+} // namespace detail
+
+template <typename T>
+class optional
+    : private detail::optional_assign_base<T>
+    , private detail::optional_enable_ctors<T>
+    , private detail::optional_enable_assigns<T> {
+  using base = detail::optional_assign_base<T>;
+
+  friend struct detail::optional_access;
+
+public:
+  using value_type = T;
+
+  constexpr optional() noexcept = default;
+
+  constexpr optional(nullopt_t) noexcept {}
+
+  constexpr optional(const optional&) = default;
+  constexpr optional(optional&&) = default;
+
+  constexpr optional& operator=(const optional&) = default;
+  constexpr optional& operator=(optional&&) = default;
+
+  template <
+      typename U = T,
+      std::enable_if_t<detail::is_optional_value_constructible_v<T, U>, int> = 0>
+  constexpr explicit(!std::is_convertible_v<U&&, T>) optional(U&& value
+  ) noexcept(std::is_nothrow_constructible_v<T, U&&>)
+      : base(in_place, std::forward<U>(value)) {
+    OPTIONAL_COUNT(T, construct);
+  }
+
+  // T is constructed directly from *other, without an intermediate U
+  template <typename U, std::enable_if_t<detail::is_optional_converting_constructible_v<T, U, const U&>, int> = 0>
+  constexpr explicit(!std::is_convertible_v<const U&, T>) optional(const optional<U>& other
+  ) noexcept(std::is_nothrow_constructible_v<T, const U&>) {
+    if (other.has_value()) {
+      OPTIONAL_COUNT(T, construct);
+      this->construct(*other);
+    }
+  }
+
+  template <typename U, std::enable_if_t<detail::is_optional_converting_constructible_v<T, U, U&&>, int> = 0>
+  constexpr explicit(!std::is_convertible_v<U&&, T>) optional(optional<U>&& other
+  ) noexcept(std::is_nothrow_constructible_v<T, U&&>) {
+    if (other.has_value()) {
+      OPTIONAL_COUNT(T, construct);
+      this->construct(*std::move(other));
+    }
+  }
+
+  template <typename... Args, std::enable_if_t<std::is_constructible_v<T, Args&&...>, int> = 0>
+  explicit constexpr optional(in_place_t, Args&&... args) noexcept(std::is_nothrow_constructible_v<T, Args&&...>)
+      : base(in_place, std::forward<Args>(args)...) {
+    OPTIONAL_COUNT(T, construct);
+  }
+
+  constexpr optional& operator=(nullopt_t) noexcept {
+    reset();
+    return *this;
+  }
+
+  template <typename U = T, std::enable_if_t<detail::is_optional_value_assignable_v<T, U>, int> = 0>
+  constexpr optional& operator=(U&& value
+  ) noexcept(std::is_nothrow_constructible_v<T, U&&> && std::is_nothrow_assignable_v<T&, U&&>) {
+    if (this->engaged) {
+      this->payload = std::forward<U>(value);
+    } else {
+      OPTIONAL_COUNT(T, construct);
+      this->construct(std::forward<U>(value));
+    }
+    return *this;
+  }
+
+  template <typename U, std::enable_if_t<detail::is_optional_converting_assignable_v<T, U, const U&>, int> = 0>
+  constexpr optional& operator=(const optional<U>& other
+  ) noexcept(std::is_nothrow_constructible_v<T, const U&> && std::is_nothrow_assignable_v<T&, const U&>) {
+    if (this->engaged && other.has_value()) {
+      this->payload = *other;
+    } else if (other.has_value()) {
+      OPTIONAL_COUNT(T, construct);
+      this->construct(*other);
+    } else {
+      this->destroy();
+    }
+    return *this;
+  }
+
+  template <typename U, std::enable_if_t<detail::is_optional_converting_assignable_v<T, U, U&&>, int> = 0>
+  constexpr optional& operator=(optional<U>&& other
+  ) noexcept(std::is_nothrow_constructible_v<T, U&&> && std::is_nothrow_assignable_v<T&, U&&>) {
+    if (this->engaged && other.has_value()) {
+      this->payload = *std::move(other);
+    } else if (other.has_value()) {
+      OPTIONAL_COUNT(T, construct);
+      this->construct(*std::move(other));
+    } else {
+      this->destroy();
+    }
+    return *this;
+  }
+
+  constexpr void swap(optional& other
+  ) noexcept(std::is_nothrow_move_constructible_v<T> && std::is_nothrow_swappable_v<T>) {
+    OPTIONAL_COUNT_FROM(T, swap, other);
+    if constexpr (std::is_arithmetic_v<T>) {
+      // ADL finds no user swap for arithmetic types, so exchanging whole objects is equivalent and branch-free
+      std::swap(static_cast<base&>(*this), static_cast<base&>(other));
+    } else if (this->engaged && other.engaged) {
+      using std::swap;
+      swap(this->payload, other.payload);
+    } else if (this->engaged) {
+      other.construct(std::move(this->payload));
+      this->destroy();
+    } else if (other.engaged) {
+      this->construct(std::move(other.payload));
+      other.destroy();
+    }
+  }
+
+  constexpr bool has_value() const noexcept {
+    return this->engaged;
+  }
+
+  constexpr explicit operator bool() const noexcept {
+    return this->engaged;
+  }
+
+  constexpr T& operator*() & noexcept {
+    OPTIONAL_COUNT_IF(!this->engaged, T, empty_dereference);
+    return this->payload;
+  }
+
+  constexpr const T& operator*() const& noexcept {
+    OPTIONAL_COUNT_IF(!this->engaged, T, empty_dereference);
+    return this->payload;
+  }
+
+  constexpr T&& operator*() && noexcept {
+    OPTIONAL_COUNT_IF(!this->engaged, T, empty_dereference);
+    return std::move(this->payload);
+  }
+
+  constexpr const T&& operator*() const&& noexcept {
+    OPTIONAL_COUNT_IF(!this->engaged, T, empty_dereference);
+    return std::move(this->payload);
+  }
+
+  // Checked access: throws bad_optional_access if *this is empty
+  constexpr T& value() & {
+    if (!this->engaged) [[unlikely]] {
+      detail::throw_bad_optional_access();
+    }
+    return this->payload;
+  }
 
-  template <typename U = T>
-  constexpr optional& operator=(U&& value);
+  constexpr const T& value() const& {
+    if (!this->engaged) [[unlikely]] {
+      detail::throw_bad_optional_access();
+    }
+    return this->payload;
+  }
 
-  friend constexpr void swap(optional& lhs, optional& rhs);
+  constexpr T&& value() && {
+    if (!this->engaged) [[unlikely]] {
+      detail::throw_bad_optional_access();
+    }
+    return std::move(this->payload);
+  }
 
-  constexpr bool has_value() const noexcept;
-  constexpr explicit operator bool() const noexcept;
+  constexpr const T&& value() const&& {
+    if (!this->engaged) [[unlikely]] {
+      detail::throw_bad_optional_access();
+    }
+    return std::move(this->payload);
+  }
 
-  constexpr T& operator*() & noexcept;
-  constexpr const T& operator*() const& noexcept;
-  constexpr T&& operator*() && noexcept;
-  constexpr const T&& operator*() const&& noexcept;
+  constexpr T* operator->() noexcept {
+    OPTIONAL_COUNT_IF(!this->engaged, T, empty_dereference);
+    return std::addressof(this->payload);
+  }
 
-  constexpr T* operator->() noexcept;
-  constexpr const T* operator->() const noexcept;
+  constexpr const T* operator->() const noexcept {
+    OPTIONAL_COUNT_IF(!this->engaged, T, empty_dereference);
+    return std::addressof(this->payload);
+  }
 
   template <typename... Args>
-  constexpr T& emplace(Args&&... args);
+  constexpr T& emplace(Args&&... args) noexcept(std::is_nothrow_constructible_v<T, Args&&...>) {
+    OPTIONAL_COUNT(T, emplace);
+    this->destroy();
+    this->construct(std::forward<Args>(args)...);
+    return this->payload;
+  }
 
-  constexpr void reset() noexcept;
+  // Assigns to the engaged value when T is assignable from the single argument, so that it keeps its resources (such
+  // as a string's buffer); otherwise behaves like emplace
+  template <typename... Args, std::enable_if_t<std::is_constructible_v<T, Args&&...>, int> = 0>
+  constexpr T& assign_or_emplace(Args&&... args) noexcept(
+      std::is_nothrow_constructible_v<T, Args&&...> && detail::is_nothrow_optional_assign_v<T, Args&&...>
+  ) {
+    if constexpr (detail::is_optional_assign_v<T, Args&&...>) {
+      if (this->engaged) {
+        this->payload = (std::forward<Args>(args), ...);
+        return this->payload;
+      }
+    }
+    return emplace(std::forward<Args>(args)...);
+  }
+
+  // Like emplace(f()), but the result of f is constructed in place, without a temporary and a move
+  template <typename F, std::enable_if_t<detail::is_optional_factory_v<T, F>, int> = 0>
+  constexpr T& emplace_with(F&& f) noexcept(detail::is_nothrow_optional_factory_v<T, F>) {
+    OPTIONAL_COUNT(T, emplace);
+    this->destroy();
+    this->construct_with(std::forward<F>(f));
+    return this->payload;
+  }
+
+  constexpr void reset() noexcept {
+    OPTIONAL_COUNT(T, reset);
+    this->destroy();
+  }
+
+  // Moves the value out and leaves *this empty
+  template <typename U = T, std::enable_if_t<std::is_move_constructible_v<U>, int> = 0>
+  constexpr optional take() noexcept(std::is_nothrow_move_constructible_v<T>) {
+    optional result;
+    if (this->engaged) {
+      OPTIONAL_COUNT_ON(T, move, std::addressof(result), this);
+      result.construct(std::move(this->payload));
+      reset();
+    }
+    return result;
+  }
+
+  // Stores value and returns what was stored before. An engaged optional is assigned to, reusing its value.
+  template <
+      typename U = T,
+      std::enable_if_t<std::is_move_constructible_v<T> && std::is_constructible_v<T, U&&>, int> = 0>
+  constexpr optional replace(U&& value) noexcept(
+      std::is_nothrow_move_constructible_v<T> && std::is_nothrow_constructible_v<T, U&&> &&
+      (!std::is_assignable_v<T&, U&&> || std::is_nothrow_assignable_v<T&, U&&>)
+  ) {
+    optional old;
+    if (this->engaged) {
+      OPTIONAL_COUNT_ON(T, move, std::addressof(old), this);
+      old.construct(std::move(this->payload));
+      if constexpr (std::is_assignable_v<T&, U&&>) {
+        this->payload = std::forward<U>(value);
+        return old;
+      } else {
+        this->destroy();
+      }
+    }
+    OPTIONAL_COUNT(T, construct);
+    this->construct(std::forward<U>(value));
+    return old;
+  }
+};
+
+namespace detail {
+
+struct optional_access {
+  // Bytes of the value storage; only meaningful to write to while the optional is disengaged
+  template <typename T>
+  static void* storage(optional<T>& opt) noexcept {
+    return std::addressof(opt.payload);
+  }
+
+  template <typename T>
+  static const void* storage(const optional<T>& opt) noexcept {
+    return std::addressof(opt.payload);
+  }
+
+  // Setting the flag without constructing or destroying the value is only valid for trivially copyable optionals
+  template <typename T>
+  static bool& engaged(optional<T>& opt) noexcept {
+    static_assert(std::is_trivially_copyable_v<optional<T>>);
+    return opt.engaged;
+  }
 };
 
+} // namespace detail
+
+template <typename T>
+constexpr std::enable_if_t<std::is_move_constructible_v<T> && std::is_swappable_v<T>> swap(
+    optional<T>& lhs,
+    optional<T>& rhs
+) noexcept(noexcept(lhs.swap(rhs))) {
+  lhs.swap(rhs);
+}
+
 template <typename T>
-constexpr bool operator==(const optional<T>& lhs, const optional<T>& rhs);
+std::enable_if_t<!(std::is_move_constructible_v<T> && std::is_swappable_v<T>)> swap(optional<T>&, optional<T>&) =
+    delete;
 
 template <typename T>
-constexpr bool operator!=(const optional<T>& lhs, const optional<T>& rhs);
+constexpr bool operator==(const optional<T>& lhs, const optional<T>& rhs) {
+  if (lhs.has_value() != rhs.has_value()) {
+    return false;
+  }
+  return !lhs.has_value() || *lhs == *rhs;
+}
 
 template <typename T>
-constexpr bool operator<(const optional<T>& lhs, const optional<T>& rhs);
+constexpr bool operator!=(const optional<T>& lhs, const optional<T>& rhs) {
+  if (lhs.has_value() != rhs.has_value()) {
+    return true;
+  }
+  return lhs.has_value() && *lhs != *rhs;
+}
 
 template <typename T>
-constexpr bool operator<=(const optional<T>& lhs, const optional<T>& rhs);
+constexpr bool operator<(const optional<T>& lhs, const optional<T>& rhs) {
+  if (!rhs.has_value()) {
+    return false;
+  }
+  return !lhs.has_value() || *lhs < *rhs;
+}
 
 template <typename T>
-constexpr bool operator>(const optional<T>& lhs, const optional<T>& rhs);
+constexpr bool operator<=(const optional<T>& lhs, const optional<T>& rhs) {
+  if (!lhs.has_value()) {
+    return true;
+  }
+  return rhs.has_value() && *lhs <= *rhs;
+}
 
 template <typename T>
-constexpr bool operator>=(const optional<T>& lhs, const optional<T>& rhs);
+constexpr bool operator>(const optional<T>& lhs, const optional<T>& rhs) {
+  if (!lhs.has_value()) {
+    return false;
+  }
+  return !rhs.has_value() || *lhs > *rhs;
+}
+
+template <typename T>
+constexpr bool operator>=(const optional<T>& lhs, const optional<T>& rhs) {
+  if (!rhs.has_value()) {
+    return true;
+  }
+  return lhs.has_value() && *lhs >= *rhs;
+}
 
 template <class T>
-constexpr std::compare_three_way_result_t<T> operator<=>(const optional<T>& lhs, const optional<T>& rhs);
+constexpr std::compare_three_way_result_t<T> operator<=>(const optional<T>& lhs, const optional<T>& rhs) {
+  if (lhs.has_value() && rhs.has_value()) {
+    return *lhs <=> *rhs;
+  }
+  return lhs.has_value() <=> rhs.has_value();
+}
+
+// Comparisons with nullopt; the reversed and != / < / ... forms are rewritten from these two
+
+template <typename T>
+constexpr bool operator==(const optional<T>& lhs, nullopt_t) noexcept {
+  return !lhs.has_value();
+}
+
+template <typename T>
+constexpr std::strong_ordering operator<=>(const optional<T>& lhs, nullopt_t) noexcept {
+  return lhs.has_value() <=> false;
+}
+
+namespace detail {
+
+template <typename R>
+using optional_comparison_result_t = std::enable_if_t<std::is_convertible_v<R, bool>, bool>;
+
+} // namespace detail
+
+// Comparisons with a value of any other type: an empty optional is less than every value. The value is compared
+// with *opt directly, without being converted to T or to optional<T> first.
+
+template <typename T, typename U, std::enable_if_t<!detail::is_optional_v<U>, int> = 0>
+constexpr auto operator==(const optional<T>& lhs, const U& rhs)
+    -> detail::optional_comparison_result_t<decltype(*lhs == rhs)> {
+  return lhs.has_value() && *lhs == rhs;
+}
+
+template <typename T, typename U, std::enable_if_t<!detail::is_optional_v<U>, int> = 0>
+constexpr auto operator==(const U& lhs, const optional<T>& rhs)
+    -> detail::optional_comparison_result_t<decltype(lhs == *rhs)> {
+  return rhs.has_value() && lhs == *rhs;
+}
+
+template <typename T, typename U, std::enable_if_t<!detail::is_optional_v<U>, int> = 0>
+constexpr auto operator!=(const optional<T>& lhs, const U& rhs)
+    -> detail::optional_comparison_result_t<decltype(*lhs != rhs)> {
+  return !lhs.has_value() || *lhs != rhs;
+}
+
+template <typename T, typename U, std::enable_if_t<!detail::is_optional_v<U>, int> = 0>
+constexpr auto operator!=(const U& lhs, const optional<T>& rhs)
+    -> detail::optional_comparison_result_t<decltype(lhs != *rhs)> {
+  return !rhs.has_value() || lhs != *rhs;
+}
+
+template <typename T, typename U, std::enable_if_t<!detail::is_optional_v<U>, int> = 0>
+constexpr auto operator<(const optional<T>& lhs, const U& rhs)
+    -> detail::optional_comparison_result_t<decltype(*lhs < rhs)> {
+  return !lhs.has_value() || *lhs < rhs;
+}
+
+template <typename T, typename U, std::enable_if_t<!detail::is_optional_v<U>, int> = 0>
+constexpr auto operator<(const U& lhs, const optional<T>& rhs)
+    -> detail::optional_comparison_result_t<decltype(lhs < *rhs)> {
+  return rhs.has_value() && lhs < *rhs;
+}
+
+template <typename T, typename U, std::enable_if_t<!detail::is_optional_v<U>, int> = 0>
+constexpr auto operator<=(const optional<T>& lhs, const U& rhs)
+    -> detail::optional_comparison_result_t<decltype(*lhs <= rhs)> {
+  return !lhs.has_value() || *lhs <= rhs;
+}
+
+template <typename T, typename U, std::enable_if_t<!detail::is_optional_v<U>, int> = 0>
+constexpr auto operator<=(const U& lhs, const optional<T>& rhs)
+    -> detail::optional_comparison_result_t<decltype(lhs <= *rhs)> {
+  return rhs.has_value() && lhs <= *rhs;
+}
+
+template <typename T, typename U, std::enable_if_t<!detail::is_optional_v<U>, int> = 0>
+constexpr auto operator>(const optional<T>& lhs, const U& rhs)
+    -> detail::optional_comparison_result_t<decltype(*lhs > rhs)> {
+  return lhs.has_value() && *lhs > rhs;
+}
+
+template <typename T, typename U, std::enable_if_t<!detail::is_optional_v<U>, int> = 0>
+constexpr auto operator>(const U& lhs, const optional<T>& rhs)
+    -> detail::optional_comparison_result_t<decltype(lhs > *rhs)> {
+  return !rhs.has_value() || lhs > *rhs;
+}
+
+template <typename T, typename U, std::enable_if_t<!detail::is_optional_v<U>, int> = 0>
+constexpr auto operator>=(const optional<T>& lhs, const U& rhs)
+    -> detail::optional_comparison_result_t<decltype(*lhs >= rhs)> {
+  return lhs.has_value() && *lhs >= rhs;
+}
+
+template <typename T, typename U, std::enable_if_t<!detail::is_optional_v<U>, int> = 0>
+constexpr auto operator>=(const U& lhs, const optional<T>& rhs)
+    -> detail::optional_comparison_result_t<decltype(lhs >= *rhs)> {
+  return !rhs.has_value() || lhs >= *rhs;
+}
+
+// U <=> optional<T> is rewritten from this one
+template <typename T, typename U, std::enable_if_t<!detail::is_optional_v<U>, int> = 0>
+constexpr std::compare_three_way_result_t<T, U> operator<=>(const optional<T>& lhs, const U& rhs) {
+  if (lhs.has_value()) {
+    return *lhs <=> rhs;
+  }
+  return std::strong_ordering::less;
+}
 
 template <typename T>
 optional(T) -> optional<T>;
+
+namespace detail {
+
+inline constexpr std::size_t optional_empty_hash = static_cast<std::size_t>(0x9e3779b97f4a7c15ull);
+
+template <typename T, bool = std::is_default_constructible_v<std::hash<std::remove_const_t<T>>>>
+struct optional_hash {
+  std::size_t operator()(const optional<T>& opt) const
+      noexcept(noexcept(std::hash<std::remove_const_t<T>>{}(*opt))) {
+    return opt.has_value() ? std::hash<std::remove_const_t<T>>{}(*opt) : optional_empty_hash;
+  }
+};
+
+template <typename T>
+struct optional_hash<T, false> {
+  optional_hash() = delete;
+  optional_hash(const optional_hash&) = delete;
+  optional_hash& operator=(const optional_hash&) = delete;
+};
+
+} // namespace detail
+
+// Engaged values hash exactly like T, so lookups by optional<T> and by T agree
+template <typename T>
+struct std::hash<optional<T>> : detail::optional_hash<T> {};
+
+#undef OPTIONAL_COUNT_ON
+#undef OPTIONAL_COUNT
+#undef OPTIONAL_COUNT_FROM
+#undef OPTIONAL_COUNT_IF
+#undef OPTIONAL_COLD_NOINLINE
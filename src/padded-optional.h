@@ -0,0 +1,50 @@
+#pragma once
+
+#include "optional.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+
+// std::hardware_destructive_interference_size is not ABI-stable across compiler flags, so it is spelled out here
+inline constexpr std::size_t destructive_interference_size = 64;
+
+template <typename T, std::size_t Alignment = destructive_interference_size>
+class alignas(std::max(Alignment, alignof(optional<T>))) padded_optional : public optional<T> {
+  using base = optional<T>;
+
+public:
+  padded_optional() = default;
+
+  constexpr padded_optional(nullopt_t) noexcept {}
+
+  // Spelled out instead of inherited: GCC drops explicit(bool) on inheriting constructors
+  template <
+      typename U = T,
+      std::enable_if_t<
+          detail::is_optional_value_constructible_v<T, U> &&
+              !std::is_same_v<std::remove_cvref_t<U>, padded_optional>,
+          int> = 0>
+  constexpr explicit(!std::is_convertible_v<U&&, T>) padded_optional(U&& value
+  ) noexcept(std::is_nothrow_constructible_v<T, U&&>)
+      : base(std::forward<U>(value)) {}
+
+  template <typename... Args, std::enable_if_t<std::is_constructible_v<T, Args&&...>, int> = 0>
+  explicit constexpr padded_optional(in_place_t, Args&&... args) noexcept(std::is_nothrow_constructible_v<T, Args&&...>)
+      : base(in_place, std::forward<Args>(args)...) {}
+
+  constexpr padded_optional& operator=(nullopt_t) noexcept {
+    base::reset();
+    return *this;
+  }
+
+  template <typename U = T, std::enable_if_t<detail::is_optional_value_assignable_v<T, U>, int> = 0>
+  constexpr padded_optional& operator=(U&& value) noexcept(std::is_nothrow_assignable_v<base&, U&&>) {
+    base::operator=(std::forward<U>(value));
+    return *this;
+  }
+};
+
+template <typename T>
+padded_optional(T) -> padded_optional<T>;
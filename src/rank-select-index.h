@@ -0,0 +1,192 @@
+#pragma once
+
+#include <bit>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#if defined(__BMI2__)
+#include <immintrin.h>
+#endif
+
+// Rank and select over a bitmap of 64-bit words, where bit i is bit i % 64 of word i / 64.
+//
+// rank(i) counts the set bits before position i, select(k) finds the position of the k-th set bit (from 0). Every
+// 512-bit block stores its count relative to its 65536-bit superblock, so rank takes constant time. Every 8192-th set
+// bit records the block it falls into, and select binary-searches the blocks between two samples: few on a dense
+// bitmap, but up to all of them on a sparse one, so select takes O(log n) time in general. That is 16 bits per 512,
+// plus 64 per 65536 and 32 per 8192 set bits: under 4% of the bitmap.
+//
+// The index does not own the bitmap, which is passed to every query; bits past the indexed size must be clear. Bits
+// may be appended to the bitmap one at a time with push_back(), or in bulk followed by update(), which indexes only
+// the new part; any other change needs a new index.
+class rank_select_index {
+public:
+  static constexpr std::size_t block_bits = 512;
+  static constexpr std::size_t superblock_bits = 65536;
+  static constexpr std::size_t select_sample = 8192;
+
+  rank_select_index() = default;
+
+  rank_select_index(std::span<const std::uint64_t> words, std::size_t bits) {
+    update(words, bits);
+  }
+
+  // Indexes the bitmap after bits were appended to the one last indexed. Blocks that were already complete are kept.
+  void update(std::span<const std::uint64_t> words, std::size_t bits) {
+    assert(bits >= indexed && words.size() * 64 >= bits);
+
+    std::size_t first = indexed / block_bits;
+    std::uint64_t ones = 0;
+    if (first > 0) {
+      ones = ones_before(first - 1) + block_count(words, first - 1);
+    }
+    blocks.resize(first);
+    superblocks.resize((first + blocks_per_superblock - 1) / blocks_per_superblock);
+    samples.resize(static_cast<std::size_t>((ones + select_sample - 1) / select_sample));
+
+    std::size_t word_count = (bits + 63) / 64;
+    for (std::size_t block = first; block * words_per_block < word_count; ++block) {
+      if (block % blocks_per_superblock == 0) {
+        superblocks.push_back(ones);
+      }
+      blocks.push_back(static_cast<std::uint16_t>(ones - superblocks.back()));
+      std::uint64_t count = block_count(words.first(word_count), block);
+      while (samples.size() * select_sample < ones + count) {
+        samples.push_back(static_cast<std::uint32_t>(block));
+      }
+      ones += count;
+    }
+
+    indexed = bits;
+    total = ones;
+  }
+
+  // Indexes one more bit, which the caller appends to the bitmap. Leaves the index unchanged if it throws.
+  void push_back(bool bit) {
+    std::size_t block = indexed / block_bits;
+    try {
+      if (indexed % block_bits == 0) {
+        if (block % blocks_per_superblock == 0) {
+          superblocks.push_back(total);
+        }
+        blocks.push_back(static_cast<std::uint16_t>(total - superblocks.back()));
+      }
+      if (bit && total % select_sample == 0) {
+        samples.push_back(static_cast<std::uint32_t>(block));
+      }
+    } catch (...) {
+      blocks.resize((indexed + block_bits - 1) / block_bits);
+      superblocks.resize((blocks.size() + blocks_per_superblock - 1) / blocks_per_superblock);
+      throw;
+    }
+    ++indexed;
+    total += bit;
+  }
+
+  std::size_t size() const noexcept {
+    return indexed;
+  }
+
+  // The number of set bits
+  std::uint64_t count() const noexcept {
+    return total;
+  }
+
+  // The number of set bits in [0, i), for i <= size()
+  std::uint64_t rank(std::span<const std::uint64_t> words, std::size_t i) const noexcept {
+    assert(i <= indexed);
+    std::size_t block = i / block_bits;
+    if (block == blocks.size()) {
+      return total;
+    }
+    std::uint64_t result = ones_before(block);
+    std::size_t word = block * words_per_block;
+    for (; word < i / 64; ++word) {
+      result += static_cast<std::uint64_t>(std::popcount(words[word]));
+    }
+    if (i % 64 != 0) {
+      result += static_cast<std::uint64_t>(std::popcount(words[word] & ((std::uint64_t(1) << i % 64) - 1)));
+    }
+    return result;
+  }
+
+  // The position of the k-th set bit, for k < count(). Logarithmic in the number of blocks between the two samples
+  // around k, which is at most all of them when set bits are sparse
+  std::size_t select(std::span<const std::uint64_t> words, std::uint64_t k) const noexcept {
+    assert(k < total);
+    std::size_t sample = static_cast<std::size_t>(k / select_sample);
+    std::size_t low = samples[sample];
+    std::size_t high = sample + 1 < samples.size() ? samples[sample + 1] : blocks.size() - 1;
+    // The last block in [low, high] that starts at or before the k-th set bit
+    while (low < high) {
+      std::size_t middle = low + (high - low + 1) / 2;
+      if (ones_before(middle) <= k) {
+        low = middle;
+      } else {
+        high = middle - 1;
+      }
+    }
+
+    std::uint64_t remaining = k - ones_before(low);
+    std::size_t word = low * words_per_block;
+    for (;; ++word) {
+      auto count = static_cast<std::uint64_t>(std::popcount(words[word]));
+      if (remaining < count) {
+        break;
+      }
+      remaining -= count;
+    }
+    return word * 64 + select_in_word(words[word], static_cast<unsigned>(remaining));
+  }
+
+  // Memory the index needs, not counting spare capacity of its vectors
+  std::size_t memory_bytes() const noexcept {
+    return blocks.size() * sizeof(std::uint16_t) + superblocks.size() * sizeof(std::uint64_t) +
+           samples.size() * sizeof(std::uint32_t);
+  }
+
+private:
+  static constexpr std::size_t words_per_block = block_bits / 64;
+  static constexpr std::size_t blocks_per_superblock = superblock_bits / block_bits;
+
+  std::uint64_t ones_before(std::size_t block) const noexcept {
+    return superblocks[block / blocks_per_superblock] + blocks[block];
+  }
+
+  static std::uint64_t block_count(std::span<const std::uint64_t> words, std::size_t block) noexcept {
+    std::uint64_t result = 0;
+    for (std::size_t i = block * words_per_block; i < words.size() && i < (block + 1) * words_per_block; ++i) {
+      result += static_cast<std::uint64_t>(std::popcount(words[i]));
+    }
+    return result;
+  }
+
+  // The position of the r-th set bit of word, which has more than r
+  static unsigned select_in_word(std::uint64_t word, unsigned r) noexcept {
+#if defined(__BMI2__)
+    return static_cast<unsigned>(std::countr_zero(_pdep_u64(std::uint64_t(1) << r, word)));
+#else
+    unsigned offset = 0;
+    for (;; offset += 8, word >>= 8) {
+      auto count = static_cast<unsigned>(std::popcount(word & 0xff));
+      if (r < count) {
+        break;
+      }
+      r -= count;
+    }
+    for (; r > 0; --r) {
+      word &= word - 1;
+    }
+    return offset + static_cast<unsigned>(std::countr_zero(word));
+#endif
+  }
+
+  std::vector<std::uint16_t> blocks;
+  std::vector<std::uint64_t> superblocks;
+  std::vector<std::uint32_t> samples;
+  std::size_t indexed = 0;
+  std::uint64_t total = 0;
+};
@@ -0,0 +1,245 @@
+#include "allocators.h"
+#include "boxed-optional.h"
+
+#include "test-object.h"
+
+#include <gtest/gtest.h>
+
+#include <array>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct counting_resource {
+  void* allocate(std::size_t size, std::size_t alignment) {
+    ++allocations;
+    return ::operator new(size, std::align_val_t(alignment));
+  }
+
+  void deallocate(void* p, std::size_t size, std::size_t alignment) noexcept {
+    ++deallocations;
+    ::operator delete(p, size, std::align_val_t(alignment));
+  }
+
+  size_t allocations = 0;
+  size_t deallocations = 0;
+};
+
+template <typename T>
+using counting_allocator = resource_allocator<T, counting_resource>;
+
+class boxed_optional_test : public ::testing::Test {
+protected:
+  test_object::no_new_instances_guard instances_guard;
+};
+
+} // namespace
+
+TEST_F(boxed_optional_test, layout) {
+  static_assert(sizeof(boxed_optional<std::array<char, 4096>>) == sizeof(void*));
+  using big = std::array<char, 4096>;
+  static_assert(sizeof(boxed_optional<big, pool_allocator<big>>) == 2 * sizeof(void*));
+  static_assert(std::is_nothrow_move_constructible_v<boxed_optional<std::string>>);
+  static_assert(std::is_nothrow_move_assignable_v<boxed_optional<std::string>>);
+  static_assert(!std::is_convertible_v<std::string_view, boxed_optional<std::string>>);
+  static_assert(std::is_convertible_v<const char*, boxed_optional<std::string>>);
+}
+
+TEST_F(boxed_optional_test, value_semantics) {
+  boxed_optional<test_object> a;
+  EXPECT_FALSE(a.has_value());
+
+  a = 42;
+  EXPECT_TRUE(a.has_value());
+  EXPECT_EQ(*a, 42);
+
+  boxed_optional<test_object> b = a;
+  EXPECT_EQ(*b, 42);
+  EXPECT_NE(&*a, &*b);
+
+  const test_object* box = &*b;
+  boxed_optional<test_object> c = std::move(b);
+  EXPECT_FALSE(b.has_value());
+  EXPECT_EQ(&*c, box);
+
+  c = nullopt;
+  EXPECT_FALSE(c.has_value());
+
+  c.emplace(17);
+  swap(a, c);
+  EXPECT_EQ(*a, 17);
+  EXPECT_EQ(*c, 42);
+
+  a = {};
+  EXPECT_FALSE(a);
+}
+
+TEST_F(boxed_optional_test, comparison) {
+  boxed_optional<int> empty, one(1), two(2);
+
+  EXPECT_TRUE(empty == boxed_optional<int>());
+  EXPECT_TRUE(one != two);
+  EXPECT_TRUE(empty < one);
+  EXPECT_TRUE(one < two);
+  EXPECT_TRUE(two >= one);
+  EXPECT_FALSE(empty > one);
+  EXPECT_TRUE(one <= one);
+
+  EXPECT_TRUE(std::is_lt(empty <=> one));
+  EXPECT_TRUE(std::is_gt(two <=> one));
+  EXPECT_TRUE(std::is_eq(two <=> boxed_optional<int>(2)));
+}
+
+TEST_F(boxed_optional_test, reassignment_reuses_box) {
+  counting_resource resource;
+  counting_allocator<std::string> alloc(resource);
+  {
+    boxed_optional<std::string, counting_allocator<std::string>> a(alloc);
+    a = "hello";
+    EXPECT_EQ(resource.allocations, 1);
+
+    a = "world";
+    a.emplace("again");
+    EXPECT_EQ(*a, "again");
+    EXPECT_EQ(resource.allocations, 1);
+
+    auto b = a;
+    EXPECT_EQ(resource.allocations, 2);
+    EXPECT_EQ(b.get_allocator(), alloc);
+
+    auto c = std::move(a);
+    EXPECT_EQ(resource.allocations, 2);
+    EXPECT_FALSE(a.has_value());
+  }
+  EXPECT_EQ(resource.deallocations, 2);
+}
+
+TEST_F(boxed_optional_test, move_assignment_unequal_allocators) {
+  counting_resource r1, r2;
+  using box = boxed_optional<std::string, counting_allocator<std::string>>;
+  box a(std::allocator_arg, counting_allocator<std::string>(r1), in_place, "a");
+  box b(std::allocator_arg, counting_allocator<std::string>(r2), in_place, "b");
+
+  a = std::move(b);
+  EXPECT_EQ(*a, "b");
+  EXPECT_EQ(a.get_allocator(), counting_allocator<std::string>(r1));
+  EXPECT_EQ(r1.allocations, 1);
+  EXPECT_EQ(r2.allocations, 1);
+}
+
+TEST_F(boxed_optional_test, swap_unequal_allocators) {
+  counting_resource r1, r2;
+  using box = boxed_optional<std::string, counting_allocator<std::string>>;
+  static_assert(!std::is_nothrow_swappable_v<box>);
+  static_assert(std::is_nothrow_swappable_v<boxed_optional<std::string>>);
+  {
+    box a(std::allocator_arg, counting_allocator<std::string>(r1), in_place, "a");
+    box b(counting_allocator<std::string>{r2});
+    swap(a, b);
+    EXPECT_FALSE(a.has_value());
+    EXPECT_EQ(*b, "a");
+    EXPECT_EQ(a.get_allocator(), counting_allocator<std::string>(r1));
+    EXPECT_EQ(b.get_allocator(), counting_allocator<std::string>(r2));
+
+    a.swap(b);
+    EXPECT_EQ(*a, "a");
+    EXPECT_FALSE(b.has_value());
+
+    b = "b";
+    swap(a, b);
+    EXPECT_EQ(*a, "b");
+    EXPECT_EQ(*b, "a");
+  }
+  // Every box went back to the resource it came from
+  EXPECT_EQ(r1.allocations, r1.deallocations);
+  EXPECT_EQ(r2.allocations, r2.deallocations);
+}
+
+TEST_F(boxed_optional_test, swap_between_arenas) {
+  monotonic_arena first_arena;
+  monotonic_arena second_arena;
+  using box = boxed_optional<std::array<int, 16>, arena_allocator<std::array<int, 16>>>;
+  box a(std::allocator_arg, arena_allocator<std::array<int, 16>>(first_arena), in_place);
+  box b(arena_allocator<std::array<int, 16>>{second_arena});
+  a->fill(1);
+  const auto* boxed = &*a;
+
+  swap(a, b);
+  EXPECT_FALSE(a.has_value());
+  EXPECT_EQ((*b)[15], 1);
+  // b made a box of its own in the second arena rather than taking the first arena's
+  EXPECT_NE(&*b, boxed);
+
+  first_arena.release();
+  EXPECT_EQ((*b)[0], 1);
+}
+
+TEST_F(boxed_optional_test, emplace_throw) {
+  struct throwing_ctor {
+    throwing_ctor(bool should_throw) {
+      if (should_throw) {
+        throw std::exception();
+      }
+    }
+  };
+
+  counting_resource resource;
+  {
+    boxed_optional<throwing_ctor, counting_allocator<throwing_ctor>> a(counting_allocator<throwing_ctor>{resource});
+    a.emplace(false);
+    EXPECT_THROW(a.emplace(true), std::exception);
+    EXPECT_FALSE(a.has_value());
+  }
+  EXPECT_EQ(resource.allocations, resource.deallocations);
+}
+
+TEST_F(boxed_optional_test, arena) {
+  monotonic_arena arena(64);
+  arena_allocator<std::array<int, 100>> alloc(arena);
+  std::vector<boxed_optional<std::array<int, 100>, arena_allocator<std::array<int, 100>>>> values;
+  values.reserve(100);
+  for (int i = 0; i < 100; ++i) {
+    auto& value = values.emplace_back(std::allocator_arg, alloc, in_place);
+    value->fill(i);
+    EXPECT_EQ(reinterpret_cast<std::uintptr_t>(&*value) % alignof(std::array<int, 100>), 0);
+  }
+  for (int i = 0; i < 100; ++i) {
+    EXPECT_EQ((*values[i])[99], i);
+  }
+}
+
+TEST_F(boxed_optional_test, size_class_pool_min_block) {
+  for (std::size_t block_size : {0, 16, 4096, 4111}) {
+    size_class_pool pool(block_size);
+    void* p = pool.allocate(4096, alignof(std::max_align_t));
+    std::memset(p, 0xab, 4096);
+    void* q = pool.allocate(2048, alignof(std::max_align_t));
+    std::memset(q, 0xcd, 2048);
+    pool.deallocate(q, 2048, alignof(std::max_align_t));
+    pool.deallocate(p, 4096, alignof(std::max_align_t));
+  }
+}
+
+TEST_F(boxed_optional_test, size_class_pool) {
+  size_class_pool pool;
+  for (std::size_t size : {1, 16, 17, 100, 4096}) {
+    void* p = pool.allocate(size, alignof(std::max_align_t));
+    EXPECT_EQ(reinterpret_cast<std::uintptr_t>(p) % alignof(std::max_align_t), 0);
+    std::memset(p, 0xab, size);
+    pool.deallocate(p, size, alignof(std::max_align_t));
+
+    void* q = pool.allocate(size, alignof(std::max_align_t));
+    EXPECT_EQ(q, p);
+    pool.deallocate(q, size, alignof(std::max_align_t));
+  }
+
+  void* large = pool.allocate(5000, alignof(std::max_align_t));
+  std::memset(large, 0xab, 5000);
+  pool.deallocate(large, 5000, alignof(std::max_align_t));
+
+  void* overaligned = pool.allocate(128, 256);
+  EXPECT_EQ(reinterpret_cast<std::uintptr_t>(overaligned) % 256, 0);
+  pool.deallocate(overaligned, 128, 256);
+}
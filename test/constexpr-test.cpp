@@ -222,3 +222,7 @@ static_assert(
     }(),
     "emplace"
 );
+
+constexpr optional<int> constant_empty;
+constexpr optional<int> constant_engaged = 42;
+static_assert(!constant_empty.has_value() && *constant_engaged == 42, "constexpr variables");
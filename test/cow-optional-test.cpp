@@ -0,0 +1,321 @@
+#include "cow-optional.h"
+
+#include "test-object.h"
+
+#include <gtest/gtest.h>
+
+#include <cstddef>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace {
+
+class cow_optional_test : public ::testing::Test {
+protected:
+  test_object::no_new_instances_guard instances_guard;
+};
+
+struct text_holder {
+  text_holder(std::string text)
+      : text(std::move(text)) {}
+
+  std::string text;
+};
+
+struct throw_on_copy {
+  explicit throw_on_copy(int value)
+      : value(value) {}
+
+  throw_on_copy(const throw_on_copy&) {
+    throw std::runtime_error("throw_on_copy");
+  }
+
+  throw_on_copy& operator=(const throw_on_copy&) = default;
+
+  int value;
+};
+
+} // namespace
+
+TEST_F(cow_optional_test, layout) {
+  static_assert(sizeof(cow_optional<std::vector<std::string>>) == sizeof(void*));
+  static_assert(std::is_nothrow_copy_constructible_v<cow_optional<std::string>>);
+  static_assert(std::is_nothrow_move_constructible_v<cow_optional<std::string>>);
+  static_assert(std::is_nothrow_copy_assignable_v<cow_optional<std::string>>);
+  static_assert(!std::is_convertible_v<std::string_view, cow_optional<std::string>>);
+  static_assert(std::is_convertible_v<const char*, cow_optional<std::string>>);
+  static_assert(!std::is_convertible_v<optional<std::string>, cow_optional<std::string>>);
+}
+
+TEST_F(cow_optional_test, copies_share) {
+  {
+    cow_optional<test_object> a(in_place, 42);
+    EXPECT_EQ(a.use_count(), 1);
+    EXPECT_TRUE(a.unique());
+
+    cow_optional<test_object> b = a;
+    cow_optional<test_object> c;
+    c = b;
+    EXPECT_EQ(a.use_count(), 3);
+    EXPECT_FALSE(a.unique());
+    EXPECT_EQ(&*std::as_const(a), &*std::as_const(b));
+    EXPECT_EQ(&*std::as_const(a), &*std::as_const(c));
+    EXPECT_EQ(*std::as_const(c), 42);
+
+    c.reset();
+    EXPECT_EQ(a.use_count(), 2);
+    EXPECT_EQ(c.use_count(), 0);
+  }
+  instances_guard.expect_no_instances();
+}
+
+TEST_F(cow_optional_test, mutation_clones_shared) {
+  {
+    cow_optional<test_object> a(in_place, 1);
+    cow_optional<test_object> b = a;
+    const test_object* shared = &*std::as_const(a);
+
+    *b = 2;
+    EXPECT_EQ(*std::as_const(a), 1);
+    EXPECT_EQ(*std::as_const(b), 2);
+    EXPECT_EQ(&*std::as_const(a), shared);
+    EXPECT_TRUE(a.unique());
+    EXPECT_TRUE(b.unique());
+
+    // The only owner mutates in place
+    *a = 3;
+    EXPECT_EQ(&*std::as_const(a), shared);
+  }
+  instances_guard.expect_no_instances();
+}
+
+TEST_F(cow_optional_test, const_access_does_not_clone) {
+  cow_optional<std::string> a = "shared";
+  const cow_optional<std::string> b = a;
+  EXPECT_EQ(b->size(), 6);
+  EXPECT_EQ(*b, "shared");
+  EXPECT_EQ(a.use_count(), 2);
+}
+
+TEST_F(cow_optional_test, value_assignment) {
+  cow_optional<std::string> a;
+  a = "one";
+  EXPECT_EQ(*std::as_const(a), "one");
+
+  const char* data = std::as_const(a)->data();
+  a = "two";
+  EXPECT_EQ(std::as_const(a)->data(), data);
+
+  cow_optional<std::string> b = a;
+  b = "three";
+  EXPECT_EQ(*std::as_const(a), "two");
+  EXPECT_EQ(*std::as_const(b), "three");
+
+  a = nullopt;
+  EXPECT_FALSE(a.has_value());
+}
+
+TEST_F(cow_optional_test, moves) {
+  cow_optional<std::string> a = "value";
+  cow_optional<std::string> b = std::move(a);
+  EXPECT_FALSE(a.has_value());
+  EXPECT_EQ(b.use_count(), 1);
+
+  cow_optional<std::string> c = b;
+  std::string moved = *std::move(c);
+  EXPECT_EQ(moved, "value");
+  EXPECT_EQ(*std::as_const(b), "value");
+
+  cow_optional<std::string> taken = b.take();
+  EXPECT_FALSE(b.has_value());
+  EXPECT_EQ(*std::as_const(taken), "value");
+
+  cow_optional<std::string> old = taken.replace("new");
+  EXPECT_EQ(*std::as_const(old), "value");
+  EXPECT_EQ(*std::as_const(taken), "new");
+}
+
+TEST_F(cow_optional_test, emplace) {
+  {
+    cow_optional<test_object> a(in_place, 1);
+    cow_optional<test_object> b = a;
+    b.emplace(2);
+    EXPECT_EQ(*std::as_const(a), 1);
+    EXPECT_EQ(*std::as_const(b), 2);
+
+    b.emplace_with([] { return test_object(3); });
+    EXPECT_EQ(*std::as_const(b), 3);
+  }
+  instances_guard.expect_no_instances();
+}
+
+TEST_F(cow_optional_test, throwing_clone) {
+  cow_optional<throw_on_copy> a(in_place, 1);
+  cow_optional<throw_on_copy> b = a;
+  EXPECT_THROW(*b, std::runtime_error);
+  EXPECT_EQ(a.use_count(), 2);
+  EXPECT_EQ(std::as_const(b)->value, 1);
+}
+
+TEST_F(cow_optional_test, optional_conversions) {
+  optional<std::string> plain = "plain";
+  cow_optional<std::string> a(plain);
+  EXPECT_EQ(*std::as_const(a), "plain");
+  EXPECT_EQ(a.to_optional(), plain);
+
+  cow_optional<std::string> empty(optional<std::string>{});
+  EXPECT_FALSE(empty.has_value());
+  EXPECT_FALSE(empty.to_optional().has_value());
+}
+
+TEST_F(cow_optional_test, comparison) {
+  cow_optional<int> empty;
+  cow_optional<int> one = 1;
+  cow_optional<int> two = 2;
+  EXPECT_EQ(empty, cow_optional<int>());
+  EXPECT_EQ(one, cow_optional<int>(1));
+  EXPECT_NE(one, two);
+  EXPECT_NE(empty, one);
+  EXPECT_LT(empty, one);
+  EXPECT_LT(one, two);
+  EXPECT_LE(one, one);
+  EXPECT_GT(two, empty);
+  EXPECT_GE(two, one);
+  EXPECT_EQ(one <=> two, std::strong_ordering::less);
+  EXPECT_EQ(empty <=> empty, std::strong_ordering::equal);
+}
+
+TEST_F(cow_optional_test, nullopt_comparison) {
+  cow_optional<int> empty;
+  cow_optional<int> one = 1;
+  EXPECT_TRUE(empty == nullopt);
+  EXPECT_TRUE(nullopt == empty);
+  EXPECT_TRUE(one != nullopt);
+  EXPECT_TRUE(nullopt < one);
+  EXPECT_FALSE(one < nullopt);
+  EXPECT_TRUE(empty <= nullopt);
+  EXPECT_EQ(one <=> nullopt, std::strong_ordering::greater);
+  EXPECT_EQ(nullopt <=> empty, std::strong_ordering::equal);
+}
+
+TEST_F(cow_optional_test, value_comparison) {
+  cow_optional<int> empty;
+  cow_optional<int> three = 3;
+  cow_optional<int> shared = three;
+
+  EXPECT_TRUE(three == 3);
+  EXPECT_TRUE(3 == three);
+  EXPECT_TRUE(three != 4);
+  EXPECT_TRUE(empty != 3);
+  EXPECT_FALSE(empty == 3);
+  EXPECT_TRUE(three < 4);
+  EXPECT_TRUE(empty < 3);
+  EXPECT_TRUE(2 < three);
+  EXPECT_TRUE(three <= 3);
+  EXPECT_TRUE(3 >= empty);
+  EXPECT_TRUE(three > 2);
+  EXPECT_TRUE(4 > three);
+  EXPECT_TRUE(three >= 3L);
+  EXPECT_EQ(three <=> 4, std::strong_ordering::less);
+  EXPECT_EQ(4 <=> three, std::strong_ordering::greater);
+  EXPECT_EQ(empty <=> 3, std::strong_ordering::less);
+
+  // Comparing only reads the value, so the shared block is left alone
+  EXPECT_EQ(three.use_count(), 2);
+
+  cow_optional<std::string> text = std::string("abc");
+  EXPECT_TRUE(text == "abc");
+  EXPECT_TRUE("abd" > text);
+}
+
+TEST_F(cow_optional_test, assign_or_emplace) {
+  cow_optional<test_object> a;
+  EXPECT_EQ(a.assign_or_emplace(1), 1);
+  EXPECT_EQ(a.use_count(), 1);
+
+  const test_object* address = std::as_const(a).operator->();
+  EXPECT_EQ(a.assign_or_emplace(2), 2);
+  EXPECT_EQ(std::as_const(a).operator->(), address);
+
+  cow_optional<test_object> b = a;
+  EXPECT_EQ(b.assign_or_emplace(3), 3);
+  EXPECT_EQ(*std::as_const(a), 2);
+  EXPECT_EQ(a.use_count(), 1);
+  EXPECT_EQ(b.use_count(), 1);
+}
+
+TEST_F(cow_optional_test, converting) {
+  static_assert(std::is_convertible_v<const cow_optional<int>&, cow_optional<long>>);
+  static_assert(std::is_constructible_v<cow_optional<std::string>, const cow_optional<const char*>&>);
+  static_assert(!std::is_convertible_v<const cow_optional<int>&, cow_optional<std::vector<int>>>);
+  static_assert(std::is_constructible_v<cow_optional<std::vector<int>>, const cow_optional<int>&>);
+  static_assert(!std::is_constructible_v<cow_optional<int>, const cow_optional<std::string>&>);
+
+  cow_optional<int> five = 5;
+  cow_optional<int> shared = five;
+  cow_optional<long> widened = five;
+  EXPECT_EQ(*std::as_const(widened), 5L);
+  EXPECT_EQ(widened.use_count(), 1);
+  EXPECT_EQ(five.use_count(), 2);
+
+  cow_optional<long> empty = cow_optional<int>();
+  EXPECT_FALSE(empty.has_value());
+
+  // A shared source is copied from, so the other owner keeps its value
+  cow_optional<std::string> text = std::string("shared");
+  cow_optional<std::string> text_copy = text;
+  cow_optional<test_object> from_shared(cow_optional<int>(8));
+  cow_optional<std::vector<std::string>> wrapped(cow_optional<std::size_t>(2));
+  EXPECT_EQ(*std::as_const(from_shared), 8);
+  EXPECT_EQ(std::as_const(wrapped)->size(), 2u);
+  cow_optional<std::string> moved_shared(std::move(text));
+  EXPECT_EQ(*std::as_const(moved_shared), "shared");
+  EXPECT_EQ(*std::as_const(text_copy), "shared");
+
+  // A unique source is moved from
+  cow_optional<std::string> unique_text = std::string("a string too long for the small buffer");
+  cow_optional<text_holder> converted(std::move(unique_text));
+  EXPECT_EQ(std::as_const(converted)->text, "a string too long for the small buffer");
+  EXPECT_TRUE(std::as_const(unique_text)->empty());
+
+  static_assert(!std::is_constructible_v<cow_optional<std::shared_ptr<int>>, cow_optional<std::unique_ptr<int>>&&>);
+
+  widened = cow_optional<int>(7);
+  EXPECT_EQ(*std::as_const(widened), 7L);
+  cow_optional<long> widened_copy = widened;
+  widened = shared;
+  EXPECT_EQ(*std::as_const(widened), 5L);
+  EXPECT_EQ(*std::as_const(widened_copy), 7L);
+  widened = cow_optional<int>();
+  EXPECT_FALSE(widened.has_value());
+  EXPECT_TRUE(widened_copy.has_value());
+}
+
+// Copies of one value handed to several threads, each of which reads and then modifies its own copy
+TEST_F(cow_optional_test, concurrent_copies) {
+  cow_optional<std::vector<int>> original(in_place, 1000, 1);
+  std::vector<std::thread> threads;
+  std::vector<int> sums(4);
+  for (std::size_t t = 0; t < sums.size(); ++t) {
+    threads.emplace_back([&, t, copy = original]() mutable {
+      for (int i = 0; i < 1000; ++i) {
+        cow_optional<std::vector<int>> local = copy;
+        sums[t] += std::as_const(local)->at(static_cast<std::size_t>(i));
+      }
+      copy->push_back(static_cast<int>(t));
+      sums[t] += copy->back();
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  for (std::size_t t = 0; t < sums.size(); ++t) {
+    EXPECT_EQ(sums[t], 1000 + static_cast<int>(t));
+  }
+  EXPECT_EQ(std::as_const(original)->size(), 1000);
+  EXPECT_TRUE(original.unique());
+}
@@ -0,0 +1,351 @@
+#include "flat-optional-map.h"
+
+#include "test-object.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <map>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+namespace {
+
+// Key types of the test's own: a niche_traits specialization for std::uint32_t here would claim UINT32_MAX for every
+// other translation unit of the binary too
+enum class narrow_id : std::uint32_t {};
+enum class wide_id : std::uint64_t {};
+
+// A key that is not an integer, so lookups take the scalar probe
+struct entity_id {
+  std::uint32_t value;
+
+  friend bool operator==(entity_id, entity_id) = default;
+};
+
+} // namespace
+
+template <>
+struct niche_traits<narrow_id> {
+  static constexpr bool has_niche = true;
+
+  static constexpr narrow_id empty() noexcept {
+    return narrow_id{UINT32_MAX};
+  }
+};
+
+template <>
+struct niche_traits<wide_id> {
+  static constexpr bool has_niche = true;
+
+  static constexpr wide_id empty() noexcept {
+    return wide_id{UINT64_MAX};
+  }
+};
+
+template <>
+struct niche_traits<entity_id> {
+  static constexpr bool has_niche = true;
+
+  static constexpr entity_id empty() noexcept {
+    return {UINT32_MAX};
+  }
+};
+
+template <>
+struct std::hash<entity_id> {
+  std::size_t operator()(entity_id id) const noexcept {
+    return id.value;
+  }
+};
+
+namespace {
+
+// Its move may throw, so rehashing copies it; the copy throws once copies_left runs out
+struct throwing_copy {
+  explicit throwing_copy(int value)
+      : value(value) {}
+
+  throwing_copy(const throwing_copy& other)
+      : value(other.value) {
+    if (copies_left-- == 0) {
+      throw std::runtime_error("throwing_copy");
+    }
+  }
+
+  throwing_copy& operator=(const throwing_copy&) = default;
+
+  int value;
+
+  inline static int copies_left = 0;
+};
+
+// Throws once hashes_left runs out
+struct throwing_hash {
+  std::size_t operator()(int key) const {
+    if (hashes_left-- == 0) {
+      throw std::runtime_error("throwing_hash");
+    }
+    return static_cast<std::size_t>(key);
+  }
+
+  inline static int hashes_left = 0;
+};
+
+template <typename Map>
+class flat_optional_map_test : public ::testing::Test {};
+
+using map_types = ::testing::Types<
+    flat_optional_map<int, std::string>,
+    flat_optional_map<narrow_id, std::string>,
+    flat_optional_map<wide_id, std::string>>;
+
+TYPED_TEST_SUITE(flat_optional_map_test, map_types);
+
+template <typename Map>
+typename Map::key_type make_key(int value) {
+  return static_cast<typename Map::key_type>(value);
+}
+
+template <typename Map>
+class flat_optional_map_sentinel_test : public ::testing::Test {};
+
+using niche_map_types =
+    ::testing::Types<flat_optional_map<narrow_id, test_object>, flat_optional_map<wide_id, test_object>>;
+
+TYPED_TEST_SUITE(flat_optional_map_sentinel_test, niche_map_types);
+
+} // namespace
+
+TYPED_TEST(flat_optional_map_test, insert_find_erase) {
+  TypeParam map;
+  EXPECT_TRUE(map.empty());
+  EXPECT_FALSE(map.contains(make_key<TypeParam>(1)));
+
+  EXPECT_TRUE(map.try_emplace(make_key<TypeParam>(1), "one").second);
+  EXPECT_TRUE(map.try_emplace(make_key<TypeParam>(2), "two").second);
+  EXPECT_FALSE(map.try_emplace(make_key<TypeParam>(1), "uno").second);
+  EXPECT_EQ(map.size(), 2);
+  EXPECT_EQ(map.find(make_key<TypeParam>(1))->second, "one");
+
+  map[make_key<TypeParam>(3)] = "three";
+  map.insert_or_assign(make_key<TypeParam>(1), std::string("uno"));
+  EXPECT_EQ(map[make_key<TypeParam>(1)], "uno");
+  EXPECT_EQ(map.size(), 3);
+
+  EXPECT_EQ(map.erase(make_key<TypeParam>(2)), 1);
+  EXPECT_EQ(map.erase(make_key<TypeParam>(2)), 0);
+  EXPECT_EQ(map.find(make_key<TypeParam>(2)), map.end());
+  EXPECT_EQ(map.size(), 2);
+}
+
+TYPED_TEST(flat_optional_map_test, matches_std_map) {
+  TypeParam map;
+  std::map<int, std::string> reference;
+  std::mt19937 rng(12345);
+  std::uniform_int_distribution<int> keys(0, 2000);
+  std::uniform_int_distribution<int> ops(0, 2);
+
+  for (int i = 0; i < 50000; ++i) {
+    int key = keys(rng);
+    switch (ops(rng)) {
+    case 0:
+      EXPECT_EQ(
+          map.try_emplace(make_key<TypeParam>(key), std::to_string(i)).second,
+          reference.try_emplace(key, std::to_string(i)).second
+      );
+      break;
+    case 1:
+      EXPECT_EQ(map.erase(make_key<TypeParam>(key)), reference.erase(key));
+      break;
+    default:
+      EXPECT_EQ(map.contains(make_key<TypeParam>(key)), reference.contains(key));
+      break;
+    }
+  }
+
+  EXPECT_EQ(map.size(), reference.size());
+  std::size_t visited = 0;
+  for (auto [key, value] : map) {
+    ASSERT_TRUE(reference.contains(static_cast<int>(key)));
+    EXPECT_EQ(value, reference.at(static_cast<int>(key)));
+    ++visited;
+  }
+  EXPECT_EQ(visited, reference.size());
+}
+
+TYPED_TEST(flat_optional_map_test, colliding_keys) {
+  TypeParam map;
+  for (int i = 0; i < 1000; ++i) {
+    map[make_key<TypeParam>(i << 16)] = std::to_string(i);
+  }
+  for (int i = 0; i < 1000; i += 2) {
+    EXPECT_EQ(map.erase(make_key<TypeParam>(i << 16)), 1);
+  }
+  for (int i = 0; i < 1000; ++i) {
+    EXPECT_EQ(map.contains(make_key<TypeParam>(i << 16)), i % 2 == 1);
+  }
+}
+
+TYPED_TEST(flat_optional_map_test, reserve_rehash) {
+  TypeParam map;
+  map.reserve(1000);
+  auto buckets = map.bucket_count();
+  EXPECT_GE(buckets * 3, 1000 * 4);
+  for (int i = 0; i < 1000; ++i) {
+    map[make_key<TypeParam>(i)] = "x";
+  }
+  EXPECT_EQ(map.bucket_count(), buckets);
+
+  map.rehash(buckets * 4);
+  EXPECT_EQ(map.bucket_count(), buckets * 4);
+  for (int i = 0; i < 1000; ++i) {
+    EXPECT_TRUE(map.contains(make_key<TypeParam>(i)));
+  }
+
+  map.clear();
+  EXPECT_TRUE(map.empty());
+  EXPECT_EQ(map.begin(), map.end());
+}
+
+TYPED_TEST(flat_optional_map_test, moved_from) {
+  TypeParam map;
+  map[make_key<TypeParam>(1)] = "one";
+
+  TypeParam moved = std::move(map);
+  EXPECT_EQ(moved.size(), 1);
+  EXPECT_EQ(map.size(), 0);
+  EXPECT_TRUE(map.empty());
+  EXPECT_FALSE(map.contains(make_key<TypeParam>(1)));
+  EXPECT_EQ(map.find(make_key<TypeParam>(1)), map.end());
+  EXPECT_EQ(map.erase(make_key<TypeParam>(1)), 0);
+  EXPECT_EQ(map.begin(), map.end());
+
+  EXPECT_TRUE(map.try_emplace(make_key<TypeParam>(2), "two").second);
+  EXPECT_EQ(map.size(), 1);
+  EXPECT_EQ(map.find(make_key<TypeParam>(2))->second, "two");
+
+  TypeParam assigned;
+  assigned = std::move(map);
+  EXPECT_TRUE(map.empty());
+  EXPECT_FALSE(map.contains(make_key<TypeParam>(2)));
+  map[make_key<TypeParam>(3)] = "three";
+  EXPECT_EQ(map.size(), 1);
+  EXPECT_EQ(assigned.size(), 1);
+  EXPECT_EQ(moved.size(), 1);
+}
+
+// The sentinel is never found, erased or inserted, both on the scalar probe of a 16-bucket map and on the SIMD groups
+// of larger ones
+TYPED_TEST(flat_optional_map_sentinel_test, sentinel_key) {
+  using key_type = typename TypeParam::key_type;
+  const key_type sentinel = niche_traits<key_type>::empty();
+  test_object::no_new_instances_guard guard;
+  for (std::size_t capacity : {0, 48, 1000}) {
+    TypeParam map(capacity);
+    map.try_emplace(make_key<TypeParam>(1), 1);
+    ASSERT_TRUE(capacity != 0 || map.bucket_count() == 16);
+    ASSERT_TRUE(capacity == 0 || map.bucket_count() >= 64);
+
+    EXPECT_FALSE(map.contains(sentinel));
+    EXPECT_EQ(map.find(sentinel), map.end());
+    EXPECT_EQ(map.erase(sentinel), 0);
+    EXPECT_EQ(map.size(), 1);
+
+    EXPECT_THROW(map.try_emplace(sentinel, 2), std::invalid_argument);
+    EXPECT_EQ(map.size(), 1);
+    EXPECT_FALSE(map.contains(sentinel));
+    EXPECT_EQ(map.find(make_key<TypeParam>(1))->second, 1);
+  }
+  guard.expect_no_instances();
+}
+
+TEST(flat_optional_map_niche_test, custom_key) {
+  static_assert(niche_traits<entity_id>::has_niche);
+  flat_optional_map<entity_id, int> map;
+  map[entity_id{7}] = 1;
+  EXPECT_TRUE(map.contains(entity_id{7}));
+  EXPECT_FALSE(map.contains(entity_id{8}));
+  EXPECT_FALSE(map.contains(entity_id{UINT32_MAX}));
+  EXPECT_EQ(map.erase(entity_id{UINT32_MAX}), 0);
+  EXPECT_THROW(map[entity_id{UINT32_MAX}], std::invalid_argument);
+  EXPECT_EQ(map.size(), 1);
+}
+
+TEST(flat_optional_map_niche_test, no_leaks) {
+  test_object::no_new_instances_guard guard;
+  {
+    flat_optional_map<narrow_id, test_object> map;
+    for (std::uint32_t i = 0; i < 100; ++i) {
+      map.try_emplace(narrow_id{i}, static_cast<int>(i));
+    }
+    for (std::uint32_t i = 0; i < 100; i += 3) {
+      map.erase(narrow_id{i});
+    }
+    for (std::uint32_t i = 1; i < 100; i += 3) {
+      EXPECT_EQ(map.find(narrow_id{i})->second, static_cast<int>(i));
+    }
+  }
+  guard.expect_no_instances();
+}
+
+TEST(flat_optional_map_rehash_test, throwing_copy) {
+  static_assert(!std::is_nothrow_move_constructible_v<throwing_copy>);
+  test_object::no_new_instances_guard guard;
+  {
+    flat_optional_map<narrow_id, throwing_copy> niche_map;
+    flat_optional_map<int, throwing_copy> pair_map;
+    throwing_copy::copies_left = 1000;
+    for (int i = 0; i < 10; ++i) {
+      niche_map.try_emplace(narrow_id{static_cast<std::uint32_t>(i)}, i);
+      pair_map.try_emplace(i, i);
+    }
+    auto buckets = pair_map.bucket_count();
+
+    throwing_copy::copies_left = 5;
+    EXPECT_THROW(niche_map.rehash(1024), std::runtime_error);
+    throwing_copy::copies_left = 5;
+    EXPECT_THROW(pair_map.rehash(1024), std::runtime_error);
+    throwing_copy::copies_left = 1000;
+
+    EXPECT_EQ(niche_map.bucket_count(), buckets);
+    EXPECT_EQ(pair_map.bucket_count(), buckets);
+    EXPECT_EQ(niche_map.size(), 10);
+    EXPECT_EQ(pair_map.size(), 10);
+    for (int i = 0; i < 10; ++i) {
+      EXPECT_EQ(niche_map.find(narrow_id{static_cast<std::uint32_t>(i)})->second.value, i);
+      EXPECT_EQ(pair_map.find(i)->second.value, i);
+    }
+
+    niche_map.rehash(1024);
+    pair_map.rehash(1024);
+    EXPECT_EQ(pair_map.bucket_count(), 1024);
+    for (int i = 0; i < 10; ++i) {
+      EXPECT_EQ(niche_map.find(narrow_id{static_cast<std::uint32_t>(i)})->second.value, i);
+      EXPECT_EQ(pair_map.find(i)->second.value, i);
+    }
+  }
+  guard.expect_no_instances();
+}
+
+TEST(flat_optional_map_rehash_test, throwing_hash) {
+  flat_optional_map<int, std::string, throwing_hash> map;
+  throwing_hash::hashes_left = 1000;
+  for (int i = 0; i < 10; ++i) {
+    map.try_emplace(i, std::to_string(i));
+  }
+  auto buckets = map.bucket_count();
+
+  throwing_hash::hashes_left = 5;
+  EXPECT_THROW(map.rehash(1024), std::runtime_error);
+  throwing_hash::hashes_left = 1000;
+
+  EXPECT_EQ(map.bucket_count(), buckets);
+  EXPECT_EQ(map.size(), 10);
+  for (int i = 0; i < 10; ++i) {
+    EXPECT_EQ(map.find(i)->second, std::to_string(i));
+  }
+}
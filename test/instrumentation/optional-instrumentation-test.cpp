@@ -0,0 +1,181 @@
+#include "optional.h"
+
+#include "test-object.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+static_assert(OPTIONAL_INSTRUMENTATION, "this test must be built with OPTIONAL_INSTRUMENTATION=1");
+
+namespace {
+
+struct only_here {
+  int value;
+
+  only_here(int value)
+      : value(value) {}
+
+  only_here(const only_here& other)
+      : value(other.value) {}
+
+  only_here(only_here&& other) noexcept
+      : value(other.value) {}
+
+  only_here& operator=(const only_here& other) {
+    value = other.value;
+    return *this;
+  }
+
+  only_here& operator=(only_here&& other) noexcept {
+    value = other.value;
+    return *this;
+  }
+};
+
+class instrumentation_test : public ::testing::Test {
+protected:
+  void SetUp() override {
+    optional_instrumentation::reset();
+  }
+
+  test_object::no_new_instances_guard instances_guard;
+};
+
+} // namespace
+
+TEST_F(instrumentation_test, size_unchanged) {
+  EXPECT_EQ(sizeof(optional<int>), 2 * sizeof(int));
+  EXPECT_EQ(sizeof(optional<test_object>), 2 * sizeof(int));
+}
+
+TEST_F(instrumentation_test, counts_each_event) {
+  {
+    optional<test_object> a(1);
+    optional<test_object> b(in_place, 2);
+    optional<test_object> c = a;
+    optional<test_object> d = std::move(b);
+    c = d;
+    d = std::move(a);
+    a.emplace(3);
+    a.swap(c);
+    a.reset();
+    b = nullopt;
+    b = test_object(4);
+  }
+
+  auto counters = optional_instrumentation::snapshot<test_object>();
+  EXPECT_EQ(counters[optional_event::construct], 3);
+  EXPECT_EQ(counters[optional_event::copy], 2);
+  EXPECT_EQ(counters[optional_event::move], 2);
+  EXPECT_EQ(counters[optional_event::emplace], 1);
+  EXPECT_EQ(counters[optional_event::reset], 2);
+  EXPECT_EQ(counters[optional_event::swap], 1);
+  EXPECT_EQ(counters[optional_event::empty_dereference], 0);
+}
+
+TEST_F(instrumentation_test, empty_dereference) {
+  optional<int> engaged = 1;
+  optional<int> empty;
+  static_cast<void>(*engaged);
+  static_cast<void>(engaged.operator->());
+  static_cast<void>(empty.operator->());
+  EXPECT_EQ(optional_instrumentation::snapshot<int>()[optional_event::empty_dereference], 1);
+}
+
+TEST_F(instrumentation_test, trivially_copyable_copies_stay_trivial) {
+  EXPECT_TRUE(std::is_trivially_copy_constructible_v<optional<int>>);
+  optional<int> a = 1;
+  optional<int> b = a;
+  b = a;
+  EXPECT_EQ(*b, 1);
+  EXPECT_EQ(optional_instrumentation::snapshot<int>()[optional_event::copy], 0);
+}
+
+TEST_F(instrumentation_test, counted_per_type) {
+  optional<only_here> a(1);
+  optional<only_here> b = a;
+  optional<double> c(1.0);
+
+  EXPECT_EQ(b->value, 1);
+  EXPECT_EQ(optional_instrumentation::snapshot<only_here>()[optional_event::copy], 1);
+  EXPECT_EQ(optional_instrumentation::snapshot<double>()[optional_event::copy], 0);
+  EXPECT_EQ(optional_instrumentation::snapshot<double>()[optional_event::construct], 1);
+}
+
+TEST_F(instrumentation_test, aggregates_exited_threads) {
+  constexpr int thread_count = 4;
+  constexpr int per_thread = 1000;
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < thread_count; ++t) {
+    threads.emplace_back([] {
+      optional<only_here> x;
+      for (int i = 0; i < per_thread; ++i) {
+        x.emplace(i);
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  EXPECT_EQ(optional_instrumentation::snapshot<only_here>()[optional_event::emplace], thread_count * per_thread);
+}
+
+TEST_F(instrumentation_test, aggregates_live_threads) {
+  std::atomic<bool> recorded = false;
+  std::atomic<bool> done = false;
+  std::thread worker([&] {
+    optional<only_here> x;
+    x.emplace(1);
+    recorded = true;
+    while (!done) {
+      std::this_thread::yield();
+    }
+  });
+  while (!recorded) {
+    std::this_thread::yield();
+  }
+  EXPECT_EQ(optional_instrumentation::snapshot<only_here>()[optional_event::emplace], 1);
+  done = true;
+  worker.join();
+  EXPECT_EQ(optional_instrumentation::snapshot<only_here>()[optional_event::emplace], 1);
+}
+
+TEST_F(instrumentation_test, report) {
+  optional<only_here> a(1);
+  a.reset();
+
+  std::ostringstream out;
+  optional_instrumentation::report(out);
+  std::string text = out.str();
+  EXPECT_NE(text.find("only_here"), std::string::npos) << text;
+  EXPECT_NE(text.find("construct=1"), std::string::npos) << text;
+  EXPECT_NE(text.find("reset=1"), std::string::npos) << text;
+}
+
+TEST_F(instrumentation_test, reset) {
+  optional<only_here> a(1);
+  EXPECT_NE(optional_instrumentation::snapshot<only_here>().total(), 0);
+  optional_instrumentation::reset();
+  EXPECT_EQ(optional_instrumentation::snapshot<only_here>(), optional_counters{});
+}
+
+TEST_F(instrumentation_test, constexpr_still_works) {
+  constexpr optional<int> a = [] {
+    optional<int> x(1);
+    x.emplace(2);
+    x.reset();
+    x = 3;
+    return x;
+  }();
+  static_assert(*a == 3);
+  EXPECT_EQ(optional_instrumentation::snapshot<int>().total(), 0);
+}
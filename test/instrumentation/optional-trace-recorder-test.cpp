@@ -0,0 +1,137 @@
+#include "optional-trace-recorder.h"
+
+#include "test-object.h"
+
+#include <gtest/gtest.h>
+
+#include <optional>
+#include <sstream>
+#include <utility>
+#include <vector>
+
+namespace {
+
+struct recorded {
+  int value;
+
+  recorded(int value)
+      : value(value) {}
+
+  recorded(const recorded& other)
+      : value(other.value) {}
+
+  recorded(recorded&& other) noexcept
+      : value(other.value) {}
+
+  recorded& operator=(const recorded& other) {
+    value = other.value;
+    return *this;
+  }
+
+  recorded& operator=(recorded&& other) noexcept {
+    value = other.value;
+    return *this;
+  }
+
+  friend bool operator==(const recorded&, const recorded&) = default;
+};
+
+class optional_trace_recorder_test : public ::testing::Test {
+protected:
+  test_object::no_new_instances_guard instances_guard;
+};
+
+} // namespace
+
+TEST_F(optional_trace_recorder_test, records_operations) {
+  optional_trace_recorder<recorded> recorder;
+  {
+    optional<recorded> a(1);
+    optional<recorded> b = a;
+    optional<recorded> c;
+    c = std::move(b);
+    c.swap(a);
+    a.emplace(2);
+    b.reset();
+    c = 3;
+  }
+
+  // c is first seen being moved into, which looks the same as being move-constructed; assigning 3 to the engaged c
+  // and the destructors are not observed
+  std::vector<trace_record> expected = {
+      {trace_op::construct, 0},
+      {trace_op::copy_construct, 1, 0},
+      {trace_op::move_construct, 2, 1},
+      {trace_op::swap, 2, 0},
+      {trace_op::emplace, 0},
+      {trace_op::reset, 1},
+  };
+  optional_trace trace = recorder.trace();
+  EXPECT_EQ(trace.slots, 3);
+  EXPECT_EQ(trace.records, expected);
+}
+
+TEST_F(optional_trace_recorder_test, sink_does_not_throw) {
+  optional_trace_recorder<recorded> recorder;
+  optional_event_sink& sink = recorder;
+  static_assert(noexcept(sink.on_event(typeid(recorded), optional_event::reset, nullptr, nullptr)));
+  static_assert(noexcept(optional_instrumentation::record<recorded>(optional_event::reset, nullptr, nullptr)));
+}
+
+TEST_F(optional_trace_recorder_test, ignores_other_types) {
+  optional_trace_recorder<recorded> recorder;
+  optional<test_object> a(1);
+  a.reset();
+  EXPECT_TRUE(recorder.trace().records.empty());
+}
+
+TEST_F(optional_trace_recorder_test, assign_to_empty) {
+  optional_trace_recorder<recorded> recorder;
+  optional<recorded> a;
+  a.reset();
+  a = recorded(1);
+
+  std::vector<trace_record> expected = {
+      {trace_op::construct_empty, 0},
+      {trace_op::reset, 0},
+      {trace_op::assign, 0},
+  };
+  EXPECT_EQ(recorder.trace().records, expected);
+}
+
+TEST_F(optional_trace_recorder_test, recording_replays) {
+  optional_trace_recorder<recorded> recorder;
+  {
+    std::vector<optional<recorded>> values(8);
+    for (int i = 0; i < 100; ++i) {
+      auto& value = values[static_cast<std::size_t>(i) % values.size()];
+      if (i % 3 == 0) {
+        value.reset();
+      } else {
+        value.emplace(i);
+      }
+      values[static_cast<std::size_t>(i * 7) % values.size()].swap(value);
+    }
+  }
+
+  std::ostringstream out;
+  write_trace(out, recorder.trace());
+  std::istringstream in(out.str());
+  optional_trace trace = read_trace(in);
+  EXPECT_FALSE(trace.records.empty());
+
+  trace_replayer<optional<int>> ours(trace);
+  trace_replayer<std::optional<int>> theirs(trace);
+  EXPECT_EQ(ours.run(), theirs.run());
+}
+
+TEST_F(optional_trace_recorder_test, restores_previous_sink) {
+  optional_trace_recorder<recorded> outer;
+  {
+    optional_trace_recorder<recorded> inner;
+    optional<recorded> a(1);
+    EXPECT_EQ(inner.trace().records.size(), 1);
+  }
+  optional<recorded> b(2);
+  EXPECT_EQ(outer.trace().records.size(), 1);
+}
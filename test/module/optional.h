@@ -0,0 +1,14 @@
+#pragma once
+
+// Stands in for src/optional.h when the tests are built with OPTIONAL_USE_MODULE: the test sources keep their
+// #include "optional.h", and get the module instead. The standard headers optional.h provides are included first,
+// since the tests rely on them transitively.
+
+#include <compare>
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+import optional;
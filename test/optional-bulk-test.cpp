@@ -0,0 +1,156 @@
+#include "optional-bulk.h"
+
+#include "test-object.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace {
+
+// Trivially destructible, but copying it is observable
+struct counted_copy {
+  counted_copy(int value)
+      : value(value) {}
+
+  counted_copy(const counted_copy& other)
+      : value(other.value) {
+    ++copies;
+  }
+
+  counted_copy& operator=(const counted_copy& other) {
+    value = other.value;
+    ++copies;
+    return *this;
+  }
+
+  int value;
+
+  inline static int copies = 0;
+};
+
+class optional_bulk_test : public ::testing::Test {
+protected:
+  void SetUp() override {
+    counted_copy::copies = 0;
+  }
+
+  test_object::no_new_instances_guard instances_guard;
+};
+
+} // namespace
+
+TEST_F(optional_bulk_test, fast_path_detection) {
+  EXPECT_TRUE(detail::is_bytewise_optional_v<int>);
+  EXPECT_TRUE(detail::is_bytewise_optional_v<double*>);
+  EXPECT_FALSE(detail::is_bytewise_optional_v<const int>);
+  EXPECT_FALSE(detail::is_bytewise_optional_v<counted_copy>);
+  EXPECT_FALSE(detail::is_bytewise_optional_v<std::string>);
+  EXPECT_TRUE(std::is_trivially_destructible_v<counted_copy>);
+}
+
+TEST_F(optional_bulk_test, reset_all_trivial) {
+  std::vector<optional<int>> values = {1, nullopt, 3, 4};
+  reset_all<int>(values);
+  for (const auto& value : values) {
+    EXPECT_FALSE(value.has_value());
+  }
+}
+
+TEST_F(optional_bulk_test, reset_all_destroys) {
+  std::vector<optional<test_object>> values(3);
+  values[0].emplace(1);
+  values[2].emplace(3);
+  reset_all<test_object>(values);
+  instances_guard.expect_no_instances();
+  for (const auto& value : values) {
+    EXPECT_FALSE(value.has_value());
+  }
+}
+
+TEST_F(optional_bulk_test, reset_all_trivially_destructible) {
+  std::vector<optional<counted_copy>> values(3, counted_copy(1));
+  counted_copy::copies = 0;
+  reset_all<counted_copy>(values);
+  EXPECT_FALSE(values[0].has_value());
+  EXPECT_FALSE(values[2].has_value());
+  EXPECT_EQ(counted_copy::copies, 0);
+}
+
+TEST_F(optional_bulk_test, reset_all_subspan) {
+  std::vector<optional<int>> values = {1, 2, 3, 4};
+  reset_all(std::span<optional<int>>(values).subspan(1, 2));
+  EXPECT_EQ(values[0], 1);
+  EXPECT_FALSE(values[1].has_value());
+  EXPECT_FALSE(values[2].has_value());
+  EXPECT_EQ(values[3], 4);
+}
+
+TEST_F(optional_bulk_test, fill_trivial) {
+  std::vector<optional<int>> values(5);
+  fill<int>(values, 42);
+  for (const auto& value : values) {
+    EXPECT_EQ(value, 42);
+  }
+
+  fill<int>(values, nullopt);
+  for (const auto& value : values) {
+    EXPECT_FALSE(value.has_value());
+  }
+}
+
+TEST_F(optional_bulk_test, fill_trivial_many_blocks) {
+  std::vector<optional<std::uint64_t>> values(2049);
+  values[0] = 5;
+  fill<std::uint64_t>(values, values[0]);
+  for (const auto& value : values) {
+    EXPECT_EQ(value, 5u);
+  }
+}
+
+TEST_F(optional_bulk_test, fill_assigns_engaged) {
+  std::vector<optional<std::string>> values(2);
+  values[0] = std::string(100, 'x');
+  const char* data = values[0]->data();
+  fill<std::string>(values, std::string("abc"));
+  EXPECT_EQ(values[0], "abc");
+  EXPECT_EQ(values[1], "abc");
+  EXPECT_EQ(values[0]->data(), data);
+}
+
+TEST_F(optional_bulk_test, fill_from_element) {
+  std::vector<optional<test_object>> values(3);
+  values[1].emplace(7);
+  fill<test_object>(values, values[1]);
+  for (const auto& value : values) {
+    EXPECT_EQ(value, 7);
+  }
+}
+
+TEST_F(optional_bulk_test, emplace_all_trivial) {
+  std::vector<optional<int>> values = {1, nullopt, 3};
+  emplace_all<int>(values, 9);
+  for (const auto& value : values) {
+    EXPECT_EQ(value, 9);
+  }
+}
+
+TEST_F(optional_bulk_test, emplace_all) {
+  std::vector<optional<std::string>> values(3);
+  values[1] = "old";
+  emplace_all<std::string>(values, 3, 'x');
+  for (const auto& value : values) {
+    EXPECT_EQ(value, "xxx");
+  }
+}
+
+TEST_F(optional_bulk_test, emplace_all_empty) {
+  std::vector<optional<int>> values;
+  emplace_all<int>(values, 1);
+  reset_all<int>(values);
+  fill<int>(values, 1);
+  EXPECT_TRUE(values.empty());
+}
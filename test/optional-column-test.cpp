@@ -0,0 +1,84 @@
+#include "optional-column.h"
+
+#include "test-object.h"
+
+#include <gtest/gtest.h>
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace {
+
+class optional_column_test : public ::testing::Test {
+protected:
+  test_object::no_new_instances_guard instances_guard;
+};
+
+} // namespace
+
+TEST_F(optional_column_test, empty) {
+  optional_column<int> column;
+  EXPECT_TRUE(column.empty());
+  EXPECT_EQ(column.size(), 0);
+  EXPECT_EQ(column.count(), 0);
+  EXPECT_EQ(column.rank(0), 0);
+}
+
+TEST_F(optional_column_test, push_back) {
+  optional_column<std::string> column;
+  column.push_back(nullopt);
+  column.push_back(optional<std::string>("a"));
+  column.emplace_back(2, 'b');
+  column.push_back(optional<std::string>());
+  optional<std::string> c("c");
+  column.push_back(c);
+
+  EXPECT_EQ(column.size(), 5);
+  EXPECT_EQ(column.count(), 3);
+  EXPECT_FALSE(column.has_value(0));
+  EXPECT_TRUE(column.has_value(1));
+  EXPECT_FALSE(column.has_value(3));
+  EXPECT_EQ(column[1], "a");
+  EXPECT_EQ(column[2], "bb");
+  EXPECT_EQ(column[4], "c");
+  EXPECT_EQ(column.get(4), "c");
+  EXPECT_FALSE(column.get(3).has_value());
+
+  column[2] = "x";
+  EXPECT_EQ(column.engaged_values()[1], "x");
+}
+
+TEST_F(optional_column_test, rank_and_select) {
+  optional_column<int> column;
+  std::vector<std::size_t> rows;
+  for (int i = 0; i < 100'000; ++i) {
+    if (i % 7 == 0 || i % 11 == 0) {
+      rows.push_back(column.size());
+      column.emplace_back(i);
+    } else {
+      column.push_back(nullopt);
+    }
+  }
+  ASSERT_EQ(column.count(), rows.size());
+  for (std::size_t k = 0; k < rows.size(); ++k) {
+    ASSERT_EQ(column.select(k), rows[k]);
+    ASSERT_EQ(column.rank(rows[k]), k);
+    ASSERT_EQ(column[rows[k]], static_cast<int>(rows[k]));
+  }
+  EXPECT_EQ(column.rank(column.size()), rows.size());
+}
+
+TEST_F(optional_column_test, destroys_values) {
+  {
+    optional_column<test_object> column;
+    column.emplace_back(1);
+    column.push_back(nullopt);
+    column.push_back(optional<test_object>(3));
+    EXPECT_EQ(column[2], 3);
+    column.clear();
+    EXPECT_TRUE(column.empty());
+    column.emplace_back(4);
+  }
+  instances_guard.expect_no_instances();
+}
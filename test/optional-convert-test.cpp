@@ -0,0 +1,69 @@
+#include "optional-convert.h"
+
+#include "test-object.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+class optional_convert_test : public ::testing::Test {
+protected:
+  test_object::no_new_instances_guard instances_guard;
+};
+
+} // namespace
+
+TEST_F(optional_convert_test, widen_ints) {
+  std::vector<optional<std::int32_t>> from = {1, nullopt, -3};
+  std::vector<optional<std::int64_t>> to = {nullopt, 7, 7, 7};
+  batch_convert<std::int64_t, std::int32_t>(from, to);
+
+  EXPECT_EQ(to[0], 1);
+  EXPECT_EQ(to[1], nullopt);
+  EXPECT_EQ(to[2], -3);
+  EXPECT_EQ(to[3], 7);
+}
+
+TEST_F(optional_convert_test, views_to_strings) {
+  std::string text = "hello world";
+  std::vector<optional<std::string_view>> from = {std::string_view(text).substr(0, 5), nullopt};
+  std::vector<optional<std::string>> to(2, "old");
+  batch_convert<std::string, std::string_view>(from, to);
+
+  EXPECT_EQ(to[0], "hello");
+  EXPECT_FALSE(to[1].has_value());
+}
+
+TEST_F(optional_convert_test, move) {
+  std::vector<optional<std::string>> from = {std::string(100, 'x'), nullopt};
+  const char* data = from[0]->data();
+  std::vector<optional<std::string>> to(2);
+  batch_convert_move<std::string, std::string>(from, to);
+
+  EXPECT_EQ(to[0]->data(), data);
+  EXPECT_TRUE(from[0].has_value());
+  EXPECT_FALSE(to[1].has_value());
+}
+
+TEST_F(optional_convert_test, test_objects) {
+  std::vector<optional<int>> from = {1, nullopt, 3};
+  std::vector<optional<test_object>> to(3);
+  to[1].emplace(2);
+  batch_convert<test_object, int>(from, to);
+
+  EXPECT_EQ(*to[0], 1);
+  EXPECT_FALSE(to[1].has_value());
+  EXPECT_EQ(*to[2], 3);
+}
+
+TEST_F(optional_convert_test, empty) {
+  std::vector<optional<int>> from;
+  std::vector<optional<long>> to;
+  batch_convert<long, int>(from, to);
+  EXPECT_TRUE(to.empty());
+}
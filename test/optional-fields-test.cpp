@@ -0,0 +1,257 @@
+#include "optional-fields.h"
+
+#include "test-object.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace {
+
+struct dummy {};
+
+struct no_copy {
+  no_copy(const no_copy&) = delete;
+};
+
+struct non_trivial_copy {
+  explicit non_trivial_copy(int x) noexcept
+      : x{x} {}
+
+  non_trivial_copy(const non_trivial_copy& other) noexcept
+      : x{other.x + 1} {}
+
+  int x;
+};
+
+struct move_only {
+  move_only(const move_only&) = delete;
+  move_only(move_only&&) = default;
+
+  move_only& operator=(const move_only&) = delete;
+  move_only& operator=(move_only&&) = default;
+};
+
+struct throwing_copy {
+  throwing_copy(int value)
+      : value(value) {}
+
+  throwing_copy(const throwing_copy& other)
+      : value(other.value) {
+    if (value < 0) {
+      throw std::exception();
+    }
+  }
+
+  throwing_copy& operator=(const throwing_copy&) = default;
+
+  int value;
+};
+
+class optional_fields_test : public ::testing::Test {
+protected:
+  test_object::no_new_instances_guard instances_guard;
+};
+
+struct optional_record {
+  optional<double> a;
+  optional<char> b;
+  optional<int> c;
+};
+
+} // namespace
+
+TEST_F(optional_fields_test, layout) {
+  EXPECT_EQ(sizeof(optional_fields<double, char, int>), 16);
+  EXPECT_EQ(sizeof(optional_record), 32);
+  EXPECT_EQ(alignof(optional_fields<double, char, int>), alignof(double));
+
+  EXPECT_EQ(sizeof(optional_fields<int, int, int, int, int, int, int, int, int, int>), 44);
+  EXPECT_EQ(sizeof(optional_fields<char>), 2);
+
+  using layout = detail::fields_layout<char, double, short, int>;
+  EXPECT_EQ(layout::offsets[1], 0);
+  EXPECT_EQ(layout::offsets[3], 8);
+  EXPECT_EQ(layout::offsets[2], 12);
+  EXPECT_EQ(layout::offsets[0], 14);
+}
+
+TEST_F(optional_fields_test, traits) {
+  static_assert(std::is_trivially_destructible_v<optional_fields<int, dummy>>);
+  static_assert(!std::is_trivially_destructible_v<optional_fields<int, std::string>>);
+  static_assert(std::is_nothrow_default_constructible_v<optional_fields<int, std::string>>);
+
+  static_assert(std::is_trivially_copy_constructible_v<optional_fields<int, dummy>>);
+  static_assert(!std::is_trivially_copy_constructible_v<optional_fields<int, non_trivial_copy>>);
+  static_assert(std::is_copy_constructible_v<optional_fields<int, non_trivial_copy>>);
+  static_assert(!std::is_copy_constructible_v<optional_fields<int, no_copy>>);
+  static_assert(!std::is_copy_constructible_v<optional_fields<int, move_only>>);
+
+  static_assert(std::is_trivially_move_constructible_v<optional_fields<int, move_only>>);
+  static_assert(!std::is_trivially_move_constructible_v<optional_fields<int, std::string>>);
+  static_assert(std::is_nothrow_move_constructible_v<optional_fields<int, std::string>>);
+  static_assert(!std::is_nothrow_copy_constructible_v<optional_fields<int, std::string>>);
+
+  static_assert(std::is_trivially_copy_assignable_v<optional_fields<int, dummy>>);
+  static_assert(!std::is_trivially_copy_assignable_v<optional_fields<int, non_trivial_copy>>);
+  static_assert(!std::is_copy_assignable_v<optional_fields<int, move_only>>);
+  static_assert(!std::is_copy_assignable_v<optional_fields<const int>>);
+  static_assert(std::is_trivially_move_assignable_v<optional_fields<int, move_only>>);
+  static_assert(std::is_nothrow_move_assignable_v<optional_fields<int, std::string>>);
+  static_assert(!std::is_move_assignable_v<optional_fields<const int>>);
+
+  static_assert(std::is_trivially_copyable_v<optional_fields<int, double, char>>);
+}
+
+TEST_F(optional_fields_test, default_empty) {
+  optional_fields<int, std::string, test_object> fields;
+  EXPECT_FALSE(fields.has<0>());
+  EXPECT_FALSE(fields.has<1>());
+  EXPECT_FALSE(fields.has<2>());
+  EXPECT_FALSE(fields.any());
+  EXPECT_FALSE(fields.all());
+  EXPECT_EQ(fields.count(), 0);
+  EXPECT_EQ(fields.size(), 3);
+}
+
+TEST_F(optional_fields_test, get_and_assign) {
+  optional_fields<int, std::string, test_object> fields;
+  fields.get<0>() = 42;
+  fields.get<1>().emplace(3, 'x');
+  EXPECT_TRUE(fields.has<0>());
+  EXPECT_TRUE(fields.has<1>());
+  EXPECT_FALSE(fields.has<2>());
+  EXPECT_EQ(*fields.get<0>(), 42);
+  EXPECT_EQ(*fields.get<1>(), "xxx");
+  EXPECT_EQ(fields.get<1>()->size(), 3);
+  EXPECT_EQ(fields.count(), 2);
+
+  fields.get<1>() = "y";
+  EXPECT_EQ(*fields.get<1>(), "y");
+
+  fields.get<2>() = test_object(5);
+  EXPECT_TRUE(fields.all());
+  EXPECT_EQ(*fields.get<2>(), 5);
+
+  fields.get<2>() = nullopt;
+  fields.get<0>().reset();
+  EXPECT_FALSE(fields.has<0>());
+  EXPECT_FALSE(fields.has<2>());
+  EXPECT_EQ(fields.count(), 1);
+  instances_guard.expect_no_instances();
+}
+
+TEST_F(optional_fields_test, ref_reads) {
+  optional_fields<int, std::string> fields;
+  const auto& view = fields;
+  EXPECT_EQ(view.get<0>().value_or(7), 7);
+  EXPECT_FALSE(view.get<0>());
+
+  fields.get<0>() = 3;
+  EXPECT_TRUE(view.get<0>());
+  EXPECT_EQ(view.get<0>().value_or(7), 3);
+
+  optional<int> copy = view.get<0>();
+  EXPECT_EQ(copy, 3);
+  optional<std::string> empty = fields.get<1>();
+  EXPECT_FALSE(empty.has_value());
+
+  optional_field_ref<int, true> read = fields.get<0>();
+  EXPECT_EQ(*read, 3);
+  static_assert(std::is_same_v<decltype(*view.get<1>()), const std::string&>);
+}
+
+TEST_F(optional_fields_test, ref_assigns_through) {
+  optional_fields<std::string, std::string> fields;
+  fields.get<0>() = "a";
+  fields.get<1>() = fields.get<0>();
+  EXPECT_EQ(*fields.get<1>(), "a");
+
+  fields.get<0>() = "b";
+  EXPECT_EQ(*fields.get<1>(), "a");
+  fields.get<1>() = fields.get<0>();
+  EXPECT_EQ(*fields.get<1>(), "b");
+
+  fields.get<0>().reset();
+  fields.get<1>() = fields.get<0>();
+  EXPECT_FALSE(fields.any());
+}
+
+TEST_F(optional_fields_test, copy_and_move) {
+  {
+    optional_fields<test_object, int, test_object> a;
+    a.get<0>() = test_object(1);
+    a.get<1>() = 2;
+
+    optional_fields<test_object, int, test_object> b = a;
+    EXPECT_EQ(*b.get<0>(), 1);
+    EXPECT_EQ(*b.get<1>(), 2);
+    EXPECT_FALSE(b.has<2>());
+
+    optional_fields<test_object, int, test_object> c = std::move(b);
+    EXPECT_EQ(*c.get<0>(), 1);
+
+    c.get<0>().reset();
+    c.get<2>() = test_object(3);
+    a = c;
+    EXPECT_FALSE(a.has<0>());
+    EXPECT_EQ(*a.get<2>(), 3);
+
+    a = optional_fields<test_object, int, test_object>();
+    EXPECT_FALSE(a.any());
+  }
+  instances_guard.expect_no_instances();
+}
+
+TEST_F(optional_fields_test, copy_throws) {
+  optional_fields<test_object, throwing_copy, test_object> a;
+  a.get<0>() = test_object(1);
+  a.get<1>().emplace(-1);
+  a.get<2>() = test_object(2);
+  EXPECT_THROW((optional_fields<test_object, throwing_copy, test_object>(a)), std::exception);
+  a.reset();
+  instances_guard.expect_no_instances();
+}
+
+TEST_F(optional_fields_test, many_fields) {
+  using wide = optional_fields<
+      int, int, int, int, int, int, int, int, int, int, int, int, int, int, int, int, int, int, int, int, int, int, int,
+      int, int, int, int, int, int, int, int, int, int, int, int, int, int, int, int, int, int, int, int, int, int, int,
+      int, int, int, int, int, int, int, int, int, int, int, int, int, int, int, int, int, int, int, int, int, int, int,
+      int>;
+  static_assert(wide::size() == 70);
+
+  wide fields;
+  fields.get<0>() = 1;
+  fields.get<63>() = 2;
+  fields.get<64>() = 3;
+  fields.get<69>() = 4;
+  EXPECT_TRUE(fields.any());
+  EXPECT_EQ(fields.count(), 4);
+  EXPECT_EQ(*fields.get<64>(), 3);
+
+  fields.reset();
+  EXPECT_FALSE(fields.any());
+}
+
+TEST_F(optional_fields_test, all) {
+  optional_fields<char, std::string, double> fields;
+  fields.get<0>() = 'a';
+  fields.get<1>() = "b";
+  EXPECT_FALSE(fields.all());
+  fields.get<2>() = 1.5;
+  EXPECT_TRUE(fields.all());
+  EXPECT_EQ(fields.count(), 3);
+}
+
+TEST_F(optional_fields_test, const_field) {
+  optional_fields<const int, int> fields;
+  fields.get<0>().emplace(1);
+  EXPECT_EQ(*fields.get<0>(), 1);
+  fields.get<0>().emplace(2);
+  EXPECT_EQ(*fields.get<0>(), 2);
+  static_assert(!std::is_assignable_v<optional_field_ref<const int>, int>);
+}
@@ -0,0 +1,171 @@
+#include "optional-fill.h"
+
+#include "test-object.h"
+
+#include <gtest/gtest.h>
+
+#include <cstddef>
+#include <cstring>
+#include <new>
+#include <span>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+class optional_fill_test : public ::testing::Test {
+protected:
+  test_object::no_new_instances_guard instances_guard;
+};
+
+std::vector<optional<double>> random_series(std::size_t size, double density, std::uint64_t seed) {
+  std::mt19937_64 random(seed);
+  std::bernoulli_distribution engaged(density);
+  std::vector<optional<double>> result(size);
+  for (std::size_t i = 0; i < size; ++i) {
+    if (engaged(random)) {
+      result[i] = static_cast<double>(i);
+    }
+  }
+  return result;
+}
+
+// Last observation carried forward, the straightforward way
+std::vector<optional<double>> carried_forward(std::vector<optional<double>> values) {
+  for (std::size_t i = 1; i < values.size(); ++i) {
+    if (!values[i].has_value() && values[i - 1].has_value()) {
+      values[i] = *values[i - 1];
+    }
+  }
+  return values;
+}
+
+} // namespace
+
+TEST_F(optional_fill_test, fill_value_or_dense) {
+  std::vector<optional<double>> values = {1.5, nullopt, 3.0, nullopt};
+  std::vector<double> out(values.size());
+  fill_value_or<double>(values, out, -1.0);
+  EXPECT_EQ(out, (std::vector<double>{1.5, -1.0, 3.0, -1.0}));
+}
+
+TEST_F(optional_fill_test, fill_value_or_in_place) {
+  std::vector<optional<int>> values = {nullopt, 2, nullopt};
+  fill_value_or<int>(values, 7);
+  EXPECT_EQ(values, (std::vector<optional<int>>{7, 2, 7}));
+
+  std::vector<optional<std::string>> strings = {"a", nullopt};
+  fill_value_or<std::string>(strings, "b");
+  EXPECT_EQ(strings, (std::vector<optional<std::string>>{"a", "b"}));
+}
+
+TEST_F(optional_fill_test, forward_fill_dense) {
+  std::vector<optional<double>> values = {nullopt, 1.0, nullopt, nullopt, 4.0, nullopt};
+  std::vector<double> out(values.size());
+  forward_fill<double>(values, out, 0.0);
+  EXPECT_EQ(out, (std::vector<double>{0.0, 1.0, 1.0, 1.0, 4.0, 4.0}));
+
+  std::vector<optional<std::string>> strings = {nullopt, "a", nullopt};
+  std::vector<std::string> string_out(strings.size());
+  forward_fill<std::string>(strings, string_out, "-");
+  EXPECT_EQ(string_out, (std::vector<std::string>{"-", "a", "a"}));
+}
+
+TEST_F(optional_fill_test, forward_fill_in_place) {
+  std::vector<optional<double>> values = {nullopt, 1.0, nullopt, nullopt, 4.0, nullopt};
+  forward_fill<double>(values);
+  EXPECT_EQ(values, (std::vector<optional<double>>{nullopt, 1.0, 1.0, 1.0, 4.0, 4.0}));
+
+  auto series = random_series(10'000, 0.2, 1);
+  auto expected = carried_forward(series);
+  forward_fill<double>(series);
+  EXPECT_EQ(series, expected);
+}
+
+TEST_F(optional_fill_test, backward_fill) {
+  std::vector<optional<double>> values = {nullopt, 1.0, nullopt, nullopt, 4.0, nullopt};
+  std::vector<double> out(values.size());
+  backward_fill<double>(values, out, 9.0);
+  EXPECT_EQ(out, (std::vector<double>{1.0, 1.0, 4.0, 4.0, 4.0, 9.0}));
+
+  backward_fill<double>(values);
+  EXPECT_EQ(values, (std::vector<optional<double>>{1.0, 1.0, 4.0, 4.0, 4.0, nullopt}));
+}
+
+// Empty elements that were default-constructed over stale bytes, or reset, rather than assigned nullopt
+TEST_F(optional_fill_test, default_constructed_empty) {
+  constexpr std::size_t size = 6;
+  alignas(optional<double>) std::byte buffer[size * sizeof(optional<double>)];
+  std::memset(buffer, 0x7f, sizeof(buffer));
+  optional<double>* first = nullptr;
+  for (std::size_t i = size; i-- > 0;) {
+    first = ::new (buffer + i * sizeof(optional<double>)) optional<double>();
+  }
+  std::span<optional<double>> values(first, size);
+  values[1] = 1.0;
+  values[4] = 4.0;
+  values[5] = 5.0;
+  values[5].reset();
+
+  std::vector<double> out(size);
+  fill_value_or<double>(values, out, -1.0);
+  EXPECT_EQ(out, (std::vector<double>{-1.0, 1.0, -1.0, -1.0, 4.0, -1.0}));
+  forward_fill<double>(values, out, 0.0);
+  EXPECT_EQ(out, (std::vector<double>{0.0, 1.0, 1.0, 1.0, 4.0, 4.0}));
+  backward_fill<double>(values, out, 9.0);
+  EXPECT_EQ(out, (std::vector<double>{1.0, 1.0, 4.0, 4.0, 4.0, 9.0}));
+
+  forward_fill<double>(values);
+  EXPECT_FALSE(values[0].has_value());
+  EXPECT_EQ(values[3], 1.0);
+  EXPECT_EQ(values[5], 4.0);
+  fill_value_or<double>(values, -1.0);
+  EXPECT_EQ(values[0], -1.0);
+}
+
+TEST_F(optional_fill_test, test_objects) {
+  {
+    std::vector<optional<test_object>> values(5);
+    values[1].emplace(1);
+    values[3].emplace(3);
+    forward_fill<test_object>(values);
+    EXPECT_FALSE(values[0].has_value());
+    EXPECT_EQ(*values[2], 1);
+    EXPECT_EQ(*values[4], 3);
+
+    values[0].reset();
+    values[4].reset();
+    backward_fill<test_object>(values);
+    EXPECT_EQ(*values[0], 1);
+    EXPECT_FALSE(values[4].has_value());
+
+    fill_value_or<test_object>(values, test_object(8));
+    EXPECT_EQ(*values[4], 8);
+  }
+  instances_guard.expect_no_instances();
+}
+
+TEST_F(optional_fill_test, parallel_forward_fill_in_place) {
+  for (double density : {0.0, 0.00001, 0.01, 0.5}) {
+    for (std::size_t threads : {1, 2, 3, 8}) {
+      auto series = random_series(1'000'003, density, 2);
+      auto expected = carried_forward(series);
+      parallel_forward_fill<double>(series, threads);
+      ASSERT_EQ(series, expected) << density << ' ' << threads;
+    }
+  }
+}
+
+TEST_F(optional_fill_test, parallel_forward_fill_dense) {
+  for (double density : {0.0, 0.00001, 0.01, 0.5}) {
+    auto series = random_series(1'000'003, density, 3);
+    std::vector<double> expected(series.size());
+    forward_fill<double>(series, expected, -1.0);
+    for (std::size_t threads : {2, 5}) {
+      std::vector<double> out(series.size());
+      parallel_forward_fill<double>(series, out, -1.0, threads);
+      ASSERT_EQ(out, expected) << density << ' ' << threads;
+    }
+  }
+}
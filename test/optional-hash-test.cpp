@@ -0,0 +1,141 @@
+#include "optional-hash.h"
+
+#include <gtest/gtest.h>
+
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace {
+
+struct unhashable {};
+
+} // namespace
+
+TEST(optional_hash_test, traits) {
+  EXPECT_TRUE(std::is_default_constructible_v<std::hash<optional<int>>>);
+  EXPECT_TRUE(std::is_default_constructible_v<std::hash<optional<const int>>>);
+  EXPECT_TRUE(std::is_default_constructible_v<std::hash<optional<std::string>>>);
+  EXPECT_TRUE((std::is_nothrow_invocable_v<std::hash<optional<int>>, const optional<int>&>));
+
+  EXPECT_FALSE(std::is_default_constructible_v<std::hash<optional<unhashable>>>);
+  EXPECT_FALSE(std::is_copy_constructible_v<std::hash<optional<unhashable>>>);
+  EXPECT_FALSE((std::is_invocable_v<std::hash<optional<unhashable>>, const optional<unhashable>&>));
+}
+
+TEST(optional_hash_test, engaged_matches_value_hash) {
+  EXPECT_EQ(std::hash<optional<int>>{}(42), std::hash<int>{}(42));
+  EXPECT_EQ(std::hash<optional<const int>>{}(-7), std::hash<int>{}(-7));
+  EXPECT_EQ(std::hash<optional<std::string>>{}(std::string("abc")), std::hash<std::string>{}("abc"));
+}
+
+TEST(optional_hash_test, empty_is_stable) {
+  optional<int> a;
+  optional<int> b = 1;
+  b.reset();
+  EXPECT_EQ(std::hash<optional<int>>{}(a), std::hash<optional<int>>{}(b));
+  EXPECT_EQ(std::hash<optional<int>>{}(a), std::hash<optional<long>>{}(nullopt));
+}
+
+TEST(optional_hash_test, unordered_containers) {
+  std::unordered_set<optional<int>> set;
+  set.insert(1);
+  set.insert(nullopt);
+  set.insert(1);
+  set.insert(optional<int>());
+  EXPECT_EQ(set.size(), 2);
+  EXPECT_TRUE(set.contains(1));
+  EXPECT_TRUE(set.contains(nullopt));
+  EXPECT_FALSE(set.contains(2));
+
+  std::unordered_map<optional<std::string>, int> map;
+  map[std::string("x")] = 1;
+  map[nullopt] = 2;
+  EXPECT_EQ(map.at(std::string("x")), 1);
+  EXPECT_EQ(map.at(nullopt), 2);
+}
+
+TEST(optional_hash_test, hash_mix_constexpr) {
+  static_assert(hash_mix(0) == 0);
+  static_assert(hash_mix(1) != hash_mix(2));
+}
+
+TEST(optional_hash_test, batch_matches_single) {
+  std::vector<optional<std::int32_t>> values;
+  for (std::int32_t i = -1000; i < 1000; ++i) {
+    if (i % 3 == 0) {
+      values.emplace_back(nullopt);
+    } else {
+      values.emplace_back(i);
+    }
+  }
+
+  std::vector<std::uint64_t> hashes(values.size());
+  batch_hash<std::int32_t>(values, hashes);
+  for (std::size_t i = 0; i < values.size(); ++i) {
+    EXPECT_EQ(hashes[i], mixed_hash(values[i])) << "at index " << i;
+  }
+}
+
+TEST(optional_hash_test, batch_non_integral) {
+  std::vector<optional<std::string>> values = {std::string("a"), nullopt, std::string("bc"), nullopt};
+  std::vector<std::uint64_t> hashes(values.size());
+  batch_hash<std::string>(values, hashes);
+  for (std::size_t i = 0; i < values.size(); ++i) {
+    EXPECT_EQ(hashes[i], hash_mix(std::hash<optional<std::string>>{}(values[i])));
+  }
+  EXPECT_EQ(hashes[1], hashes[3]);
+}
+
+TEST(optional_hash_test, batch_empty_input) {
+  std::vector<optional<int>> values;
+  std::vector<std::uint64_t> hashes;
+  batch_hash<int>(values, hashes);
+  SUCCEED();
+}
+
+TEST(optional_hash_test, sequential_keys_distribution) {
+  // Sequential keys are the worst case for an identity std::hash; after mixing, the low bits should be uniform
+  constexpr std::size_t bucket_count = 256;
+  constexpr std::size_t key_count = bucket_count * 256;
+
+  std::vector<optional<std::uint32_t>> values;
+  for (std::uint32_t i = 0; i < key_count; ++i) {
+    values.emplace_back(i);
+  }
+  std::vector<std::uint64_t> hashes(values.size());
+  batch_hash<std::uint32_t>(values, hashes);
+
+  std::array<std::size_t, bucket_count> buckets{};
+  for (auto h : hashes) {
+    ++buckets[h % bucket_count];
+  }
+
+  double expected = static_cast<double>(key_count) / bucket_count;
+  double chi_square = 0;
+  for (auto observed : buckets) {
+    double diff = static_cast<double>(observed) - expected;
+    chi_square += diff * diff / expected;
+  }
+  // 255 degrees of freedom: the 99.9th percentile is about 330
+  EXPECT_LT(chi_square, 330.0);
+}
+
+TEST(optional_hash_test, avalanche) {
+  // Flipping one input bit should flip about half of the output bits
+  constexpr int samples = 1000;
+  double total = 0;
+  for (std::uint64_t x = 1; x <= samples; ++x) {
+    for (int bit = 0; bit < 64; ++bit) {
+      std::uint64_t input = x * 0x9e3779b97f4a7c15ull;
+      total += std::popcount(hash_mix(input) ^ hash_mix(input ^ (1ull << bit)));
+    }
+  }
+  double mean = total / (samples * 64);
+  EXPECT_NEAR(mean, 32.0, 0.5);
+}
@@ -0,0 +1,187 @@
+#include "optional-mailbox.h"
+
+#include "test-object.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+class optional_mailbox_test : public ::testing::Test {
+protected:
+  test_object::no_new_instances_guard instances_guard;
+};
+
+struct throwing_value {
+  explicit throwing_value(bool fail) {
+    if (fail) {
+      throw std::runtime_error("throwing_value");
+    }
+  }
+};
+
+} // namespace
+
+TEST_F(optional_mailbox_test, read_latest) {
+  optional_mailbox<std::string> mailbox;
+  auto reader = mailbox.make_reader();
+  ASSERT_TRUE(reader.has_value());
+
+  EXPECT_TRUE(reader->changed());
+  EXPECT_FALSE(reader->read().has_value());
+  EXPECT_FALSE(reader->changed());
+
+  mailbox.emplace("first");
+  mailbox.emplace("second");
+  EXPECT_TRUE(reader->changed());
+  EXPECT_EQ(reader->read(), "second");
+
+  mailbox.reset();
+  EXPECT_FALSE(reader->read().has_value());
+}
+
+TEST_F(optional_mailbox_test, unchanged_read_is_not_a_copy) {
+  optional_mailbox<std::vector<int>> mailbox;
+  auto reader = mailbox.make_reader();
+  mailbox.emplace(1000, 7);
+
+  const optional<std::vector<int>>& first = reader->read();
+  const int* data = first->data();
+  const optional<std::vector<int>>& second = reader->read();
+  EXPECT_EQ(&first, &second);
+  EXPECT_EQ(second->data(), data);
+}
+
+TEST_F(optional_mailbox_test, reader_limit) {
+  optional_mailbox<int> mailbox(2);
+  auto a = mailbox.make_reader();
+  auto b = mailbox.make_reader();
+  ASSERT_TRUE(a && b);
+  EXPECT_FALSE(mailbox.make_reader().has_value());
+
+  a.reset();
+  auto c = mailbox.make_reader();
+  EXPECT_TRUE(c.has_value());
+
+  auto moved = std::move(*c);
+  mailbox.emplace(5);
+  EXPECT_EQ(moved.read(), 5);
+}
+
+TEST_F(optional_mailbox_test, held_buffers_are_not_reused) {
+  optional_mailbox<std::string> mailbox(2);
+  auto a = mailbox.make_reader();
+  auto b = mailbox.make_reader();
+
+  mailbox.emplace("a");
+  const auto& held_by_a = a->read();
+  mailbox.emplace("b");
+  const auto& held_by_b = b->read();
+
+  for (int i = 0; i < 100; ++i) {
+    EXPECT_NE(&mailbox.back(), &held_by_a);
+    EXPECT_NE(&mailbox.back(), &held_by_b);
+    mailbox.emplace(std::to_string(i));
+  }
+  EXPECT_EQ(held_by_a, "a");
+  EXPECT_EQ(held_by_b, "b");
+  EXPECT_EQ(a->read(), "99");
+}
+
+TEST_F(optional_mailbox_test, back_buffer_reuse) {
+  optional_mailbox<std::vector<int>> mailbox;
+  auto reader = mailbox.make_reader();
+  for (int i = 0; i < 10; ++i) {
+    auto& back = mailbox.back();
+    if (!back.has_value()) {
+      back.emplace();
+    }
+    back->assign(static_cast<std::size_t>(i), i);
+    mailbox.publish();
+    EXPECT_EQ(reader->read(), std::vector<int>(static_cast<std::size_t>(i), i));
+  }
+}
+
+TEST_F(optional_mailbox_test, throwing_emplace_publishes_nothing) {
+  optional_mailbox<throwing_value> mailbox;
+  auto reader = mailbox.make_reader();
+  mailbox.emplace(false);
+  reader->read();
+  EXPECT_THROW(mailbox.emplace(true), std::runtime_error);
+  EXPECT_FALSE(reader->changed());
+  EXPECT_TRUE(reader->read().has_value());
+}
+
+TEST_F(optional_mailbox_test, test_objects) {
+  {
+    optional_mailbox<test_object> mailbox(3);
+    auto reader = mailbox.make_reader();
+    for (int i = 0; i < 10; ++i) {
+      mailbox.emplace(i);
+    }
+    EXPECT_EQ(reader->read(), 9);
+  }
+  instances_guard.expect_no_instances();
+}
+
+// Every published vector holds its own publication number n, repeated n % 64 + 1 times: a torn or reused buffer would
+// show up as a mix of numbers or a wrong length
+TEST_F(optional_mailbox_test, stress) {
+  constexpr std::size_t readers = 3;
+  constexpr int publications = 20'000;
+
+  optional_mailbox<std::vector<int>> mailbox(readers);
+  std::atomic<bool> done = false;
+  std::atomic<std::size_t> failures = 0;
+
+  std::vector<std::thread> threads;
+  for (std::size_t r = 0; r < readers; ++r) {
+    threads.emplace_back([&] {
+      auto reader = mailbox.make_reader();
+      if (!reader) {
+        ++failures;
+        return;
+      }
+      int last = -1;
+      for (bool finished = false; !finished;) {
+        finished = done.load();
+        const auto& value = reader->read();
+        if (!value.has_value()) {
+          continue;
+        }
+        int n = value->front();
+        bool consistent = value->size() == static_cast<std::size_t>(n % 64 + 1);
+        for (int element : *value) {
+          consistent &= element == n;
+        }
+        if (!consistent || n < last) {
+          ++failures;
+        }
+        last = n;
+      }
+      if (last != publications - 1) {
+        ++failures;
+      }
+    });
+  }
+
+  for (int n = 0; n < publications; ++n) {
+    auto& back = mailbox.back();
+    if (!back.has_value()) {
+      back.emplace();
+    }
+    back->assign(static_cast<std::size_t>(n % 64 + 1), n);
+    mailbox.publish();
+  }
+  done = true;
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(failures, 0);
+}
@@ -0,0 +1,161 @@
+#include "optional-pool.h"
+
+#include "test-object.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+namespace {
+
+class optional_pool_test : public ::testing::Test {
+protected:
+  test_object::no_new_instances_guard instances_guard;
+};
+
+} // namespace
+
+TEST_F(optional_pool_test, acquire_release) {
+  optional_pool<test_object> pool(3);
+  EXPECT_EQ(pool.capacity(), 3);
+  EXPECT_EQ(pool.size(), 0);
+
+  auto a = pool.acquire(1);
+  auto b = pool.acquire(2);
+  auto c = pool.acquire(3);
+  ASSERT_TRUE(a && b && c);
+  EXPECT_TRUE(pool.full());
+  EXPECT_FALSE(pool.acquire(4).has_value());
+
+  EXPECT_EQ(pool[*a], 1);
+  EXPECT_EQ(pool[*b], 2);
+  EXPECT_EQ(pool[*c], 3);
+
+  pool.release(*b);
+  EXPECT_FALSE(pool.contains(*b));
+  EXPECT_EQ(pool.size(), 2);
+
+  auto d = pool.acquire(4);
+  ASSERT_TRUE(d.has_value());
+  EXPECT_EQ(*d, *b);
+  EXPECT_EQ(pool[*d], 4);
+
+  pool.release(*a);
+  pool.release(*c);
+  pool.release(*d);
+  EXPECT_EQ(pool.size(), 0);
+  instances_guard.expect_no_instances();
+}
+
+TEST_F(optional_pool_test, lifo_reuse) {
+  optional_pool<std::string> pool(8);
+  std::vector<std::uint32_t> indices;
+  for (int i = 0; i < 8; ++i) {
+    indices.push_back(*pool.acquire(std::to_string(i)));
+  }
+  for (auto i : indices) {
+    pool.release(i);
+  }
+  for (auto it = indices.rbegin(); it != indices.rend(); ++it) {
+    EXPECT_EQ(*pool.acquire("x"), *it);
+  }
+}
+
+TEST_F(optional_pool_test, acquire_throw) {
+  struct throwing_ctor {
+    throwing_ctor(bool should_throw) {
+      if (should_throw) {
+        throw std::exception();
+      }
+    }
+
+    int padding;
+  };
+
+  optional_pool<throwing_ctor> pool(1);
+  EXPECT_THROW(pool.acquire(true), std::exception);
+  EXPECT_EQ(pool.size(), 0);
+  EXPECT_TRUE(pool.acquire(false).has_value());
+}
+
+TEST_F(optional_pool_test, slot_map_insert_throw) {
+  struct throwing_ctor {
+    throwing_ctor(bool should_throw) {
+      if (should_throw) {
+        throw std::exception();
+      }
+    }
+
+    int padding;
+  };
+
+  optional_slot_map<throwing_ctor> map;
+  EXPECT_THROW(map.insert(true), std::exception);
+  EXPECT_EQ(map.size(), 0);
+  EXPECT_FALSE(map.contains({0, 0}));
+
+  auto a = map.insert(false);
+  EXPECT_EQ(a.index, 0);
+  EXPECT_TRUE(map.contains(a));
+  auto b = map.insert(false);
+  EXPECT_EQ(b.index, 1);
+
+  // Reusing a free slot
+  EXPECT_TRUE(map.erase(a));
+  EXPECT_THROW(map.insert(true), std::exception);
+  auto c = map.insert(false);
+  EXPECT_EQ(c.index, a.index);
+  EXPECT_NE(c, a);
+  EXPECT_EQ(map.size(), 2);
+}
+
+TEST_F(optional_pool_test, slot_map_insert_erase) {
+  optional_slot_map<test_object> map;
+  auto a = map.insert(1);
+  auto b = map.insert(2);
+  EXPECT_EQ(map.size(), 2);
+  EXPECT_EQ(*map.get(a), 1);
+  EXPECT_EQ(*map.get(b), 2);
+
+  EXPECT_TRUE(map.erase(a));
+  EXPECT_FALSE(map.erase(a));
+  EXPECT_FALSE(map.contains(a));
+  EXPECT_EQ(map.get(a), nullptr);
+
+  auto c = map.insert(3);
+  EXPECT_EQ(c.index, a.index);
+  EXPECT_NE(c, a);
+  EXPECT_EQ(map.get(a), nullptr);
+  EXPECT_EQ(*map.get(c), 3);
+  EXPECT_EQ(*map.get(b), 2);
+}
+
+TEST_F(optional_pool_test, slot_map_stable_handles) {
+  optional_slot_map<std::string> map;
+  std::vector<optional_slot_map<std::string>::handle> handles;
+  for (int i = 0; i < 1000; ++i) {
+    handles.push_back(map.insert(std::to_string(i)));
+  }
+  for (int i = 0; i < 1000; i += 2) {
+    EXPECT_TRUE(map.erase(handles[i]));
+  }
+  for (int i = 0; i < 2000; ++i) {
+    map.insert("new");
+  }
+  for (int i = 0; i < 1000; ++i) {
+    if (i % 2 == 0) {
+      EXPECT_FALSE(map.contains(handles[i]));
+    } else {
+      ASSERT_NE(map.get(handles[i]), nullptr);
+      EXPECT_EQ(*map.get(handles[i]), std::to_string(i));
+    }
+  }
+  EXPECT_EQ(map.size(), 2500);
+}
+
+TEST_F(optional_pool_test, slot_map_out_of_range) {
+  optional_slot_map<int> map;
+  EXPECT_FALSE(map.contains({42, 0}));
+  EXPECT_FALSE(map.erase({42, 0}));
+}
@@ -2,8 +2,15 @@
 
 #include "test-object.h"
 
+#include <gtest/gtest-spi.h>
 #include <gtest/gtest.h>
 
+#include <compare>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
 namespace {
 
 struct only_copy_constructible : test_object {
@@ -74,7 +81,7 @@ protected:
     only_copyable::copy_ctor_calls = 0;
     only_copyable::copy_assign_calls = 0;
     only_movable::move_ctor_calls = 0;
-    only_movable::move_ctor_calls = 0;
+    only_movable::move_assign_calls = 0;
   }
 
   test_object::no_new_instances_guard instances_guard;
@@ -147,6 +154,43 @@ TEST_F(optional_test, dereference) {
   EXPECT_EQ(*std::move(std::as_const(a)), 42);
 }
 
+TEST_F(optional_test, checked_value) {
+  optional<test_object> a(42);
+  EXPECT_EQ(a.value(), 42);
+  EXPECT_EQ(std::as_const(a).value(), 42);
+  EXPECT_EQ(std::move(a).value(), 42);
+  EXPECT_EQ(std::move(std::as_const(a)).value(), 42);
+  EXPECT_EQ(&a.value(), &*a);
+
+  static_assert(std::is_same_v<decltype(a.value()), test_object&>);
+  static_assert(std::is_same_v<decltype(std::as_const(a).value()), const test_object&>);
+  static_assert(std::is_same_v<decltype(std::move(a).value()), test_object&&>);
+  static_assert(std::is_same_v<decltype(std::move(std::as_const(a)).value()), const test_object&&>);
+
+  a.value() = 43;
+  EXPECT_EQ(*a, 43);
+}
+
+TEST_F(optional_test, checked_value_empty) {
+  optional<test_object> a;
+  EXPECT_THROW(a.value(), bad_optional_access);
+  EXPECT_THROW(std::as_const(a).value(), bad_optional_access);
+  EXPECT_THROW(std::move(a).value(), bad_optional_access);
+  EXPECT_THROW(std::move(std::as_const(a)).value(), bad_optional_access);
+  EXPECT_THROW(a.value(), std::exception);
+  EXPECT_STREQ(bad_optional_access().what(), "bad optional access");
+}
+
+TEST_F(optional_test, checked_value_constexpr) {
+  constexpr optional<int> a(42);
+  static_assert(a.value() == 42);
+  static_assert([] {
+    optional<int> b(1);
+    b.value() += 1;
+    return std::move(b).value();
+  }() == 2);
+}
+
 TEST_F(optional_test, member_access) {
   optional<test_object> a(42);
   EXPECT_EQ(a->operator int(), 42);
@@ -364,6 +408,182 @@ TEST_F(optional_test, value_assignment) {
   EXPECT_EQ(*a, 1337);
 }
 
+namespace {
+
+// Holds an only_movable, constructed from one with a single move
+struct holds_movable {
+  holds_movable(only_movable&& other)
+      : value(std::move(other)) {}
+
+  holds_movable& operator=(only_movable&& other) {
+    value = std::move(other);
+    return *this;
+  }
+
+  only_movable value;
+};
+
+} // namespace
+
+TEST_F(optional_test, converting_ctor) {
+  optional<short> a(42);
+  optional<int> b = a;
+  EXPECT_TRUE(b.has_value());
+  EXPECT_EQ(*b, 42);
+
+  optional<short> c;
+  optional<int> d = c;
+  EXPECT_FALSE(d.has_value());
+
+  optional<std::string_view> e("hello");
+  optional<std::string> f(e);
+  EXPECT_TRUE(f.has_value());
+  EXPECT_EQ(*f, "hello");
+}
+
+TEST_F(optional_test, converting_ctor_explicit) {
+  EXPECT_TRUE((std::is_convertible_v<const optional<short>&, optional<int>>));
+  EXPECT_TRUE((std::is_convertible_v<optional<const char*>&&, optional<std::string>>));
+  EXPECT_TRUE((std::is_constructible_v<optional<std::string>, const optional<std::string_view>&>));
+  EXPECT_FALSE((std::is_convertible_v<const optional<std::string_view>&, optional<std::string>>));
+  EXPECT_FALSE((std::is_constructible_v<optional<std::string>, const optional<int>&>));
+}
+
+TEST_F(optional_test, converting_ctor_to_bool) {
+  optional<int> zero(0);
+  optional<bool> a = zero;
+  EXPECT_TRUE(a.has_value());
+  EXPECT_FALSE(*a);
+
+  optional<int> empty;
+  optional<bool> b = empty;
+  EXPECT_FALSE(b.has_value());
+}
+
+TEST_F(optional_test, converting_move_ctor_moves_once) {
+  optional<only_movable> a(in_place, 42);
+  optional<holds_movable> b = std::move(a);
+  EXPECT_TRUE(b.has_value());
+  EXPECT_EQ(b->value, 42);
+  EXPECT_TRUE(a.has_value());
+  EXPECT_EQ(only_movable::move_ctor_calls, 1);
+  EXPECT_EQ(only_movable::move_assign_calls, 0);
+}
+
+TEST_F(optional_test, converting_assignment) {
+  optional<int> a;
+  optional<short> b(42);
+  a = b;
+  EXPECT_TRUE(a.has_value());
+  EXPECT_EQ(*a, 42);
+
+  b = 43;
+  a = b;
+  EXPECT_EQ(*a, 43);
+
+  b.reset();
+  a = b;
+  EXPECT_FALSE(a.has_value());
+
+  optional<std::string> s("long enough to live on the heap, not in the small buffer");
+  const char* data = s->data();
+  s = optional<std::string_view>("reused");
+  EXPECT_EQ(*s, "reused");
+  EXPECT_EQ(s->data(), data);
+}
+
+TEST_F(optional_test, converting_move_assignment_moves_once) {
+  optional<holds_movable> a;
+  optional<only_movable> b(in_place, 42);
+  a = std::move(b);
+  EXPECT_EQ(a->value, 42);
+  EXPECT_EQ(only_movable::move_ctor_calls, 1);
+  EXPECT_EQ(only_movable::move_assign_calls, 0);
+
+  optional<only_movable> c(in_place, 43);
+  a = std::move(c);
+  EXPECT_EQ(a->value, 43);
+  EXPECT_EQ(only_movable::move_ctor_calls, 1);
+  EXPECT_EQ(only_movable::move_assign_calls, 1);
+
+  optional<only_movable> d;
+  a = std::move(d);
+  EXPECT_FALSE(a.has_value());
+}
+
+TEST_F(optional_test, converting_constexpr) {
+  constexpr optional<short> a(42);
+  constexpr optional<long> b = a;
+  static_assert(b.has_value() && *b == 42);
+  static_assert([] {
+    optional<long> x;
+    x = optional<int>(7);
+    return *x;
+  }() == 7);
+}
+
+TEST_F(optional_test, value_assignment_reuses_value) {
+  optional<std::vector<int>> a(std::vector<int>(100, 1));
+  const int* data = a->data();
+  std::vector<int> b(50, 2);
+  a = b;
+  EXPECT_EQ(*a, b);
+  EXPECT_EQ(a->data(), data);
+}
+
+TEST_F(optional_test, copy_assignment_reuses_value) {
+  optional<std::string> a(std::string(100, 'a'));
+  const char* data = a->data();
+  optional<std::string> b(std::string(50, 'b'));
+  a = b;
+  EXPECT_EQ(*a, *b);
+  EXPECT_EQ(a->data(), data);
+}
+
+TEST_F(optional_test, assign_or_emplace) {
+  optional<only_copyable> a;
+  only_copyable x(42);
+
+  only_copyable& result = a.assign_or_emplace(x);
+  EXPECT_EQ(&result, &*a);
+  EXPECT_EQ(*a, 42);
+  EXPECT_EQ(only_copyable::copy_ctor_calls, 1);
+  EXPECT_EQ(only_copyable::copy_assign_calls, 0);
+
+  only_copyable y(43);
+  a.assign_or_emplace(y);
+  EXPECT_EQ(*a, 43);
+  EXPECT_EQ(only_copyable::copy_ctor_calls, 1);
+  EXPECT_EQ(only_copyable::copy_assign_calls, 1);
+}
+
+TEST_F(optional_test, assign_or_emplace_reuses_value) {
+  optional<std::string> a;
+  a.assign_or_emplace(100, 'a');
+  const char* data = a->data();
+  a.assign_or_emplace("short");
+  EXPECT_EQ(*a, "short");
+  EXPECT_EQ(a->data(), data);
+}
+
+TEST_F(optional_test, assign_or_emplace_not_assignable) {
+  optional<only_move_constructible> a(in_place, 1);
+  a.assign_or_emplace(2);
+  EXPECT_EQ(*a, 2);
+
+  // more than one argument always goes through emplace
+  optional<std::string> b("abc");
+  b.assign_or_emplace(3, 'x');
+  EXPECT_EQ(*b, "xxx");
+
+  static_assert([] {
+    optional<int> c;
+    c.assign_or_emplace(1);
+    c.assign_or_emplace(2);
+    return *c;
+  }() == 2);
+}
+
 TEST_F(optional_test, swap_non_empty) {
   optional<test_object> a(42);
   optional<test_object> b(55);
@@ -406,6 +626,56 @@ TEST_F(optional_test, swap_empty_both) {
 
 namespace {
 
+// Every special member and modifier, with the guard checking the destructors too on the way out
+template <typename T>
+void expect_no_allocations() {
+  no_allocations_guard allocations_guard;
+
+  optional<T> empty;
+  optional<T> also_empty(nullopt);
+  optional<T> a(1);
+  optional<T> b(in_place, 2);
+
+  optional<T> copy = a;
+  optional<T> moved = std::move(copy);
+  copy = b;
+  copy = std::move(moved);
+  copy = empty;
+  copy = 3;
+  copy = nullopt;
+
+  swap(a, b);
+  swap(a, empty);
+  a.swap(also_empty);
+
+  b.emplace(4);
+  b.reset();
+  b.emplace(5);
+  EXPECT_EQ(*b, 5);
+
+  allocations_guard.expect_no_allocations();
+}
+
+} // namespace
+
+TEST_F(optional_test, no_allocations) {
+  expect_no_allocations<int>();
+  expect_no_allocations<test_object>();
+  instances_guard.expect_no_instances();
+}
+
+TEST_F(optional_test, no_allocations_guard_detects_allocations) {
+  EXPECT_NONFATAL_FAILURE(
+      {
+        no_allocations_guard allocations_guard;
+        optional<std::string> a(std::string(100, 'x'));
+      },
+      "operator new was called"
+  );
+}
+
+namespace {
+
 struct custom_swap {
   custom_swap(int value) noexcept
       : value(value) {}
@@ -485,6 +755,107 @@ TEST_F(optional_test, emplace_throw) {
   EXPECT_FALSE(a.has_value());
 }
 
+namespace {
+
+struct non_movable {
+  explicit non_movable(int value)
+      : value(value) {}
+
+  non_movable(const non_movable&) = delete;
+  non_movable& operator=(const non_movable&) = delete;
+
+  int value;
+};
+
+template <typename T, typename F>
+constexpr bool can_emplace_with = requires(optional<T> opt, F f) { opt.emplace_with(f); };
+
+} // namespace
+
+TEST_F(optional_test, emplace_with) {
+  optional<only_movable> a(in_place, 1);
+  only_movable& result = a.emplace_with([] { return only_movable(42); });
+  EXPECT_EQ(&result, &*a);
+  EXPECT_EQ(*a, 42);
+  EXPECT_EQ(only_movable::move_ctor_calls, 0);
+  EXPECT_EQ(only_movable::move_assign_calls, 0);
+}
+
+TEST_F(optional_test, emplace_with_non_movable) {
+  optional<non_movable> a;
+  a.emplace_with([] { return non_movable(42); });
+  EXPECT_EQ(a->value, 42);
+
+  a.emplace_with([] { return non_movable(43); });
+  EXPECT_EQ(a->value, 43);
+}
+
+TEST_F(optional_test, emplace_with_conversion) {
+  optional<test_object> a;
+  a.emplace_with([] { return 42; });
+  EXPECT_EQ(*a, 42);
+
+  EXPECT_FALSE((can_emplace_with<test_object, void (*)()>));
+  EXPECT_FALSE((can_emplace_with<test_object, std::string (*)()>));
+}
+
+TEST_F(optional_test, emplace_with_throw) {
+  struct exception : std::exception {};
+
+  optional<test_object> a(42);
+  EXPECT_THROW(a.emplace_with([]() -> test_object { throw exception(); }), exception);
+  EXPECT_FALSE(a.has_value());
+}
+
+TEST_F(optional_test, take) {
+  optional<only_movable> a(in_place, 42);
+  optional<only_movable> b = a.take();
+  EXPECT_FALSE(a.has_value());
+  EXPECT_TRUE(b.has_value());
+  EXPECT_EQ(*b, 42);
+  EXPECT_EQ(only_movable::move_ctor_calls, 1);
+  EXPECT_EQ(only_movable::move_assign_calls, 0);
+
+  optional<only_movable> c = a.take();
+  EXPECT_FALSE(c.has_value());
+  EXPECT_EQ(only_movable::move_ctor_calls, 1);
+}
+
+TEST_F(optional_test, replace) {
+  optional<only_movable> a;
+  optional<only_movable> old = a.replace(only_movable(1));
+  EXPECT_FALSE(old.has_value());
+  EXPECT_EQ(*a, 1);
+  EXPECT_EQ(only_movable::move_ctor_calls, 1);
+
+  optional<only_movable> previous = a.replace(only_movable(2));
+  EXPECT_EQ(*previous, 1);
+  EXPECT_EQ(*a, 2);
+  EXPECT_EQ(only_movable::move_ctor_calls, 2);
+  EXPECT_EQ(only_movable::move_assign_calls, 1);
+}
+
+TEST_F(optional_test, replace_not_assignable) {
+  optional<only_move_constructible> a(in_place, 1);
+  optional<only_move_constructible> old = a.replace(2);
+  EXPECT_EQ(*old, 1);
+  EXPECT_EQ(*a, 2);
+}
+
+TEST_F(optional_test, take_replace_emplace_with_constexpr) {
+  static_assert([] {
+    optional<int> a(1);
+    optional<int> b = a.take();
+    optional<int> c = b.replace(2);
+    a.emplace_with([] { return 3; });
+    return *b == 2 && *c == 1 && *a == 3;
+  }());
+  static_assert([] {
+    optional<int> a;
+    return !a.take().has_value() && !a.has_value();
+  }());
+}
+
 TEST_F(optional_test, copy_assignment_throw) {
   struct throwing_copy {
     struct exception : std::exception {
@@ -674,6 +1045,140 @@ TEST_F(optional_test, comparison_three_way) {
   static_assert(std::is_lt(optional<int>{1} <=> optional<int>{2}));
 }
 
+TEST_F(optional_test, comparison_with_nullopt) {
+  optional<int> a(42);
+  optional<int> b;
+
+  EXPECT_FALSE(a == nullopt);
+  EXPECT_TRUE(a != nullopt);
+  EXPECT_FALSE(a < nullopt);
+  EXPECT_FALSE(a <= nullopt);
+  EXPECT_TRUE(a > nullopt);
+  EXPECT_TRUE(a >= nullopt);
+
+  EXPECT_FALSE(nullopt == a);
+  EXPECT_TRUE(nullopt != a);
+  EXPECT_TRUE(nullopt < a);
+  EXPECT_TRUE(nullopt <= a);
+  EXPECT_FALSE(nullopt > a);
+  EXPECT_FALSE(nullopt >= a);
+
+  EXPECT_TRUE(b == nullopt);
+  EXPECT_TRUE(nullopt == b);
+  EXPECT_TRUE(b <= nullopt);
+  EXPECT_TRUE(nullopt >= b);
+  EXPECT_FALSE(b < nullopt);
+  EXPECT_FALSE(nullopt < b);
+
+  static_assert(optional<int>{} == nullopt);
+  static_assert(std::is_gt(optional<int>{1} <=> nullopt));
+  static_assert(std::is_lt(nullopt <=> optional<int>{1}));
+  static_assert(noexcept(optional<test_object>{} == nullopt));
+}
+
+TEST_F(optional_test, comparison_with_value) {
+  optional<int> a(42);
+  optional<int> b;
+
+  EXPECT_TRUE(a == 42);
+  EXPECT_FALSE(a != 42);
+  EXPECT_TRUE(a < 43);
+  EXPECT_TRUE(a <= 42);
+  EXPECT_TRUE(a > 41);
+  EXPECT_TRUE(a >= 42);
+
+  EXPECT_TRUE(42 == a);
+  EXPECT_FALSE(42 != a);
+  EXPECT_TRUE(41 < a);
+  EXPECT_TRUE(42 <= a);
+  EXPECT_TRUE(43 > a);
+  EXPECT_TRUE(42 >= a);
+
+  EXPECT_FALSE(b == 0);
+  EXPECT_TRUE(b != 0);
+  EXPECT_TRUE(b < 0);
+  EXPECT_TRUE(b <= 0);
+  EXPECT_FALSE(b > 0);
+  EXPECT_FALSE(b >= 0);
+
+  EXPECT_FALSE(0 == b);
+  EXPECT_TRUE(0 != b);
+  EXPECT_FALSE(0 < b);
+  EXPECT_FALSE(0 <= b);
+  EXPECT_TRUE(0 > b);
+  EXPECT_TRUE(0 >= b);
+}
+
+TEST_F(optional_test, comparison_with_value_three_way) {
+  static_assert(std::is_lt(optional<int>{} <=> 0));
+  static_assert(std::is_gt(0 <=> optional<int>{}));
+  static_assert(std::is_eq(optional<int>{1} <=> 1));
+  static_assert(std::is_lt(optional<int>{1} <=> 2));
+  static_assert(std::is_gt(2 <=> optional<int>{1}));
+  static_assert(std::is_same_v<decltype(optional<double>{} <=> 1), std::partial_ordering>);
+  static_assert(optional<int>{1} == 1 && 1 == optional<int>{1} && optional<int>{} < 1 && 1 > optional<int>{});
+}
+
+namespace {
+
+// Neither side can be copied, so any comparison that converted its operand would fail to compile
+struct non_copyable_key {
+  explicit non_copyable_key(int value)
+      : value(value) {}
+
+  non_copyable_key(const non_copyable_key&) = delete;
+  non_copyable_key& operator=(const non_copyable_key&) = delete;
+
+  int value;
+};
+
+struct non_copyable_value : test_object {
+  using test_object::test_object;
+
+  non_copyable_value(const non_copyable_value&) = delete;
+  non_copyable_value& operator=(const non_copyable_value&) = delete;
+
+  friend bool operator==(const non_copyable_value& lhs, const non_copyable_key& rhs) {
+    return static_cast<int>(lhs) == rhs.value;
+  }
+
+  friend auto operator<=>(const non_copyable_value& lhs, const non_copyable_key& rhs) {
+    return static_cast<int>(lhs) <=> rhs.value;
+  }
+};
+
+} // namespace
+
+TEST_F(optional_test, comparison_with_value_no_conversion) {
+  optional<non_copyable_value> a(in_place, 42);
+  non_copyable_key key(42);
+
+  EXPECT_TRUE(a == key);
+  EXPECT_TRUE(key == a);
+  EXPECT_FALSE(a != key);
+  EXPECT_FALSE(a < key);
+  EXPECT_TRUE(key <= a);
+  EXPECT_TRUE(std::is_eq(a <=> key));
+  EXPECT_TRUE(std::is_eq(key <=> a));
+
+  optional<std::string> s("abc");
+  EXPECT_TRUE(s == "abc");
+  EXPECT_TRUE("abd" > s);
+  EXPECT_TRUE(std::string_view("abc") == s);
+}
+
+TEST_F(optional_test, comparison_derived_stays_optional) {
+  struct derived : optional<int> {
+    using optional<int>::optional;
+  };
+
+  derived a(1);
+  optional<int> b(1);
+  EXPECT_TRUE(a == b);
+  EXPECT_TRUE(b == a);
+  EXPECT_TRUE(std::is_eq(a <=> b));
+}
+
 TEST_F(optional_test, type_deduction) {
   {
     optional opt = 42;
@@ -741,3 +1246,53 @@ TEST_F(optional_test, type_deduction) {
     EXPECT_EQ(*opt2, 42);
   }
 }
+
+TEST_F(optional_test, stress_million_objects) {
+  constexpr std::size_t count = 1'000'000;
+  {
+    std::vector<optional<test_object>> values(count);
+    for (std::size_t i = 0; i < count; i += 2) {
+      values[i].emplace(static_cast<int>(i));
+    }
+    std::vector<optional<test_object>> copies = values;
+    for (std::size_t i = 0; i < count; ++i) {
+      swap(values[i], copies[(i + 1) % count]);
+    }
+    long long sum = 0;
+    for (const auto& value : values) {
+      if (value.has_value()) {
+        sum += *value;
+      }
+    }
+    EXPECT_EQ(sum, static_cast<long long>(count / 2) * static_cast<long long>(count - 2) / 2);
+  }
+  instances_guard.expect_no_instances();
+}
+
+TEST_F(optional_test, stress_threads) {
+  constexpr int threads_count = 8;
+  constexpr int rounds = 20'000;
+  {
+    std::vector<std::thread> threads;
+    for (int t = 0; t < threads_count; ++t) {
+      threads.emplace_back([t] {
+        optional<test_object> a;
+        optional<test_object> b(t);
+        for (int i = 0; i < rounds; ++i) {
+          a.emplace(i);
+          optional<test_object> c = a;
+          swap(b, c);
+          a = std::move(c);
+          if (i % 3 == 0) {
+            a.reset();
+          }
+        }
+        EXPECT_EQ(*b, rounds - 1);
+      });
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+  }
+  instances_guard.expect_no_instances();
+}
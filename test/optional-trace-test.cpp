@@ -0,0 +1,180 @@
+#include "optional-trace.h"
+
+#include "optional.h"
+#include "test-object.h"
+
+#include <gtest/gtest.h>
+
+#include <optional>
+#include <stdexcept>
+#include <sstream>
+#include <string>
+
+namespace {
+
+class optional_trace_test : public ::testing::Test {
+protected:
+  test_object::no_new_instances_guard instances_guard;
+};
+
+// Throws on the copy after copies_left more
+struct throwing_object {
+  throwing_object(int value)
+      : object(value) {}
+
+  throwing_object(const throwing_object& other)
+      : object(other.object) {
+    if (copies_left-- == 0) {
+      throw std::runtime_error("throwing_object");
+    }
+  }
+
+  throwing_object& operator=(const throwing_object&) = default;
+
+  operator int() const {
+    return object;
+  }
+
+  static inline int copies_left = 0;
+
+  test_object object;
+};
+
+optional_trace parse(const std::string& text) {
+  std::istringstream in(text);
+  return read_trace(in);
+}
+
+} // namespace
+
+TEST_F(optional_trace_test, round_trip) {
+  trace_config config;
+  config.operations = 1000;
+  optional_trace trace = generate_trace(config);
+
+  std::ostringstream out;
+  write_trace(out, trace);
+  optional_trace read = parse(out.str());
+  EXPECT_EQ(read.slots, trace.slots);
+  EXPECT_EQ(read.records, trace.records);
+}
+
+TEST_F(optional_trace_test, read) {
+  optional_trace trace = parse(
+      "optional-trace 1 2\n"
+      "construct 0 5\n"
+      "# comment\n"
+      "\n"
+      "copy_construct 1 0\n"
+      "compare 0 1\n"
+      "destroy 1\n"
+  );
+  ASSERT_EQ(trace.records.size(), 4);
+  EXPECT_EQ(trace.records[0], (trace_record{trace_op::construct, 0, 5}));
+  EXPECT_EQ(trace.records[1], (trace_record{trace_op::copy_construct, 1, 0}));
+  EXPECT_EQ(trace.records[3], (trace_record{trace_op::destroy, 1, 0}));
+}
+
+TEST_F(optional_trace_test, read_rejects_malformed) {
+  EXPECT_THROW(parse("optional-trace 2 1\n"), trace_error);
+  EXPECT_THROW(parse("optional-trace 1 1\nfrobnicate 0\n"), trace_error);
+  EXPECT_THROW(parse("optional-trace 1 1\nconstruct 0\n"), trace_error);
+  EXPECT_THROW(parse("optional-trace 1 1\nconstruct 1 0\n"), trace_error);
+}
+
+TEST_F(optional_trace_test, read_rejects_bad_lifetimes) {
+  EXPECT_THROW(parse("optional-trace 1 1\nreset 0\n"), trace_error);
+  EXPECT_THROW(parse("optional-trace 1 1\nconstruct_empty 0\nconstruct_empty 0\n"), trace_error);
+  EXPECT_THROW(parse("optional-trace 1 2\nconstruct_empty 0\ncopy_assign 0 1\n"), trace_error);
+  EXPECT_THROW(parse("optional-trace 1 1\nconstruct_empty 0\ndestroy 0\nhas_value 0\n"), trace_error);
+}
+
+TEST_F(optional_trace_test, generate_engaged_ratio) {
+  auto engaged_results = [](double ratio) {
+    trace_config config;
+    config.operations = 20000;
+    config.engaged_ratio = ratio;
+    optional_trace trace = generate_trace(config);
+    std::size_t engaging = 0;
+    std::size_t clearing = 0;
+    for (const auto& record : trace.records) {
+      engaging += record.op == trace_op::construct || record.op == trace_op::assign;
+      clearing += record.op == trace_op::construct_empty || record.op == trace_op::reset;
+    }
+    return static_cast<double>(engaging) / static_cast<double>(engaging + clearing);
+  };
+  EXPECT_LT(engaged_results(0.1), engaged_results(0.5));
+  EXPECT_LT(engaged_results(0.5), engaged_results(0.9));
+}
+
+TEST_F(optional_trace_test, generate_is_deterministic) {
+  trace_config config;
+  config.operations = 500;
+  EXPECT_EQ(generate_trace(config).records, generate_trace(config).records);
+  trace_config other = config;
+  other.seed = 2;
+  EXPECT_NE(generate_trace(config).records, generate_trace(other).records);
+}
+
+TEST_F(optional_trace_test, replay_matches_std_optional) {
+  for (double ratio : {0.0, 0.3, 1.0}) {
+    trace_config config;
+    config.operations = 5000;
+    config.engaged_ratio = ratio;
+    config.slots = 16;
+    optional_trace trace = generate_trace(config);
+
+    trace_replayer<optional<int>> ints(trace);
+    trace_replayer<std::optional<int>> std_ints(trace);
+    trace_replayer<optional<std::string>> strings(trace);
+    trace_replayer<std::optional<std::string>> std_strings(trace);
+
+    // moved-from strings are empty while moved-from ints keep their value, so only the same T agrees
+    std::uint64_t expected = std_ints.run();
+    EXPECT_EQ(ints.run(), expected);
+    EXPECT_EQ(strings.run(), std_strings.run());
+    // a replay cleans up after itself, so it can be repeated
+    EXPECT_EQ(ints.run(), expected);
+  }
+}
+
+TEST_F(optional_trace_test, replay_test_objects) {
+  trace_config config;
+  config.operations = 2000;
+  config.slots = 8;
+  optional_trace trace = generate_trace(config);
+  {
+    trace_replayer<optional<test_object>> objects(trace);
+    trace_replayer<std::optional<int>> ints(trace);
+    EXPECT_EQ(objects.run(), ints.run());
+  }
+  instances_guard.expect_no_instances();
+}
+
+TEST_F(optional_trace_test, replayer_cleans_up) {
+  static_assert(!std::is_constructible_v<trace_replayer<optional<int>>, optional_trace&&>);
+
+  trace_config config;
+  config.operations = 2000;
+  config.slots = 8;
+  optional_trace trace = generate_trace(config);
+  {
+    // Never run
+    trace_replayer<optional<test_object>> objects(trace);
+  }
+  {
+    // Run partway: a copy throws with slots live
+    throwing_object::copies_left = 1'000'000;
+    trace_replayer<optional<throwing_object>> objects(trace);
+    throwing_object::copies_left = 100;
+    EXPECT_THROW(objects.run(), std::runtime_error);
+
+    throwing_object::copies_left = 1'000'000;
+    trace_replayer<std::optional<int>> ints(trace);
+    EXPECT_EQ(objects.run(), ints.run());
+
+    throwing_object::copies_left = 100;
+    EXPECT_THROW(objects.run(), std::runtime_error);
+  }
+  instances_guard.expect_no_instances();
+}
@@ -0,0 +1,201 @@
+#include "optional-views.h"
+
+#include "optional-column.h"
+#include "optional.h"
+#include "test-object.h"
+
+#include <gtest/gtest.h>
+
+#include <iterator>
+#include <optional>
+#include <ranges>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace {
+
+class optional_views_test : public ::testing::Test {
+protected:
+  test_object::no_new_instances_guard instances_guard;
+};
+
+// Counts the engagement checks made on it
+struct checked_optional {
+  explicit operator bool() const {
+    ++checks;
+    return value.has_value();
+  }
+
+  int operator*() const {
+    return *value;
+  }
+
+  optional<int> value;
+
+  static inline int checks = 0;
+};
+
+template <typename R>
+auto collect(R&& range) {
+  std::vector<std::ranges::range_value_t<R>> result;
+  for (auto&& element : range) {
+    result.push_back(element);
+  }
+  return result;
+}
+
+} // namespace
+
+TEST_F(optional_views_test, engaged) {
+  std::vector<optional<int>> values = {1, nullopt, 3, nullopt, nullopt, 6};
+  auto view = values | views::engaged;
+  static_assert(std::ranges::forward_range<decltype(view)>);
+  static_assert(std::is_same_v<std::ranges::range_reference_t<decltype(view)>, optional<int>&>);
+
+  std::vector<optional<int>> expected = {1, 3, 6};
+  EXPECT_EQ(collect(view), expected);
+
+  // references into the underlying range
+  for (auto& value : view) {
+    *value *= 10;
+  }
+  EXPECT_EQ(values[2], 30);
+}
+
+TEST_F(optional_views_test, values) {
+  std::vector<optional<std::string>> strings = {"a", nullopt, "b", nullopt};
+  auto view = strings | views::values;
+  static_assert(std::is_same_v<std::ranges::range_reference_t<decltype(view)>, std::string&>);
+  EXPECT_EQ(collect(view), (std::vector<std::string>{"a", "b"}));
+
+  std::vector<optional<int>> empty(5);
+  EXPECT_TRUE(collect(empty | views::values).empty());
+}
+
+TEST_F(optional_views_test, value_or) {
+  std::vector<optional<int>> values = {1, nullopt, 3};
+  EXPECT_EQ(collect(values | views::value_or(-1)), (std::vector<int>{1, -1, 3}));
+
+  std::vector<optional<std::string>> strings = {nullopt, "x"};
+  EXPECT_EQ(collect(strings | views::value_or("none")), (std::vector<std::string>{"none", "x"}));
+}
+
+TEST_F(optional_views_test, std_optional) {
+  std::vector<std::optional<int>> values = {1, std::nullopt, 3};
+  EXPECT_EQ(collect(values | views::values), (std::vector<int>{1, 3}));
+  EXPECT_EQ(collect(values | views::value_or(0)), (std::vector<int>{1, 0, 3}));
+}
+
+TEST_F(optional_views_test, fused) {
+  std::vector<optional<int>> values = {1, nullopt, 3};
+  auto fused = values | views::engaged | views::values;
+  static_assert(std::is_same_v<decltype(fused), decltype(values | views::values)>);
+  EXPECT_EQ(collect(fused), (std::vector<int>{1, 3}));
+
+  auto twice = values | views::engaged | views::engaged;
+  static_assert(std::is_same_v<decltype(twice), decltype(values | views::engaged)>);
+
+  auto defaulted = values | views::engaged | views::value_or(0);
+  EXPECT_EQ(collect(defaulted), (std::vector<int>{1, 3}));
+}
+
+TEST_F(optional_views_test, transform_computed_once) {
+  std::vector<optional<int>> values = {1, nullopt, 2, 3, nullopt};
+  int calls = 0;
+  auto halve_even = [&calls](const optional<int>& value) {
+    ++calls;
+    return *value % 2 == 0 ? optional<int>(*value / 2) : optional<int>();
+  };
+  auto view = values | views::engaged | std::views::transform(halve_even) | views::values;
+  static_assert(std::ranges::input_range<decltype(view)>);
+  EXPECT_EQ(collect(view), (std::vector<int>{1}));
+  EXPECT_EQ(calls, 3);
+}
+
+// The values of a values view are optionals again, so further adaptors apply to them rather than fusing
+TEST_F(optional_views_test, nested_optionals) {
+  std::vector<optional<optional<int>>> values = {optional<int>(1), nullopt, optional<int>(), optional<int>(4)};
+
+  auto inner = values | views::values;
+  static_assert(std::is_same_v<std::ranges::range_value_t<decltype(inner)>, optional<int>>);
+  EXPECT_EQ(collect(inner), (std::vector<optional<int>>{1, nullopt, 4}));
+
+  auto unwrapped = values | views::values | views::values;
+  static_assert(std::is_same_v<std::ranges::range_value_t<decltype(unwrapped)>, int>);
+  EXPECT_EQ(collect(unwrapped), (std::vector<int>{1, 4}));
+
+  auto engaged = values | views::values | views::engaged;
+  EXPECT_EQ(collect(engaged), (std::vector<optional<int>>{1, 4}));
+
+  auto defaulted = values | views::values | views::value_or(7);
+  EXPECT_EQ(collect(defaulted), (std::vector<int>{1, 7, 4}));
+
+  auto outer = values | views::engaged | views::value_or(optional<int>(7));
+  EXPECT_EQ(collect(outer), (std::vector<optional<int>>{1, nullopt, 4}));
+}
+
+TEST_F(optional_views_test, begin_cached) {
+  std::vector<checked_optional> values(100);
+  values.push_back({42});
+  auto view = values | views::values;
+  checked_optional::checks = 0;
+  EXPECT_EQ(*view.begin(), 42);
+  EXPECT_EQ(checked_optional::checks, 101);
+  EXPECT_EQ(*view.begin(), 42);
+  EXPECT_EQ(checked_optional::checks, 101);
+
+  // A copy scans again rather than sharing the position
+  auto copy = view;
+  EXPECT_EQ(*copy.begin(), 42);
+  EXPECT_EQ(checked_optional::checks, 202);
+}
+
+TEST_F(optional_views_test, test_objects) {
+  {
+    std::vector<optional<test_object>> values;
+    values.emplace_back(1);
+    values.emplace_back();
+    values.emplace_back(3);
+    int sum = 0;
+    for (const test_object& value : values | views::values) {
+      sum += value;
+    }
+    EXPECT_EQ(sum, 4);
+
+    auto copy = [](const optional<test_object>& value) { return value; };
+    sum = 0;
+    for (const test_object& value : values | std::views::transform(copy) | views::values) {
+      sum += value;
+    }
+    EXPECT_EQ(sum, 4);
+  }
+  instances_guard.expect_no_instances();
+}
+
+TEST_F(optional_views_test, column) {
+  optional_column<int> column;
+  for (int i = 0; i < 200; ++i) {
+    if (i % 50 == 0) {
+      column.emplace_back(i);
+    } else {
+      column.push_back(nullopt);
+    }
+  }
+
+  auto values = column | views::values;
+  static_assert(std::is_same_v<decltype(values), std::span<int>>);
+  EXPECT_EQ(collect(values), (std::vector<int>{0, 50, 100, 150}));
+
+  const auto& view = column;
+  static_assert(std::is_same_v<decltype(view | views::values), std::span<const int>>);
+
+  auto defaulted = view | views::value_or(-1);
+  static_assert(std::ranges::forward_range<decltype(defaulted)>);
+  EXPECT_EQ(std::ranges::distance(defaulted), 200);
+  auto all = collect(defaulted);
+  EXPECT_EQ(all[0], 0);
+  EXPECT_EQ(all[1], -1);
+  EXPECT_EQ(all[150], 150);
+  EXPECT_EQ(all[199], -1);
+}
@@ -0,0 +1,97 @@
+#include "padded-optional.h"
+
+#include "test-object.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+namespace {
+
+struct alignas(128) overaligned {
+  int x;
+};
+
+} // namespace
+
+TEST(padded_optional_test, layout) {
+  static_assert(alignof(padded_optional<int>) == destructive_interference_size);
+  static_assert(sizeof(padded_optional<int>) == destructive_interference_size);
+  static_assert(sizeof(padded_optional<char[100]>) == 2 * destructive_interference_size);
+  static_assert(alignof(padded_optional<overaligned>) == 128);
+  static_assert(alignof(padded_optional<int, 256>) == 256);
+
+  padded_optional<int> slots[4];
+  for (size_t i = 1; i < std::size(slots); ++i) {
+    auto distance = reinterpret_cast<std::byte*>(&slots[i]) - reinterpret_cast<std::byte*>(&slots[i - 1]);
+    EXPECT_GE(distance, destructive_interference_size);
+  }
+}
+
+TEST(padded_optional_test, traits) {
+  static_assert(std::is_trivially_destructible_v<padded_optional<int>>);
+  static_assert(std::is_trivially_copy_constructible_v<padded_optional<int>>);
+  static_assert(std::is_trivially_move_constructible_v<padded_optional<int>>);
+  static_assert(std::is_trivially_copy_assignable_v<padded_optional<int>>);
+  static_assert(std::is_trivially_move_assignable_v<padded_optional<int>>);
+
+  static_assert(!std::is_trivially_destructible_v<padded_optional<std::string>>);
+  static_assert(!std::is_trivially_copy_constructible_v<padded_optional<std::string>>);
+  static_assert(std::is_nothrow_move_constructible_v<padded_optional<std::string>>);
+  static_assert(!std::is_trivially_move_assignable_v<padded_optional<std::vector<int>>>);
+
+  static_assert(!std::is_copy_constructible_v<padded_optional<std::unique_ptr<int>>>);
+  static_assert(std::is_move_constructible_v<padded_optional<std::unique_ptr<int>>>);
+  static_assert(!std::is_copy_assignable_v<padded_optional<std::unique_ptr<int>>>);
+
+  static_assert(std::is_nothrow_default_constructible_v<padded_optional<test_object>>);
+  static_assert(std::is_nothrow_assignable_v<padded_optional<int>&, nullopt_t>);
+  static_assert(std::is_nothrow_assignable_v<padded_optional<int>&, int>);
+  static_assert(!std::is_convertible_v<std::string_view, padded_optional<std::string>>);
+}
+
+TEST(padded_optional_test, api) {
+  test_object::no_new_instances_guard guard;
+
+  padded_optional<test_object> a(42);
+  EXPECT_TRUE(a.has_value());
+  EXPECT_EQ(*a, 42);
+
+  padded_optional<test_object> b = a;
+  EXPECT_EQ(*b, 42);
+
+  a = 55;
+  EXPECT_EQ(*a, 55);
+
+  swap(a, b);
+  EXPECT_EQ(*a, 42);
+  EXPECT_EQ(*b, 55);
+  EXPECT_TRUE(a < b);
+  EXPECT_FALSE(a == b);
+
+  a = nullopt;
+  EXPECT_FALSE(a.has_value());
+
+  a.emplace(17);
+  EXPECT_EQ(*a, 17);
+
+  b = {};
+  EXPECT_FALSE(b.has_value());
+}
+
+TEST(padded_optional_test, empty_assignment_int) {
+  padded_optional<int> a(42);
+  a = {};
+  EXPECT_FALSE(a.has_value());
+}
+
+TEST(padded_optional_test, constexpr_usage) {
+  static_assert([] {
+    padded_optional<int> a(42);
+    padded_optional<int> b;
+    b = a;
+    a.reset();
+    return !a.has_value() && *b == 42;
+  }());
+}
@@ -0,0 +1,121 @@
+#include "rank-select-index.h"
+
+#include <gtest/gtest.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+namespace {
+
+struct bitmap {
+  std::vector<std::uint64_t> words;
+  std::size_t size = 0;
+
+  void push_back(bool bit) {
+    if (size % 64 == 0) {
+      words.push_back(0);
+    }
+    words.back() |= std::uint64_t(bit) << size % 64;
+    ++size;
+  }
+
+  bool operator[](std::size_t i) const {
+    return (words[i / 64] >> i % 64) & 1;
+  }
+};
+
+bitmap random_bitmap(std::size_t size, double density, std::uint64_t seed) {
+  std::mt19937_64 random(seed);
+  std::bernoulli_distribution bit(density);
+  bitmap result;
+  for (std::size_t i = 0; i < size; ++i) {
+    result.push_back(bit(random));
+  }
+  return result;
+}
+
+// Checks every rank and select against a scan
+void expect_matches_scan(const rank_select_index& index, const bitmap& bits) {
+  ASSERT_EQ(index.size(), bits.size);
+  std::uint64_t ones = 0;
+  for (std::size_t i = 0; i < bits.size; ++i) {
+    ASSERT_EQ(index.rank(bits.words, i), ones) << "rank " << i;
+    if (bits[i]) {
+      ASSERT_EQ(index.select(bits.words, ones), i) << "select " << ones;
+      ++ones;
+    }
+  }
+  EXPECT_EQ(index.rank(bits.words, bits.size), ones);
+  EXPECT_EQ(index.count(), ones);
+}
+
+} // namespace
+
+TEST(rank_select_index_test, empty) {
+  bitmap bits;
+  rank_select_index index(bits.words, 0);
+  EXPECT_EQ(index.count(), 0);
+  EXPECT_EQ(index.rank(bits.words, 0), 0);
+}
+
+TEST(rank_select_index_test, densities) {
+  for (double density : {0.0, 0.001, 0.05, 0.5, 0.95, 1.0}) {
+    bitmap bits = random_bitmap(200'000, density, 1);
+    rank_select_index index(bits.words, bits.size);
+    expect_matches_scan(index, bits);
+  }
+}
+
+TEST(rank_select_index_test, block_boundaries) {
+  for (std::size_t size : {1, 63, 64, 65, 511, 512, 513, 65535, 65536, 65537, 131072}) {
+    bitmap bits = random_bitmap(size, 0.5, size);
+    rank_select_index index(bits.words, bits.size);
+    expect_matches_scan(index, bits);
+  }
+}
+
+TEST(rank_select_index_test, incremental_update) {
+  bitmap all = random_bitmap(150'000, 0.3, 2);
+  bitmap bits;
+  rank_select_index index;
+  std::mt19937_64 random(3);
+  while (bits.size < all.size) {
+    std::size_t step = std::min<std::size_t>(random() % 3000, all.size - bits.size);
+    for (std::size_t i = 0; i < step; ++i) {
+      bits.push_back(all[bits.size]);
+    }
+    index.update(bits.words, bits.size);
+    ASSERT_EQ(index.count(), index.rank(bits.words, bits.size));
+  }
+  expect_matches_scan(index, bits);
+}
+
+TEST(rank_select_index_test, push_back) {
+  for (double density : {0.01, 0.5, 1.0}) {
+    bitmap all = random_bitmap(140'000, density, 5);
+    bitmap bits;
+    rank_select_index index;
+    for (std::size_t i = 0; i < all.size; ++i) {
+      index.push_back(all[i]);
+      bits.push_back(all[i]);
+    }
+    expect_matches_scan(index, bits);
+
+    // update() can take over after push_back()
+    for (std::size_t i = 0; i < 1000; ++i) {
+      bits.push_back(i % 3 == 0);
+    }
+    index.update(bits.words, bits.size);
+    expect_matches_scan(index, bits);
+  }
+}
+
+TEST(rank_select_index_test, space_overhead) {
+  for (double density : {0.01, 0.5, 1.0}) {
+    bitmap bits = random_bitmap(10'000'000, density, 4);
+    rank_select_index index(bits.words, bits.size);
+    EXPECT_LT(index.memory_bytes() * 8, bits.size / 20) << density;
+  }
+}
@@ -2,16 +2,216 @@
 
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <vector>
+
+// Under AddressSanitizer the global allocation functions are left alone: replacing them would hide ASan's own
+// operator new and delete, and with them its new/delete mismatch and sized-delete checks. Allocations are counted by
+// an ASan malloc hook instead. MSVC's ASan has no such hook, so there the replacements stay.
+#if defined(__SANITIZE_ADDRESS__) && !defined(_MSC_VER)
+#define TEST_OBJECT_ALLOCATION_HOOK 1
+#elif defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define TEST_OBJECT_ALLOCATION_HOOK 1
+#endif
+#endif
+
 namespace {
 
+thread_local std::size_t allocation_count = 0;
+thread_local std::size_t untracked_depth = 0;
+
+// The registry of test_object allocates the slot vectors of its shards as they grow, and the std::set snapshots that
+// the guards compare; none of that is a concern of the code under test
+struct untracked_allocations {
+  untracked_allocations() noexcept {
+    ++untracked_depth;
+  }
+
+  untracked_allocations(const untracked_allocations&) = delete;
+  untracked_allocations& operator=(const untracked_allocations&) = delete;
+
+  ~untracked_allocations() {
+    --untracked_depth;
+  }
+};
+
+#ifndef TEST_OBJECT_ALLOCATION_HOOK
+
+void* allocate(std::size_t size) noexcept {
+  if (untracked_depth == 0) {
+    ++allocation_count;
+  }
+  return std::malloc(size == 0 ? 1 : size);
+}
+
+void* allocate(std::size_t size, std::align_val_t alignment) noexcept {
+  if (untracked_depth == 0) {
+    ++allocation_count;
+  }
+  auto align = static_cast<std::size_t>(alignment);
+  // aligned_alloc wants a multiple of the alignment
+  size = (size + align - 1) / align * align;
+#ifdef _MSC_VER
+  return _aligned_malloc(size == 0 ? align : size, align);
+#else
+  return std::aligned_alloc(align, size == 0 ? align : size);
+#endif
+}
+
+void deallocate(void* ptr) noexcept {
+  std::free(ptr);
+}
+
+void deallocate(void* ptr, std::align_val_t) noexcept {
+#ifdef _MSC_VER
+  _aligned_free(ptr);
+#else
+  std::free(ptr);
+#endif
+}
+
+template <typename... Alignment>
+void* allocate_or_throw(std::size_t size, Alignment... alignment) {
+  void* result = allocate(size, alignment...);
+  if (result == nullptr) {
+    throw std::bad_alloc();
+  }
+  return result;
+}
+
+#endif
+
 int transcode(int data, const void* ptr) {
   return data ^ static_cast<int>(reinterpret_cast<std::ptrdiff_t>(ptr) / sizeof(test_object));
 }
 
 } // namespace
 
+// Open addressing with linear probing, in shards picked by the hash of the address, each behind its own mutex. A shard
+// is a fraction of the objects, so threads rarely contend and a table never grows past a few milliseconds of work.
+struct test_object::registry {
+  std::pair<const test_object*, bool> insert(const test_object* object) {
+    shard& s = shard_of(object);
+    std::lock_guard lock(s.mutex);
+    if ((s.count + 1) * 2 > s.slots.size()) {
+      s.grow();
+    }
+    std::size_t i = s.find(object);
+    if (s.slots[i] == object) {
+      return {object, false};
+    }
+    s.slots[i] = object;
+    ++s.count;
+    return {object, true};
+  }
+
+  std::size_t erase(const test_object* object) {
+    shard& s = shard_of(object);
+    std::lock_guard lock(s.mutex);
+    if (s.count == 0) {
+      return 0;
+    }
+    std::size_t i = s.find(object);
+    if (s.slots[i] != object) {
+      return 0;
+    }
+    s.remove(i);
+    --s.count;
+    return 1;
+  }
+
+  bool contains(const test_object* object) {
+    shard& s = shard_of(object);
+    std::lock_guard lock(s.mutex);
+    return s.count != 0 && s.slots[s.find(object)] == object;
+  }
+
+  // A copy of the whole set, ordered as before the registry was sharded so that failures print the same
+  std::set<const test_object*> snapshot() {
+    untracked_allocations untracked;
+    std::set<const test_object*> result;
+    for (auto& s : shards) {
+      std::lock_guard lock(s.mutex);
+      for (const test_object* object : s.slots) {
+        if (object != nullptr) {
+          result.insert(object);
+        }
+      }
+    }
+    return result;
+  }
+
+private:
+  static constexpr std::size_t shard_bits = 6;
+
+  static std::uint64_t hash(const test_object* object) noexcept {
+    // The finalizer of MurmurHash3: neighbouring addresses land in unrelated shards and slots
+    auto h = static_cast<std::uint64_t>(reinterpret_cast<std::uintptr_t>(object));
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+  }
+
+  struct alignas(64) shard {
+    // The slot holding object, or the empty slot where it would go; slots must not be full
+    std::size_t find(const test_object* object) const noexcept {
+      std::size_t mask = slots.size() - 1;
+      for (std::size_t i = hash(object) & mask;; i = (i + 1) & mask) {
+        if (slots[i] == object || slots[i] == nullptr) {
+          return i;
+        }
+      }
+    }
+
+    void grow() {
+      std::vector<const test_object*> old(std::max<std::size_t>(16, slots.size() * 2), nullptr);
+      old.swap(slots);
+      for (const test_object* object : old) {
+        if (object != nullptr) {
+          slots[find(object)] = object;
+        }
+      }
+    }
+
+    // Backward-shift deletion: moves later entries of the probe sequence into the hole, so no tombstones are needed
+    void remove(std::size_t hole) noexcept {
+      std::size_t mask = slots.size() - 1;
+      for (std::size_t i = (hole + 1) & mask; slots[i] != nullptr; i = (i + 1) & mask) {
+        std::size_t home = hash(slots[i]) & mask;
+        // The entry can fill the hole unless its home lies cyclically in (hole, i]
+        if (((i - home) & mask) >= ((i - hole) & mask)) {
+          slots[hole] = slots[i];
+          hole = i;
+        }
+      }
+      slots[hole] = nullptr;
+    }
+
+    std::mutex mutex;
+    std::vector<const test_object*> slots;
+    std::size_t count = 0;
+  };
+
+  shard& shard_of(const test_object* object) noexcept {
+    return shards[hash(object) >> (64 - shard_bits)];
+  }
+
+  std::array<shard, std::size_t(1) << shard_bits> shards;
+};
+
 test_object::test_object(int data)
     : data(transcode(data, this)) {
+  untracked_allocations untracked;
   auto p = instances.insert(this);
   EXPECT_TRUE(p.second);
 }
@@ -19,6 +219,7 @@ test_object::test_object(int data)
 test_object::test_object(const test_object& other) {
   other.check_this();
   {
+    untracked_allocations untracked;
     auto p = instances.insert(this);
     EXPECT_TRUE(p.second);
   }
@@ -26,6 +227,7 @@ test_object::test_object(const test_object& other) {
 }
 
 test_object::~test_object() {
+  untracked_allocations untracked;
   size_t n = instances.erase(this);
   if (n != 1) {
     ADD_FAILURE() << "destroying non-existing object at " << this;
@@ -46,21 +248,132 @@ test_object::operator int() const {
 }
 
 void test_object::check_this() const {
-  if (instances.find(this) == instances.end()) {
+  if (!instances.contains(this)) {
     ADD_FAILURE() << "accessing non-existing object at " << this;
     std::abort();
   }
 }
 
-std::set<const test_object*> test_object::instances;
+test_object::registry test_object::instances;
 
 test_object::no_new_instances_guard::no_new_instances_guard()
-    : old_instances(instances) {}
+    : old_instances(test_object::instances.snapshot()) {}
 
 test_object::no_new_instances_guard::~no_new_instances_guard() {
-  EXPECT_EQ(old_instances, instances);
+  expect_no_instances();
 }
 
 void test_object::no_new_instances_guard::expect_no_instances() const {
+  std::set<const test_object*> instances = test_object::instances.snapshot();
   EXPECT_EQ(old_instances, instances);
 }
+
+no_allocations_guard::no_allocations_guard() noexcept
+    : old_allocations(allocation_count) {}
+
+no_allocations_guard::~no_allocations_guard() {
+  expect_no_allocations();
+}
+
+std::size_t no_allocations_guard::allocations() const noexcept {
+  return allocation_count - old_allocations;
+}
+
+void no_allocations_guard::expect_no_allocations() const {
+  std::size_t count = allocations();
+  EXPECT_EQ(count, 0) << "operator new was called";
+}
+
+#ifdef TEST_OBJECT_ALLOCATION_HOOK
+
+// ASan calls this weak hook for every allocation it serves. The runtime of GCC 12 has no working
+// __sanitizer_install_malloc_and_free_hooks, so the hook is defined rather than installed.
+extern "C" void __sanitizer_malloc_hook(const volatile void*, std::size_t) {
+  if (untracked_depth == 0) {
+    ++allocation_count;
+  }
+}
+
+#else
+
+void* operator new(std::size_t size) {
+  return allocate_or_throw(size);
+}
+
+void* operator new[](std::size_t size) {
+  return allocate_or_throw(size);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment) {
+  return allocate_or_throw(size, alignment);
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment) {
+  return allocate_or_throw(size, alignment);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+  return allocate(size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+  return allocate(size);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+  return allocate(size, alignment);
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+  return allocate(size, alignment);
+}
+
+void operator delete(void* ptr) noexcept {
+  deallocate(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+  deallocate(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept {
+  deallocate(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t) noexcept {
+  deallocate(ptr);
+}
+
+void operator delete(void* ptr, const std::nothrow_t&) noexcept {
+  deallocate(ptr);
+}
+
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept {
+  deallocate(ptr);
+}
+
+void operator delete(void* ptr, std::align_val_t alignment) noexcept {
+  deallocate(ptr, alignment);
+}
+
+void operator delete[](void* ptr, std::align_val_t alignment) noexcept {
+  deallocate(ptr, alignment);
+}
+
+void operator delete(void* ptr, std::size_t, std::align_val_t alignment) noexcept {
+  deallocate(ptr, alignment);
+}
+
+void operator delete[](void* ptr, std::size_t, std::align_val_t alignment) noexcept {
+  deallocate(ptr, alignment);
+}
+
+void operator delete(void* ptr, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+  deallocate(ptr, alignment);
+}
+
+void operator delete[](void* ptr, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+  deallocate(ptr, alignment);
+}
+
+#endif
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstddef>
 #include <set>
 
 struct test_object {
@@ -17,9 +18,12 @@ private:
   void check_this() const;
 
 private:
+  // Sharded hash set of the live objects, safe to use from several threads
+  struct registry;
+
   int data;
 
-  static std::set<const test_object*> instances;
+  static registry instances;
 };
 
 struct test_object::no_new_instances_guard {
@@ -35,3 +39,24 @@ struct test_object::no_new_instances_guard {
 private:
   std::set<const test_object*> old_instances;
 };
+
+// Counts the global operator new calls made on the current thread while it is alive. The test harness replaces the
+// global allocation functions to count them; they forward to malloc and free, which the sanitizers intercept as usual.
+// Under AddressSanitizer the replacements are compiled out, so that ASan keeps checking new/delete mismatches and sized
+// deletes, and every heap allocation is counted through an ASan malloc hook instead, malloc included. Allocations
+// made by the bookkeeping of test_object itself are not counted.
+struct no_allocations_guard {
+  no_allocations_guard() noexcept;
+
+  no_allocations_guard(const no_allocations_guard&) = delete;
+  no_allocations_guard& operator=(const no_allocations_guard&) = delete;
+
+  ~no_allocations_guard();
+
+  std::size_t allocations() const noexcept;
+
+  void expect_no_allocations() const;
+
+private:
+  std::size_t old_allocations;
+};
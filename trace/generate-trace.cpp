@@ -0,0 +1,46 @@
+// Writes a generated optional trace to standard output:
+//
+//   generate-trace [--operations N] [--slots N] [--engaged RATIO] [--values N] [--seed N] > trace.txt
+//
+// Replay it with `OPTIONAL_TRACE=trace.txt benchmarks --benchmark_filter=replay`.
+
+#include "optional-trace.h"
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <string_view>
+
+int main(int argc, char** argv) {
+  trace_config config;
+  for (int i = 1; i < argc; ++i) {
+    std::string_view flag = argv[i];
+    if (i + 1 == argc) {
+      std::cerr << "missing value for " << flag << '\n';
+      return 2;
+    }
+    std::string value = argv[++i];
+    if (flag == "--operations") {
+      config.operations = std::stoull(value);
+    } else if (flag == "--slots") {
+      config.slots = static_cast<std::uint32_t>(std::stoul(value));
+    } else if (flag == "--engaged") {
+      config.engaged_ratio = std::stod(value);
+    } else if (flag == "--values") {
+      config.values = std::stoull(value);
+    } else if (flag == "--seed") {
+      config.seed = std::stoull(value);
+    } else {
+      std::cerr << "unknown flag " << flag << '\n';
+      return 2;
+    }
+  }
+
+  try {
+    write_trace(std::cout, generate_trace(config));
+  } catch (const trace_error& error) {
+    std::cerr << error.what() << '\n';
+    return 1;
+  }
+  return 0;
+}